@@ -0,0 +1,243 @@
+#!/usr/bin/env python3
+
+# Copyright (c) Facebook, Inc. and its affiliates.
+# This source code is licensed under the MIT license found in the
+# LICENSE file in the root directory of this source tree.
+
+# Microbenchmarks of PathFinder queries.  Run against two builds to compare
+# their throughput.
+
+import argparse
+import time
+
+import numpy as np
+
+import habitat_sim
+import habitat_sim.bindings as hsim
+
+parser = argparse.ArgumentParser("Running microbenchmarks on PathFinder")
+parser.add_argument(
+    "--navmesh",
+    type=str,
+    default="data/scene_datasets/habitat-test-scenes/skokloster-castle.navmesh",
+)
+parser.add_argument(
+    "--num_queries", type=int, default=100000, help="Queries per benchmark."
+)
+parser.add_argument(
+    "--step_size", type=float, default=0.25, help="Length of try_step steps."
+)
+parser.add_argument(
+    "--num_episodes", type=int, default=100, help="Greedy follower episodes."
+)
+parser.add_argument("--seed", type=int, default=1)
+args = parser.parse_args()
+
+pathfinder = hsim.PathFinder()
+pathfinder.load_nav_mesh(args.navmesh)
+assert pathfinder.is_loaded, "Could not load {}".format(args.navmesh)
+pathfinder.seed(args.seed)
+np.random.seed(args.seed)
+
+starts = np.array(
+    [pathfinder.get_random_navigable_point() for _ in range(args.num_queries)]
+)
+headings = np.random.uniform(0, 2 * np.pi, args.num_queries)
+ends = starts + args.step_size * np.stack(
+    [np.cos(headings), np.zeros_like(headings), np.sin(headings)], axis=1
+)
+
+
+def benchmark(name, fn, queries, queries_per_call=1):
+    start_time = time.time()
+    for query in queries:
+        fn(*query)
+    elapsed = time.time() - start_time
+    print(
+        " ====== %s: %0.1f queries/s ======"
+        % (name, queries_per_call * len(queries) / elapsed)
+    )
+
+
+benchmark(
+    "get_random_navigable_point", pathfinder.get_random_navigable_point, [()] * 10000
+)
+benchmark(
+    "get_random_navigable_points",
+    pathfinder.get_random_navigable_points,
+    [(len(starts), args.seed)],
+    queries_per_call=len(starts),
+)
+benchmark("try_step", pathfinder.try_step, list(zip(starts, ends)))
+benchmark(
+    "try_steps", pathfinder.try_steps, [(starts, ends)], queries_per_call=len(starts)
+)
+far_ends = np.array([pathfinder.get_random_navigable_point() for _ in starts])
+benchmark("raycast", pathfinder.raycast, list(zip(starts, far_ends)))
+benchmark(
+    "raycasts", pathfinder.raycasts, [(starts, far_ends)], queries_per_call=len(starts)
+)
+benchmark("island_radius", pathfinder.island_radius, [(p,) for p in starts])
+benchmark(
+    "distance_to_closest_obstacle",
+    pathfinder.distance_to_closest_obstacle,
+    [(p,) for p in starts],
+)
+pathfinder.set_obstacle_distance_grid_cell_size(0.05)
+benchmark(
+    "distance_to_closest_obstacle, 5cm grid",
+    pathfinder.distance_to_closest_obstacle,
+    [(p,) for p in starts],
+)
+pathfinder.set_obstacle_distance_grid_cell_size(0)
+
+# Queries snap their points to the navmesh first, points near the navmesh
+# are answered by the polygon grid index, the others still need the full search
+off_mesh = starts + np.random.uniform(-2, 2, size=starts.shape)
+for cell_size in [0, 1.0]:
+    pathfinder.set_poly_grid_index_cell_size(cell_size)
+    benchmark(
+        "is_navigable, index cell size %s" % cell_size,
+        pathfinder.is_navigable,
+        [(p,) for p in starts],
+    )
+    for name, points in [("on", starts), ("off", off_mesh)]:
+        benchmark(
+            "snap_points %s the navmesh, index cell size %s" % (name, cell_size),
+            pathfinder.snap_points,
+            [(points,)],
+            queries_per_call=len(points),
+        )
+pathfinder.set_poly_grid_index_cell_size(0)
+
+# The cluster graph pays off for paths that cross many clusters
+goals = np.array([pathfinder.get_random_navigable_point() for _ in starts])
+for cell_size in [0, 2.0, 4.0]:
+    pathfinder.set_cluster_graph_cell_size(cell_size)
+    benchmark(
+        "geodesic_distances, cluster graph cell size %s" % cell_size,
+        pathfinder.geodesic_distances,
+        [(starts, goals)],
+        queries_per_call=len(starts),
+    )
+pathfinder.set_cluster_graph_cell_size(0)
+
+# Training loops ask for the same few episodes over and over
+episode_starts = np.tile(starts[:100], (len(starts) // 100, 1))
+episode_goals = np.tile(goals[:100], (len(starts) // 100, 1))
+for max_bytes in [0, 1 << 20]:
+    pathfinder.set_path_cache_budget(max_bytes)
+    benchmark(
+        "geodesic_distances over 100 episodes, path cache budget %s" % max_bytes,
+        pathfinder.geodesic_distances,
+        [(episode_starts, episode_goals)],
+        queries_per_call=len(episode_starts),
+    )
+print(" path cache hit rate: %0.3f" % pathfinder.path_cache_stats.hit_rate)
+pathfinder.set_path_cache_budget(0)
+
+matrix_points = starts[:100]
+pair_starts, pair_ends = np.meshgrid(np.arange(100), np.arange(100), indexing="ij")
+benchmark(
+    "geodesic_distances, all pairs of 100 points",
+    pathfinder.geodesic_distances,
+    [(matrix_points[pair_starts.ravel()], matrix_points[pair_ends.ravel()])],
+    queries_per_call=100 * 100,
+)
+for refine in [False, True]:
+    benchmark(
+        "geodesic_distance_matrix of 100 points, refine=%s" % refine,
+        pathfinder.geodesic_distance_matrix,
+        [(matrix_points, refine)],
+        queries_per_call=100 * 100,
+    )
+
+# Top down maps used to be built by calling is_navigable on every pixel
+lower, upper = pathfinder.get_bounds()
+meters_per_pixel = 0.1
+height = starts[0][1]
+grid = [
+    [x, height, z]
+    for z in np.arange(lower[2], upper[2], meters_per_pixel) + meters_per_pixel / 2
+    for x in np.arange(lower[0], upper[0], meters_per_pixel) + meters_per_pixel / 2
+]
+benchmark(
+    "is_navigable over the top down grid",
+    lambda: [pathfinder.is_navigable(p) for p in grid],
+    [()],
+    queries_per_call=len(grid),
+)
+benchmark(
+    "get_topdown_view",
+    pathfinder.get_topdown_view,
+    [(meters_per_pixel, height)],
+    queries_per_call=len(grid),
+)
+
+# Distance to the nearest of several objects, per step
+objects = [
+    hsim.OBB(p + np.array([0, 0.5, 0]), np.array([1.0, 1.0, 1.0])) for p in goals[:5]
+]
+pathfinder.set_object_goals("objects", objects)
+benchmark(
+    "geodesic_distance_to_objects, 5 objects",
+    pathfinder.geodesic_distance_to_objects,
+    [(p, "objects") for p in starts],
+)
+
+
+def find_path_to_objects(start):
+    path = hsim.MultiGoalShortestPath()
+    path.requested_start = start
+    path.requested_ends = goals[:5]
+    pathfinder.find_path(path)
+
+
+benchmark(
+    "find_path to 5 goals",
+    find_path_to_objects,
+    [(p,) for p in starts[:10000]],
+)
+
+viewpoint_settings = hsim.ObjectViewpointSettings()
+benchmark(
+    "sample_object_viewpoints, 5 objects",
+    pathfinder.sample_object_viewpoints,
+    [(args.navmesh.replace(".navmesh", ".glb"), objects, viewpoint_settings)],
+    queries_per_call=len(objects),
+)
+
+episode_settings = hsim.PointNavEpisodeSettings()
+episode_settings.num_episodes = 1000
+benchmark(
+    "generate_point_nav_episodes",
+    pathfinder.generate_point_nav_episodes,
+    [(episode_settings, args.seed)],
+    queries_per_call=episode_settings.num_episodes,
+)
+
+scene_graph = hsim.SceneGraph()
+agent = habitat_sim.Agent()
+agent.attach(scene_graph.get_root_node().create_child())
+agent.controls.move_filter_fn = pathfinder.try_step
+episodes = [
+    (start, pathfinder.get_random_navigable_point())
+    for start in starts[: args.num_episodes]
+]
+for native_controls in [False, True]:
+    follower = habitat_sim.GreedyGeodesicFollower(
+        pathfinder, agent, native_controls=native_controls
+    )
+
+    def find_path(start, goal):
+        state = agent.state
+        state.position = start
+        agent.state = state
+        try:
+            follower.find_path(goal)
+        except habitat_sim.errors.GreedyFollowerError:
+            pass
+
+    benchmark(
+        "greedy find_path, native_controls=%s" % native_controls, find_path, episodes
+    )
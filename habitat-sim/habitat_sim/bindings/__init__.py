@@ -5,13 +5,19 @@
 # LICENSE file in the root directory of this source tree.
 
 modules = [
+    "ActionSpacePathFinder",
     "AttachedObject",
     "AttachedObjectType",
     "GreedyFollowerCodes",
     "GreedyGeodesicFollowerImpl",
     "MultiGoalShortestPath",
+    "OBB",
+    "ObjectViewpointSettings",
+    "PathCacheStats",
     "PathFinder",
     "PinholeCamera",
+    "PointNavEpisodeSettings",
+    "RaycastHit",
     "SceneGraph",
     "SceneNode",
     "Sensor",
@@ -1 +1,2 @@
 from .greedy_geodesic_follower import GreedyGeodesicFollower
+from .point_nav_episodes import save_point_nav_episodes
@@ -19,17 +19,28 @@ class GreedyGeodesicFollower(object):
             `None` is used to signify that the goal location has been reached
         goal_radius (Optional[float]): Specifies how close the agent must get to the goal in order for it to be considered
             reached.  If `None`, 0.75 times the agents step size is used.
+        native_controls (bool): Whether to move with the C++ implementations of move_forward, turn_left and turn_right
+            and use `pathfinder.try_step` as the step filter instead of calling back into the agent's controls.
+            This is much faster, but must be turned off if the agent uses custom controls or a different step filter.
+        use_distance_field (bool): Whether to check the progress of steps with the pathfinder's cached distance field
+            of the goal instead of a full path search per step.  Faster for long episodes, but the field runs a few
+            percent long across open space, which can change the fitted actions.
     """
 
     pathfinder: hsim.PathFinder
     agent: habitat_sim.agent.Agent
     goal_radius: Optional[float] = attr.ib(default=None)
+    native_controls: bool = attr.ib(default=True)
+    use_distance_field: bool = attr.ib(default=False)
     action_mapping: Dict[hsim.GreedyFollowerCodes, Any] = attr.ib(
         init=False, factory=dict, repr=False
     )
     impl: hsim.GreedyGeodesicFollowerImpl = attr.ib(
         init=False, default=None, repr=False
     )
+    planner: hsim.ActionSpacePathFinder = attr.ib(
+        init=False, default=None, repr=False
+    )
     forward_spec: habitat_sim.agent.ActuationSpec = attr.ib(
         init=False, default=None, repr=False
     )
@@ -58,14 +69,35 @@ class GreedyGeodesicFollower(object):
         if self.goal_radius is None:
             self.goal_radius = 0.75 * self.forward_spec.amount
 
-        self.impl = hsim.GreedyGeodesicFollowerImpl(
+        if self.native_controls:
+            self.impl = hsim.GreedyGeodesicFollowerImpl(
+                self.pathfinder,
+                "moveForward",
+                {"amount": self.forward_spec.amount},
+                "turnLeft",
+                {"amount": self.left_spec.amount},
+                "turnRight",
+                {"amount": self.right_spec.amount},
+                self.goal_radius,
+            )
+        else:
+            self.impl = hsim.GreedyGeodesicFollowerImpl(
+                self.pathfinder,
+                self._move_forward,
+                self._turn_left,
+                self._turn_right,
+                self.goal_radius,
+                self.forward_spec.amount,
+                np.deg2rad(self.left_spec.amount),
+            )
+
+        self.impl.use_distance_field = self.use_distance_field
+
+        self.planner = hsim.ActionSpacePathFinder(
             self.pathfinder,
-            self._move_forward,
-            self._turn_left,
-            self._turn_right,
-            self.goal_radius,
             self.forward_spec.amount,
             np.deg2rad(self.left_spec.amount),
+            self.goal_radius,
         )
 
     def _find_action(self, name):
@@ -133,3 +165,27 @@ class GreedyGeodesicFollower(object):
         path = list(map(lambda v: self.action_mapping[v], path))
 
         return path
+
+    def find_optimal_path(self, goal_pos: np.array) -> List[Any]:
+        r"""Finds the shortest sequence of actions from the agent's current
+        position to the goal.  Unlike `find_path`, this searches over all action
+        sequences instead of greedily following the geodesic shortest path, and
+        runs entirely in C++
+
+        Args:
+            goal_pos (np.array): The position of the goal
+
+        Returns:
+            List[Any]: The list of actions to take.  Ends with `None`
+        """
+        state = self.agent.state
+        path = self.planner.find_path(
+            state.position, utils.quat_to_coeffs(state.rotation), goal_pos
+        )
+
+        if len(path) == 0:
+            raise errors.GreedyFollowerError()
+
+        path = list(map(lambda v: self.action_mapping[v], path))
+
+        return path
@@ -0,0 +1,48 @@
+#!/usr/bin/env python3
+
+# Copyright (c) Facebook, Inc. and its affiliates.
+# This source code is licensed under the MIT license found in the
+# LICENSE file in the root directory of this source tree.
+
+import gzip
+import json
+from typing import Dict
+
+import numpy as np
+
+
+def save_point_nav_episodes(
+    path: str, episodes: Dict[str, np.ndarray], scene_id: str, goal_radius=None
+):
+    r"""Saves episodes from :py:meth:`PathFinder.generate_point_nav_episodes` as
+    a PointNav dataset, gzipped if ``path`` ends with ``.gz``
+
+    Args:
+        path (str): File to write
+        episodes (Dict[str, np.ndarray]): Episodes to save
+        scene_id (str): Scene the episodes were generated for
+        goal_radius (Optional[float]): Success radius stored with every goal
+    """
+    dataset = {
+        "episodes": [
+            {
+                "episode_id": str(i),
+                "scene_id": scene_id,
+                "start_position": start.tolist(),
+                "start_rotation": rotation.tolist(),
+                "info": {"geodesic_distance": float(geodesic_distance)},
+                "goals": [{"position": goal.tolist(), "radius": goal_radius}],
+            }
+            for i, (start, rotation, goal, geodesic_distance) in enumerate(
+                zip(
+                    episodes["start_positions"],
+                    episodes["start_rotations"],
+                    episodes["goal_positions"],
+                    episodes["geodesic_distances"],
+                )
+            )
+        ]
+    }
+    opener = gzip.open if path.endswith(".gz") else open
+    with opener(path, "wt") as f:
+        json.dump(dataset, f)
@@ -49,6 +49,7 @@ class Simulator:
 
     def seed(self, new_seed):
         self._sim.seed(new_seed)
+        self.pathfinder.seed(new_seed)
 
     def reset(self):
         self._sim.reset()
@@ -64,6 +64,7 @@ set(RECASTNAVIGATION_EXAMPLES OFF CACHE BOOL "RECASTNAVIGATION_EXAMPLES" FORCE)
 set(RECASTNAVIGATION_STATIC ON CACHE BOOL "RECASTNAVIGATION_STATIC" FORCE)
 add_subdirectory("${DEPS_DIR}/recastnavigation/Recast")
 add_subdirectory("${DEPS_DIR}/recastnavigation/Detour")
+add_subdirectory("${DEPS_DIR}/recastnavigation/DetourCrowd")
 # Needed so that Detour doesn't hide the implementation of the method on dtQueryFilter
 target_compile_definitions(Detour
   PUBLIC
@@ -8,16 +8,49 @@
 #include "esp/bindings/OpaqueTypes.h"
 
 #include "esp/agent/Agent.h"
+#include "esp/assets/SceneLoader.h"
 #include "esp/core/esp.h"
+#include "esp/core/random.h"
+#include "esp/nav/ActionSpacePathFinder.h"
+#include "esp/nav/EpisodeGenerator.h"
 #include "esp/nav/GreedyFollower.h"
+#include "esp/nav/ObjectViewpoints.h"
 #include "esp/nav/PathFinder.h"
 #include "esp/scene/ObjectControls.h"
+#include "esp/scene/SemanticScene.h"
 
 namespace py = pybind11;
 using namespace py::literals;
 using namespace esp;
 using namespace esp::nav;
 
+namespace {
+typedef Eigen::Matrix<float, Eigen::Dynamic, 3, Eigen::RowMajor> RowMatrixX3f;
+typedef Eigen::Matrix<float, Eigen::Dynamic, 4, Eigen::RowMajor> RowMatrixX4f;
+
+template <typename Objects>
+std::vector<RowMatrixX3f> sampleObjectViewpointsInScene(
+    const PathFinder& pathfinder,
+    const std::string& sceneFile,
+    const Objects& objects,
+    const ObjectViewpointSettings& settings) {
+  std::vector<std::vector<vec3f>> viewpoints;
+  {
+    py::gil_scoped_release release;
+    const assets::MeshData mesh =
+        assets::SceneLoader{}.load(assets::AssetInfo::fromPath(sceneFile));
+    viewpoints = sampleObjectViewpoints(pathfinder, mesh, objects, settings);
+  }
+  std::vector<RowMatrixX3f> results(viewpoints.size());
+  for (int i = 0; i < viewpoints.size(); ++i) {
+    results[i].resize(viewpoints[i].size(), 3);
+    for (int j = 0; j < viewpoints[i].size(); ++j)
+      results[i].row(j) = viewpoints[i][j].transpose();
+  }
+  return results;
+}
+}  // namespace
+
 void initShortestPathBindings(py::module& m) {
   py::class_<HitRecord>(m, "HitRecord")
       .def(py::init())
@@ -25,6 +58,24 @@ void initShortestPathBindings(py::module& m) {
       .def_readwrite("hit_normal", &HitRecord::hitNormal)
       .def_readwrite("hit_dist", &HitRecord::hitDist);
 
+  py::class_<RaycastHit>(m, "RaycastHit")
+      .def(py::init())
+      .def_readwrite("hit_pos", &RaycastHit::hitPos)
+      .def_readwrite("hit_normal", &RaycastHit::hitNormal)
+      .def_readwrite("hit_dist", &RaycastHit::hitDist)
+      .def_readwrite("reached", &RaycastHit::reached);
+
+  py::class_<PathCacheStats>(m, "PathCacheStats")
+      .def(py::init())
+      .def_readonly("hits", &PathCacheStats::hits)
+      .def_readonly("misses", &PathCacheStats::misses)
+      .def_readonly("num_entries", &PathCacheStats::numEntries)
+      .def_readonly("num_bytes", &PathCacheStats::numBytes)
+      .def_property_readonly("hit_rate", [](const PathCacheStats& self) {
+        const uint64_t queries = self.hits + self.misses;
+        return queries ? double(self.hits) / queries : 0.0;
+      });
+
   py::class_<ShortestPath, ShortestPath::ptr>(m, "ShortestPath")
       .def(py::init(&ShortestPath::create<>))
       .def_readwrite("requested_start", &ShortestPath::requestedStart)
@@ -41,31 +92,353 @@ void initShortestPathBindings(py::module& m) {
       .def_readwrite("geodesic_distance",
                      &MultiGoalShortestPath::geodesicDistance);
 
+  py::class_<PointNavEpisodeSettings>(m, "PointNavEpisodeSettings")
+      .def(py::init())
+      .def_readwrite("num_episodes", &PointNavEpisodeSettings::numEpisodes)
+      .def_readwrite("min_geodesic_distance",
+                     &PointNavEpisodeSettings::minGeodesicDistance)
+      .def_readwrite("max_geodesic_distance",
+                     &PointNavEpisodeSettings::maxGeodesicDistance)
+      .def_readwrite("min_geodesic_to_euclidean_ratio",
+                     &PointNavEpisodeSettings::minGeodesicToEuclideanRatio)
+      .def_readwrite("min_island_radius",
+                     &PointNavEpisodeSettings::minIslandRadius)
+      .def_readwrite("max_candidates_per_episode",
+                     &PointNavEpisodeSettings::maxCandidatesPerEpisode);
+
+  py::class_<ObjectViewpointSettings>(m, "ObjectViewpointSettings")
+      .def(py::init())
+      .def_readwrite("radius", &ObjectViewpointSettings::radius)
+      .def_readwrite("max_y_delta", &ObjectViewpointSettings::maxYDelta)
+      .def_readwrite("spacing", &ObjectViewpointSettings::spacing)
+      .def_readwrite("min_island_radius",
+                     &ObjectViewpointSettings::minIslandRadius)
+      .def_readwrite("eye_height", &ObjectViewpointSettings::eyeHeight)
+      .def_readwrite("cell_size", &ObjectViewpointSettings::cellSize);
+
   py::class_<PathFinder, PathFinder::ptr>(m, "PathFinder")
       .def(py::init(&PathFinder::create<>))
-      .def("get_random_navigable_point", &PathFinder::getRandomNavigablePoint)
+      .def("get_random_navigable_point", &PathFinder::getRandomNavigablePoint,
+           py::call_guard<py::gil_scoped_release>())
+      .def(
+          "get_random_navigable_points",
+          [](PathFinder& self, int numPoints, uint32_t seed,
+             float minIslandRadius, bool largestIslandOnly) {
+            std::vector<vec3f> points;
+            {
+              py::gil_scoped_release release;
+              core::Random random(seed);
+              self.getRandomNavigablePoints(numPoints, random, points,
+                                            minIslandRadius,
+                                            largestIslandOnly);
+            }
+            RowMatrixX3f results(points.size(), 3);
+            for (int i = 0; i < points.size(); ++i)
+              results.row(i) = points[i].transpose();
+            return results;
+          },
+          R"(Returns :py:attr:`num_points` navigable points as an Nx3 array,
+          drawn uniformly by area from a random stream seeded with
+          :py:attr:`seed`, so the same seed always gives the same points.
+          Points are only drawn on islands with a radius of at least
+          :py:attr:`min_island_radius`, and only on the largest island if
+          :py:attr:`largest_island_only`. The array is empty if no island
+          qualifies.)",
+          "num_points"_a, "seed"_a, "min_island_radius"_a = 0.0,
+          "largest_island_only"_a = false)
+      .def(
+          "generate_point_nav_episodes",
+          [](PathFinder& self, const PointNavEpisodeSettings& settings,
+             uint32_t seed) {
+            std::vector<PointNavEpisode> episodes;
+            {
+              py::gil_scoped_release release;
+              episodes = generatePointNavEpisodes(self, settings, seed);
+            }
+            const int numEpisodes = episodes.size();
+            RowMatrixX3f starts(numEpisodes, 3), goals(numEpisodes, 3);
+            RowMatrixX4f rotations(numEpisodes, 4);
+            Eigen::VectorXf geodesicDistances(numEpisodes),
+                euclideanDistances(numEpisodes);
+            for (int i = 0; i < numEpisodes; ++i) {
+              starts.row(i) = episodes[i].start.transpose();
+              rotations.row(i) = episodes[i].startRotation.coeffs().transpose();
+              goals.row(i) = episodes[i].goal.transpose();
+              geodesicDistances[i] = episodes[i].geodesicDistance;
+              euclideanDistances[i] = episodes[i].euclideanDistance;
+            }
+            return py::dict(
+                "start_positions"_a = starts, "start_rotations"_a = rotations,
+                "goal_positions"_a = goals,
+                "geodesic_distances"_a = geodesicDistances,
+                "euclidean_distances"_a = euclideanDistances);
+          },
+          R"(Generates PointNav episodes that meet :py:attr:`settings` in
+          parallel, see :py:class:`PointNavEpisodeSettings`. Returns a dict of
+          arrays with one row per episode: start_positions, start_rotations
+          (quaternions as x, y, z, w), goal_positions, geodesic_distances and
+          euclidean_distances. The same :py:attr:`seed` always gives the same
+          episodes. See :py:func:`habitat_sim.nav.save_point_nav_episodes`
+          to save them.)",
+          "settings"_a, "seed"_a)
+      .def("sample_object_viewpoints",
+           &sampleObjectViewpointsInScene<std::vector<geo::OBB>>,
+           R"(Samples navigable viewpoints that see each of the :py:class:`OBB`
+          list :py:attr:`objects` through the mesh of :py:attr:`scene_file`,
+          in parallel across objects, see :py:class:`ObjectViewpointSettings`.
+          Returns one Nx3 array of viewpoints per object.)",
+           "scene_file"_a, "objects"_a, "settings"_a)
+      .def("sample_object_viewpoints",
+           &sampleObjectViewpointsInScene<scene::SemanticScene>,
+           R"(Same as above for the objects of :py:attr:`semantic_scene`, one
+          array per entry of its objects.)",
+           "scene_file"_a, "semantic_scene"_a, "settings"_a)
       .def("find_path", py::overload_cast<ShortestPath&>(&PathFinder::findPath),
-           "path"_a)
+           "path"_a, py::call_guard<py::gil_scoped_release>())
       .def("find_path",
            py::overload_cast<MultiGoalShortestPath&>(&PathFinder::findPath),
-           "path"_a)
-      .def("try_step", &PathFinder::tryStep, R"()", "start"_a, "end"_a)
-      .def("island_radius", &PathFinder::islandRadius, R"()", "pt"_a)
+           "path"_a, py::call_guard<py::gil_scoped_release>())
+      .def(
+          "find_paths",
+          [](PathFinder& self, std::vector<ShortestPath::ptr>& paths) {
+            std::vector<ShortestPath> batch;
+            batch.reserve(paths.size());
+            for (const auto& path : paths)
+              batch.emplace_back(*path);
+
+            {
+              py::gil_scoped_release release;
+              self.findPaths(batch);
+            }
+
+            for (int i = 0; i < paths.size(); ++i)
+              *paths[i] = std::move(batch[i]);
+          },
+          R"(Finds the shortest path for every :py:class:`ShortestPath` in
+          :py:attr:`paths` in parallel. The GIL is released while searching.)",
+          "paths"_a)
+      .def(
+          "geodesic_distances",
+          [](PathFinder& self, const Eigen::Ref<const RowMatrixX3f>& starts,
+             const Eigen::Ref<const RowMatrixX3f>& ends) {
+            if (starts.rows() != ends.rows())
+              throw std::invalid_argument(
+                  "starts and ends must have the same number of rows");
+
+            std::vector<ShortestPath> batch(starts.rows());
+            for (int i = 0; i < batch.size(); ++i) {
+              batch[i].requestedStart = starts.row(i).transpose();
+              batch[i].requestedEnd = ends.row(i).transpose();
+            }
+
+            Eigen::VectorXf distances(batch.size());
+            {
+              py::gil_scoped_release release;
+              self.findPaths(batch);
+              for (int i = 0; i < batch.size(); ++i)
+                distances[i] = batch[i].geodesicDistance;
+            }
+            return distances;
+          },
+          R"(Computes the geodesic distance between every row of
+          :py:attr:`starts` and the same row of :py:attr:`ends` (both Nx3
+          arrays) in parallel. Unreachable pairs are infinity.)",
+          "starts"_a, "ends"_a)
+      .def(
+          "geodesic_distance_matrix",
+          [](PathFinder& self, const Eigen::Ref<const RowMatrixX3f>& points,
+             bool refine) {
+            std::vector<vec3f> pts(points.rows());
+            for (int i = 0; i < pts.size(); ++i)
+              pts[i] = points.row(i).transpose();
+
+            py::gil_scoped_release release;
+            return self.geodesicDistanceMatrix(pts, refine);
+          },
+          R"(Returns the KxK matrix of the geodesic distances between all
+          pairs of rows of the Kx3 array :py:attr:`points`, with one Dijkstra
+          over the navmesh per point instead of K^2 path searches.
+          Unreachable pairs are infinity. Without :py:attr:`refine` the
+          distances are upper bounds that bend at polygon corners only, with
+          it pairs that need it are refined with a raycast or
+          :py:meth:`find_path`.)",
+          "points"_a, "refine"_a = true)
+      .def("try_step",
+           py::overload_cast<const Eigen::Ref<const vec3f>,
+                             const Eigen::Ref<const vec3f>>(
+               &PathFinder::tryStep),
+           R"()", "start"_a, "end"_a, py::call_guard<py::gil_scoped_release>())
+      .def(
+          "try_steps",
+          [](PathFinder& self, const Eigen::Ref<const RowMatrixX3f>& starts,
+             const Eigen::Ref<const RowMatrixX3f>& ends) {
+            if (starts.rows() != ends.rows())
+              throw std::invalid_argument(
+                  "starts and ends must have the same number of rows");
+
+            std::vector<vec3f> startPts(starts.rows()), endPts(ends.rows());
+            for (int i = 0; i < startPts.size(); ++i) {
+              startPts[i] = starts.row(i).transpose();
+              endPts[i] = ends.row(i).transpose();
+            }
+
+            RowMatrixX3f results(startPts.size(), 3);
+            {
+              py::gil_scoped_release release;
+              std::vector<vec3f> resultPts;
+              self.trySteps(startPts, endPts, resultPts);
+              for (int i = 0; i < resultPts.size(); ++i)
+                results.row(i) = resultPts[i].transpose();
+            }
+            return results;
+          },
+          R"(Same as :py:meth:`try_step` for every row of :py:attr:`starts`
+          and the same row of :py:attr:`ends` (both Nx3 arrays) in parallel.
+          Returns the Nx3 array of filtered end positions.)",
+          "starts"_a, "ends"_a)
+      .def("raycast",
+           py::overload_cast<const vec3f&, const vec3f&>(&PathFinder::raycast),
+           R"(Casts a ray along the navmesh from :py:attr:`start` towards
+          :py:attr:`end`. The hit tells where the ray stopped, the normal of
+          the navmesh border it hit and whether it reached :py:attr:`end`, in
+          which case :py:attr:`end` is in line of sight and its geodesic
+          distance is hit_dist.)",
+           "start"_a, "end"_a, py::call_guard<py::gil_scoped_release>())
+      .def(
+          "raycasts",
+          [](PathFinder& self, const Eigen::Ref<const RowMatrixX3f>& starts,
+             const Eigen::Ref<const RowMatrixX3f>& ends) {
+            if (starts.rows() != ends.rows())
+              throw std::invalid_argument(
+                  "starts and ends must have the same number of rows");
+
+            std::vector<vec3f> startPts(starts.rows()), endPts(ends.rows());
+            for (int i = 0; i < startPts.size(); ++i) {
+              startPts[i] = starts.row(i).transpose();
+              endPts[i] = ends.row(i).transpose();
+            }
+
+            const int numRays = startPts.size();
+            RowMatrixX3f hitPositions(numRays, 3), hitNormals(numRays, 3);
+            Eigen::VectorXf hitDists(numRays);
+            Eigen::Matrix<bool, Eigen::Dynamic, 1> reached(numRays);
+            {
+              py::gil_scoped_release release;
+              std::vector<RaycastHit> hits;
+              self.raycasts(startPts, endPts, hits);
+              for (int i = 0; i < numRays; ++i) {
+                hitPositions.row(i) = hits[i].hitPos.transpose();
+                hitNormals.row(i) = hits[i].hitNormal.transpose();
+                hitDists[i] = hits[i].hitDist;
+                reached[i] = hits[i].reached;
+              }
+            }
+            return py::dict("hit_positions"_a = hitPositions,
+                            "hit_normals"_a = hitNormals,
+                            "hit_dists"_a = hitDists, "reached"_a = reached);
+          },
+          R"(Same as :py:meth:`raycast` for every row of :py:attr:`starts`
+          and the same row of :py:attr:`ends` (both Nx3 arrays) in parallel.
+          Returns a dict of arrays with one row per ray: hit_positions,
+          hit_normals, hit_dists and reached.)",
+          "starts"_a, "ends"_a)
+      .def(
+          "get_bounds",
+          [](PathFinder& self) {
+            const box3f bounds = self.getNavMeshBounds();
+            return std::make_pair(bounds.min(), bounds.max());
+          },
+          R"(Returns the (min, max) corners of the axis aligned bounding box
+          of the navmesh, the top down views start at min.)")
+      .def("get_topdown_view", &PathFinder::getTopDownView,
+           R"(Rasterizes the navmesh into a top down occupancy map, a 2D uint8
+          array that is 1 where a pixel center is navigable within
+          :py:attr:`max_y_delta` of :py:attr:`height`. Row i and column j
+          cover min + (j, i) * :py:attr:`meters_per_pixel` in x and z, with
+          min from :py:meth:`get_bounds`.)",
+           "meters_per_pixel"_a, "height"_a, "max_y_delta"_a = 0.5,
+           py::call_guard<py::gil_scoped_release>())
+      .def("get_topdown_views", &PathFinder::getTopDownViews,
+           R"(Same as :py:meth:`get_topdown_view` for every one of
+          :py:attr:`heights`, one per floor, rasterized in parallel.)",
+           "meters_per_pixel"_a, "heights"_a, "max_y_delta"_a = 0.5,
+           py::call_guard<py::gil_scoped_release>())
+      .def("island_radius", &PathFinder::islandRadius, R"()", "pt"_a,
+           py::call_guard<py::gil_scoped_release>())
+      .def("island_area", &PathFinder::islandArea,
+           R"(Navigable surface area of the island pt is on, 0 if pt isn't on
+          the navmesh)",
+           "pt"_a, py::call_guard<py::gil_scoped_release>())
+      .def("seed", &PathFinder::seed, "new_seed"_a)
+      .def("geodesic_distance_to_goals", &PathFinder::geodesicDistanceToGoals,
+           R"(Returns the geodesic distance from pt to the closest of goals.
+          The distance field of goals is computed on first use and cached, so
+          repeated queries against the same goals are cheap.  The distance
+          follows navmesh polygon corners, so it is a few percent longer than
+          the one find_path returns across open space)",
+           "pt"_a, "goals"_a, py::call_guard<py::gil_scoped_release>())
+      .def("set_object_goals", &PathFinder::setObjectGoals,
+           R"(Sets the object goals named :py:attr:`name` to the
+          :py:class:`OBB` list :py:attr:`objects`. An object is reached from
+          the navigable points within :py:attr:`radius` of its footprint and
+          at most :py:attr:`max_y_delta` below it, the distance field to all
+          of those points is precomputed. Returns False if no navigable point
+          reaches any object.)",
+           "name"_a, "objects"_a, "radius"_a = 1.0, "max_y_delta"_a = 1.5,
+           py::call_guard<py::gil_scoped_release>())
+      .def("set_category_goals", &PathFinder::setCategoryGoals,
+           R"(Same as :py:meth:`set_object_goals` for the objects of
+          :py:attr:`semantic_scene` in :py:attr:`category`, with the goals
+          named after the category.)",
+           "semantic_scene"_a, "category"_a, "radius"_a = 1.0,
+           "max_y_delta"_a = 1.5, py::call_guard<py::gil_scoped_release>())
+      .def("geodesic_distance_to_objects",
+           &PathFinder::geodesicDistanceToObjects,
+           R"(Returns the geodesic distance from pt to the closest object of
+          the goals named :py:attr:`name`, see :py:meth:`set_object_goals`.
+          0 if pt reaches an object itself, infinity if none is reachable.)",
+           "pt"_a, "name"_a, py::call_guard<py::gil_scoped_release>())
+      .def_property("distance_field_cache_size",
+                    &PathFinder::getDistanceFieldCacheSize,
+                    &PathFinder::setDistanceFieldCacheSize)
       .def_property_readonly("is_loaded", &PathFinder::isLoaded)
-      .def("load_nav_mesh", &PathFinder::loadNavMesh)
+      .def("load_nav_mesh", &PathFinder::loadNavMesh,
+           R"(Loads a navmesh file.  Navmeshes are shared with every other
+          PathFinder in the process that loads the same file, and recently
+          used ones stay cached, see :py:meth:`set_nav_mesh_cache_capacity`)",
+           "path"_a)
+      .def_static("set_nav_mesh_cache_capacity",
+                  &PathFinder::setNavMeshCacheCapacity,
+                  R"(Sets how many bytes of navmeshes stay cached after the
+          last PathFinder using them is gone.  512MiB by default)",
+                  "capacity"_a)
+      .def_static("get_nav_mesh_cache_capacity",
+                  &PathFinder::getNavMeshCacheCapacity)
+      .def_static("get_nav_mesh_cache_size", &PathFinder::getNavMeshCacheSize)
       .def("distance_to_closest_obstacle",
            &PathFinder::distanceToClosestObstacle,
            R"(Returns the distance to the closest obstacle.
            If this distance is greater than :py:attr:`max_search_radius`,
            :py:attr:`max_search_radius` is returned instead.)",
-           "pt"_a, "max_search_radius"_a = 2.0)
+           "pt"_a, "max_search_radius"_a = 2.0,
+           py::call_guard<py::gil_scoped_release>())
       .def(
           "closest_obstacle_surface_point",
           &PathFinder::closestObstacleSurfacePoint,
           R"(Returns the hit_pos, hit_normal, and hit_dist of the surface point on the closest obstacle.
            If the returned hit_dist is equal to :py:attr:`max_search_radius`,
            no obstacle was found.)",
-          "pt"_a, "max_search_radius"_a = 2.0)
+          "pt"_a, "max_search_radius"_a = 2.0,
+          py::call_guard<py::gil_scoped_release>())
+      .def("set_obstacle_distance_grid_cell_size",
+           &PathFinder::setObstacleDistanceGridCellSize,
+           R"(Precomputes :py:meth:`closest_obstacle_surface_point` on a grid
+          with :py:attr:`cell_size` spacing, up to
+          :py:attr:`max_search_radius`, and answers it by bilinear lookup
+          from then on. The grid is rebuilt with the navmesh. 0 disables it.)",
+           "cell_size"_a, "max_search_radius"_a = 2.0)
+      .def_property_readonly("obstacle_distance_grid_cell_size",
+                             &PathFinder::getObstacleDistanceGridCellSize)
       .def("is_navigable", &PathFinder::isNavigable,
            R"(Checks to see if the agent can stand at the specified point.
           To check navigability, the point is snapped to the nearest polygon and
@@ -73,7 +446,69 @@ void initShortestPathBindings(py::module& m) {
           Any amount of x-z translation indicates that the given point is not navigable.
           The amount of y-translation allowed is specified by max_y_delta to account
           for slight differences in floor height)",
-           "pt"_a, "max_y_delta"_a = 0.5);
+           "pt"_a, "max_y_delta"_a = 0.5,
+           py::call_guard<py::gil_scoped_release>())
+      .def("snap_point", &PathFinder::snapPoint,
+           R"(Returns the closest point on the navmesh to :py:attr:`pt`, or
+          NaNs if there is no navmesh close by)",
+           "pt"_a, py::call_guard<py::gil_scoped_release>())
+      .def(
+          "snap_points",
+          [](PathFinder& self, const Eigen::Ref<const RowMatrixX3f>& points) {
+            std::vector<vec3f> pts(points.rows());
+            for (int i = 0; i < pts.size(); ++i)
+              pts[i] = points.row(i).transpose();
+
+            RowMatrixX3f results(pts.size(), 3);
+            {
+              py::gil_scoped_release release;
+              std::vector<vec3f> snapped;
+              self.snapPoints(pts, snapped);
+              for (int i = 0; i < snapped.size(); ++i)
+                results.row(i) = snapped[i].transpose();
+            }
+            return results;
+          },
+          R"(Same as :py:meth:`snap_point` for every row of the Nx3 array
+          :py:attr:`points` in parallel.)",
+          "points"_a)
+      .def("set_poly_grid_index_cell_size",
+           &PathFinder::setPolyGridIndexCellSize,
+           R"(Indexes the navmesh polygons in a grid with :py:attr:`cell_size`
+          cells, which speeds up snapping points that lie on the navmesh, the
+          first step of almost every query. Results don't change. The index
+          is rebuilt with the navmesh. 0 disables it.)",
+           "cell_size"_a)
+      .def_property_readonly("poly_grid_index_cell_size",
+                             &PathFinder::getPolyGridIndexCellSize)
+      .def("set_cluster_graph_cell_size",
+           &PathFinder::setClusterGraphCellSize,
+           R"(Groups the navmesh polygons into clusters of about
+          :py:attr:`cell_size` and makes :py:meth:`find_path` search the
+          clusters first and then only the polygons of the clusters on the
+          way. Long paths on large navmeshes get faster and path lengths stay
+          within a few percent. The graph is rebuilt with the navmesh. 0
+          disables it.)",
+           "cell_size"_a)
+      .def_property_readonly("cluster_graph_cell_size",
+                             &PathFinder::getClusterGraphCellSize)
+      .def("set_path_cache_budget", &PathFinder::setPathCacheBudget,
+           R"(Caches the polygon corridors :py:meth:`find_path` finds for
+          single goal queries, in at most :py:attr:`max_bytes`, for loops
+          that repeat the same start and goal. Endpoints within the same
+          :py:attr:`quantization` cell and polygons share an entry, and paths
+          are still pulled tight with the exact endpoints, so they always
+          start and end at the requested points. The cache is emptied with
+          the navmesh. 0 disables it.)",
+           "max_bytes"_a, "quantization"_a = 0.01)
+      .def_property_readonly("path_cache_budget",
+                             &PathFinder::getPathCacheBudget)
+      .def_property_readonly("path_cache_quantization",
+                             &PathFinder::getPathCacheQuantization)
+      .def_property_readonly(
+          "path_cache_stats", &PathFinder::getPathCacheStats,
+          R"(Hits and misses of the :py:meth:`find_path` cache since it was
+          last emptied)");
 
   py::class_<GreedyGeodesicFollowerImpl, GreedyGeodesicFollowerImpl::ptr>(
       m, "GreedyGeodesicFollowerImpl")
@@ -82,14 +517,50 @@ void initShortestPathBindings(py::module& m) {
               PathFinder::ptr&, GreedyGeodesicFollowerImpl::MoveFn&,
               GreedyGeodesicFollowerImpl::MoveFn&,
               GreedyGeodesicFollowerImpl::MoveFn&, double, double, double>))
+      .def(py::init(&GreedyGeodesicFollowerImpl::create<
+                    PathFinder::ptr&, const std::string&,
+                    const agent::ActuationMap&, const std::string&,
+                    const agent::ActuationMap&, const std::string&,
+                    const agent::ActuationMap&, double>),
+           R"(Creates a follower that moves with the native ObjectControls
+          actions forward_action, left_action and right_action and filters
+          steps with pathfinder.try_step, so it never calls back into python.
+          Raises ValueError if an action isn't one of ObjectControls)",
+           "pathfinder"_a, "forward_action"_a, "forward_actuation"_a,
+           "left_action"_a, "left_actuation"_a, "right_action"_a,
+           "right_actuation"_a, "goal_dist"_a)
       .def("next_action_along",
            py::overload_cast<const vec3f&, const vec4f&, const vec3f&>(
                &GreedyGeodesicFollowerImpl::nextActionAlong),
-           py::return_value_policy::move)
+           py::return_value_policy::move,
+           py::call_guard<py::gil_scoped_release>())
       .def("find_path",
            py::overload_cast<const vec3f&, const vec4f&, const vec3f&>(
                &GreedyGeodesicFollowerImpl::findPath),
-           py::return_value_policy::move);
+           py::return_value_policy::move,
+           py::call_guard<py::gil_scoped_release>())
+      .def_property("use_distance_field",
+                    &GreedyGeodesicFollowerImpl::getUseDistanceField,
+                    &GreedyGeodesicFollowerImpl::setUseDistanceField,
+                    R"(Whether to check the progress of steps forward with
+          the cached distance field of the goal instead of a findPath per
+          step, see :py:meth:`PathFinder.geodesic_distance_to_goals`)");
+
+  py::class_<ActionSpacePathFinder, ActionSpacePathFinder::ptr>(
+      m, "ActionSpacePathFinder")
+      .def(py::init(&ActionSpacePathFinder::create<PathFinder::ptr&, double,
+                                                   double, double, double,
+                                                   int>),
+           "pathfinder"_a, "forward_amount"_a, "turn_amount"_a, "goal_dist"_a,
+           "cell_size"_a = 0, "max_expansions"_a = 1000000)
+      .def("find_path",
+           py::overload_cast<const vec3f&, const vec4f&, const vec3f&>(
+               &ActionSpacePathFinder::findPath, py::const_),
+           R"(Finds the shortest sequence of GreedyFollowerCodes that takes an
+          agent starting at start_pos with rotation start_rot to within goal_dist
+          of end.  Ends with STOP, empty if the goal can't be reached)",
+           "start_pos"_a, "start_rot"_a, "end"_a,
+           py::call_guard<py::gil_scoped_release>());
 
   py::enum_<GreedyGeodesicFollowerImpl::CODES>(m, "GreedyFollowerCodes")
       .value("ERROR", GreedyGeodesicFollowerImpl::CODES::ERROR)
@@ -404,6 +404,14 @@ PYBIND11_MODULE(habitat_sim_bindings, m) {
 
   // ==== OBB ====
   py::class_<OBB>(m, "OBB")
+      .def(py::init([](const vec3f& center, const vec3f& sizes,
+                       const Eigen::Ref<const vec4f> rotation) {
+             return OBB(center, sizes,
+                        Eigen::Map<const quatf>(rotation.data()));
+           }),
+           R"(Box of the given sizes centered on center, rotated by the
+          quaternion with coefficients rotation (x, y, z, w))",
+           "center"_a, "sizes"_a, "rotation"_a = vec4f(0, 0, 0, 1))
       .def_property_readonly("center", &OBB::center)
       .def_property_readonly("sizes", &OBB::sizes)
       .def_property_readonly("half_extents", &OBB::halfExtents)
@@ -0,0 +1,305 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "ActionSpacePathFinder.h"
+
+#include <algorithm>
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <unordered_map>
+
+#include "esp/geo/geo.h"
+#include "esp/nav/GeodesicDistanceField.h"
+
+#include "DetourNavMeshQuery.h"
+
+namespace esp {
+namespace nav {
+
+namespace impl {
+
+// The lattice of agent states searched by ActionSpacePathFinder.  Nodes are
+// created lazily as the search reaches them
+struct ActionSpaceGraph {
+  typedef ActionSpacePathFinder::CODES CODES;
+
+  struct Key {
+    int x, y, z, heading;
+    bool operator==(const Key& other) const {
+      return x == other.x && y == other.y && z == other.z &&
+             heading == other.heading;
+    }
+  };
+  struct KeyHash {
+    size_t operator()(const Key& key) const {
+      size_t hash = std::hash<int>()(key.x);
+      for (int v : {key.y, key.z, key.heading})
+        hash = hash * 1000003 ^ std::hash<int>()(v);
+      return hash;
+    }
+  };
+
+  struct Node {
+    vec3f pos;
+    int heading;
+    //! Number of actions from the start
+    int cost;
+    //! Distance to the goal in the distance field, an upper bound
+    float goalDist;
+    //! First corner of the shortest path to the goal
+    vec3f nextPoint;
+    int parent;
+    CODES action;
+    bool closed;
+  };
+
+  ActionSpaceGraph(PathFinder& pathfinder,
+                   const vec3f& goal,
+                   const std::vector<vec3f>& forwardDirs,
+                   float forwardAmount,
+                   float goalDist,
+                   float cellSize)
+      : pathfinder_(pathfinder),
+        goal_(goal),
+        field_(pathfinder.getDistanceField({goal})),
+        forwardDirs_(forwardDirs),
+        forwardAmount_(forwardAmount),
+        headingStep_(2 * M_PI / forwardDirs.size()),
+        goalDist_(goalDist),
+        cellSize_(cellSize) {
+    // Only used to snap points, which doesn't need many nodes
+    navQuery_ = dtAllocNavMeshQuery();
+    if (navQuery_ &&
+        dtStatusFailed(navQuery_->init(pathfinder.navMesh_, 64))) {
+      dtFreeNavMeshQuery(navQuery_);
+      navQuery_ = nullptr;
+    }
+  }
+  ~ActionSpaceGraph() { dtFreeNavMeshQuery(navQuery_); }
+
+  float distanceToGoal(const vec3f& pt, vec3f* nextPoint) const {
+    // Same search box as the rest of PathFinder
+    constexpr float polyPickExt[3] = {2, 4, 2};
+    dtPolyRef ref;
+    vec3f polyPt;
+    dtStatus status = navQuery_->findNearestPoly(
+        pt.data(), polyPickExt, pathfinder_.filter_, &ref, polyPt.data());
+    if (status != DT_SUCCESS || ref == 0)
+      return std::numeric_limits<float>::infinity();
+    return field_->distance(ref, polyPt, nextPoint);
+  }
+
+  float distanceToGoalXZ(const vec3f& pt) const {
+    return Eigen::Vector2f(goal_[0] - pt[0], goal_[2] - pt[2]).norm();
+  }
+
+  //! Lower bound of the number of actions left.  A forward move shrinks the
+  //! straight line distance to the goal in the xz plane by at most
+  //! forwardAmount, and the geodesic distance is never shorter than it.  The
+  //! distance field can't be used here as it overestimates
+  float heuristic(const Node& node) const {
+    return std::max(distanceToGoalXZ(node.pos) - goalDist_, 0.0f) /
+           forwardAmount_;
+  }
+
+  //! Whether the agent is close enough to the goal to stop, by the same
+  //! findPath distance GreedyGeodesicFollowerImpl stops at
+  bool reachesGoal(const vec3f& pt) const {
+    // The geodesic distance is at least the straight line distance, up to
+    // the snapping of the endpoints to the navmesh
+    constexpr float kSnapSlack = 0.05;
+    if (distanceToGoalXZ(pt) >= goalDist_ + kSnapSlack)
+      return false;
+    ShortestPath path;
+    path.requestedStart = pt;
+    path.requestedEnd = goal_;
+    return pathfinder_.findPath(path) && path.geodesicDistance < goalDist_;
+  }
+
+  //! Estimate of the number of actions left along the distance field, to
+  //! break ties between nodes of the same heuristic
+  float fieldActionsLeft(const Node& node) const {
+    return std::max(node.goalDist - goalDist_, 0.0f) / forwardAmount_ +
+           turnsToNextPoint(node);
+  }
+
+  //! Number of turns until the agent faces the first corner of the shortest
+  //! path within one heading step.  Not a lower bound, as the agent may
+  //! follow the path without facing its corners exactly
+  float turnsToNextPoint(const Node& node) const {
+    const vec3f& dir = forwardDirs_[node.heading];
+    vec3f toNext = node.nextPoint - node.pos;
+    toNext[1] = 0;
+    if (toNext.squaredNorm() < 1e-6)
+      return 0;
+    const float angle =
+        std::atan2(dir.cross(toNext)[1], dir.dot(toNext)) / headingStep_;
+    return std::max(std::ceil(std::abs(angle)) - 1, 0.0f);
+  }
+
+  Key key(const vec3f& pos, int heading) const {
+    return {static_cast<int>(std::floor(pos[0] / cellSize_)),
+            static_cast<int>(std::floor(pos[1] / cellSize_)),
+            static_cast<int>(std::floor(pos[2] / cellSize_)), heading};
+  }
+
+  // Returns the index of the node at (pos, heading), creating it if needed
+  int getNode(const vec3f& pos, int heading) {
+    auto result = nodeIds_.emplace(key(pos, heading), nodes_.size());
+    if (result.second) {
+      nodes_.push_back({pos, heading, std::numeric_limits<int>::max(),
+                        std::numeric_limits<float>::infinity(), pos, -1,
+                        CODES::STOP, false});
+    }
+    return result.first->second;
+  }
+
+  PathFinder& pathfinder_;
+  const vec3f goal_;
+  std::shared_ptr<const GeodesicDistanceField> field_;
+  dtNavMeshQuery* navQuery_;
+  const std::vector<vec3f>& forwardDirs_;
+  const float forwardAmount_, headingStep_, goalDist_, cellSize_;
+
+  std::vector<Node> nodes_;
+  std::unordered_map<Key, int, KeyHash> nodeIds_;
+};
+
+}  // namespace impl
+
+ActionSpacePathFinder::ActionSpacePathFinder(PathFinder::ptr& pathfinder,
+                                             double forwardAmount,
+                                             double turnAmount,
+                                             double goalDist,
+                                             double cellSize /*= 0*/,
+                                             int maxExpansions /*= 1e6*/)
+    : pathfinder_{pathfinder},
+      forwardAmount_(forwardAmount),
+      turnAmount_(turnAmount),
+      goalDist_(goalDist),
+      cellSize_(cellSize > 0 ? cellSize : forwardAmount / 2),
+      maxExpansions_(maxExpansions) {
+  const double numHeadings = 2 * M_PI / turnAmount;
+  if (std::abs(numHeadings - std::round(numHeadings)) > 1e-3) {
+    LOG(WARNING) << "turnAmount doesn't evenly divide 2 pi, headings will be "
+                    "rounded to multiples of "
+                 << 2 * M_PI / std::round(numHeadings);
+  }
+}
+
+std::vector<ActionSpacePathFinder::CODES> ActionSpacePathFinder::findPath(
+    const State& start,
+    const vec3f& end) const {
+  typedef impl::ActionSpaceGraph::Node Node;
+  std::vector<CODES> actions;
+  if (!pathfinder_->isLoaded())
+    return actions;
+
+  // Forward direction for every heading, i.e. number of left turns taken
+  const int numHeadings =
+      std::max(static_cast<int>(std::round(2 * M_PI / turnAmount_)), 1);
+  std::vector<vec3f> forwardDirs;
+  for (int heading = 0; heading < numHeadings; ++heading) {
+    const quatf rot =
+        std::get<1>(start) *
+        quatf(Eigen::AngleAxisf(2 * M_PI * heading / numHeadings, geo::ESP_UP));
+    forwardDirs.emplace_back(rot * geo::ESP_FRONT);
+  }
+
+  impl::ActionSpaceGraph graph(*pathfinder_, end, forwardDirs, forwardAmount_,
+                               goalDist_, cellSize_);
+  if (!graph.navQuery_) {
+    LOG(ERROR) << "ActionSpacePathFinder failed to create a navmesh query";
+    return actions;
+  }
+  const vec3f& startPos = std::get<0>(start);
+  const int startNode = graph.getNode(startPos, 0);
+  {
+    Node& node = graph.nodes_[startNode];
+    node.goalDist = graph.distanceToGoal(startPos, &node.nextPoint);
+    if (node.goalDist == std::numeric_limits<float>::infinity())
+      return actions;
+    node.cost = 0;
+  }
+
+  // Ordered by estimated total cost, then by the number of actions left
+  // along the distance field including turns, so that nodes closer to the
+  // goal and facing the right way are expanded first among equals
+  typedef std::tuple<float, float, int> QueueEntry;
+  std::priority_queue<QueueEntry, std::vector<QueueEntry>,
+                      std::greater<QueueEntry>>
+      queue;
+  queue.emplace(graph.heuristic(graph.nodes_[startNode]),
+                graph.fieldActionsLeft(graph.nodes_[startNode]), startNode);
+
+  int goalNode = -1;
+  for (int numExpansions = 0; !queue.empty() && numExpansions < maxExpansions_;
+       ++numExpansions) {
+    const int nodeIdx = std::get<2>(queue.top());
+    queue.pop();
+    if (graph.nodes_[nodeIdx].closed)
+      continue;
+    graph.nodes_[nodeIdx].closed = true;
+    // Copy as getNode may reallocate nodes_
+    const Node node = graph.nodes_[nodeIdx];
+
+    if (graph.reachesGoal(node.pos)) {
+      goalNode = nodeIdx;
+      break;
+    }
+
+    // States merged into one lattice node take the position of the cheapest
+    auto relax = [&](int nextIdx, CODES action, const vec3f& pos,
+                     float goalDist, const vec3f& nextPoint) {
+      Node& next = graph.nodes_[nextIdx];
+      if (next.closed || next.cost <= node.cost + 1)
+        return;
+      next.pos = pos;
+      next.goalDist = goalDist;
+      next.nextPoint = nextPoint;
+      next.cost = node.cost + 1;
+      next.parent = nodeIdx;
+      next.action = action;
+      queue.emplace(next.cost + graph.heuristic(next),
+                    graph.fieldActionsLeft(next), nextIdx);
+    };
+
+    // Turning doesn't change the position, and so the distance to the goal
+    const int left = (node.heading + 1) % numHeadings;
+    relax(graph.getNode(node.pos, left), CODES::LEFT, node.pos, node.goalDist,
+          node.nextPoint);
+    const int right = (node.heading + numHeadings - 1) % numHeadings;
+    relax(graph.getNode(node.pos, right), CODES::RIGHT, node.pos,
+          node.goalDist, node.nextPoint);
+
+    const vec3f nextPos = pathfinder_->tryStep(
+        node.pos, node.pos + forwardAmount_ * forwardDirs[node.heading]);
+    vec3f nextPoint;
+    const float nextGoalDist = graph.distanceToGoal(nextPos, &nextPoint);
+    if (nextGoalDist < std::numeric_limits<float>::infinity())
+      relax(graph.getNode(nextPos, node.heading), CODES::FORWARD, nextPos,
+            nextGoalDist, nextPoint);
+  }
+
+  if (goalNode < 0) {
+    VLOG(1) << "No action sequence found after expanding "
+            << graph.nodes_.size() << " states";
+    return actions;
+  }
+
+  actions.push_back(CODES::STOP);
+  for (int nodeIdx = goalNode; graph.nodes_[nodeIdx].parent >= 0;
+       nodeIdx = graph.nodes_[nodeIdx].parent) {
+    actions.push_back(graph.nodes_[nodeIdx].action);
+  }
+  std::reverse(actions.begin(), actions.end());
+
+  return actions;
+}
+
+}  // namespace nav
+}  // namespace esp
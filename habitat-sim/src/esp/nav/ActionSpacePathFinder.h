@@ -0,0 +1,90 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <vector>
+
+#include "esp/core/esp.h"
+#include "esp/nav/GreedyFollower.h"
+#include "esp/nav/PathFinder.h"
+
+namespace esp {
+namespace nav {
+
+/**
+ * Plans the shortest sequence of discrete actions (move forward by a fixed
+ * amount, turn left or right by a fixed angle) that takes an agent to within
+ * a radius of a goal.
+ *
+ * Unlike GreedyGeodesicFollowerImpl, which greedily turns towards the next
+ * corner of the geodesic shortest path, this runs an A* search over a lattice
+ * of (position, heading) states.  Every action costs 1, forward moves are
+ * passed through PathFinder::tryStep exactly like the agent's step filter,
+ * and the straight line distance to the goal divided by the forward amount is
+ * the heuristic, which never overestimates.  The search stops at the first
+ * state whose PathFinder::findPath distance to the goal is below goalDist,
+ * where GreedyGeodesicFollowerImpl would call stop.  Positions are
+ * continuous, two states are merged when they fall into the same lattice
+ * cell with the same heading, so the plan is optimal up to that merging.
+ *
+ * Everything runs in C++, so findPath can be called concurrently from any
+ * number of threads.
+ **/
+class ActionSpacePathFinder {
+ public:
+  typedef GreedyGeodesicFollowerImpl::CODES CODES;
+  typedef GreedyGeodesicFollowerImpl::State State;
+
+  /**
+   * Params
+   * @param[in] pathfinder Instance of the pathfinder with the navmesh loaded
+   * @param[in] forwardAmount The amount "move_forward" moves the agent
+   * @param[in] turnAmount The amount "turn_left"/"turn_right" turns the agent
+   *in radians.  The search is exact if it evenly divides 2 pi
+   * @param[in] goalDist How close the agent needs to get to the goal before
+   *calling stop
+   * @param[in] cellSize Size of the lattice cells, defaults to half of
+   *forwardAmount if <= 0.  Smaller cells merge fewer states, so the plans get
+   *closer to optimal at the cost of a larger search
+   * @param[in] maxExpansions Number of states expanded before giving up
+   **/
+  ActionSpacePathFinder(PathFinder::ptr& pathfinder,
+                        double forwardAmount,
+                        double turnAmount,
+                        double goalDist,
+                        double cellSize = 0,
+                        int maxExpansions = 1e6);
+
+  /**
+   * Finds the shortest action sequence from the start state to the goal.  It
+   * ends with STOP and is empty if the goal can't be reached
+   **/
+  std::vector<CODES> findPath(const State& start, const vec3f& end) const;
+
+  /**
+   * Finds the shortest action sequence from the start state to the goal
+   *
+   * Params
+   * @param[in] startPos The starting position
+   * @param[in] startRot The starting rotation
+   * @param[in] end The end location of the path
+   **/
+  inline std::vector<CODES> findPath(const vec3f& startPos,
+                                     const vec4f& startRot,
+                                     const vec3f& end) const {
+    quatf rot = Eigen::Map<const quatf>(startRot.data());
+    return findPath(std::make_tuple(startPos, rot), end);
+  }
+
+ private:
+  PathFinder::ptr pathfinder_;
+  const float forwardAmount_, turnAmount_, goalDist_, cellSize_;
+  const int maxExpansions_;
+
+  ESP_SMART_POINTERS(ActionSpacePathFinder)
+};
+
+}  // namespace nav
+}  // namespace esp
@@ -0,0 +1,477 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "ClusterGraph.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <utility>
+
+#include "DetourCommon.h"
+#include "DetourNavMeshQuery.h"
+
+namespace esp {
+namespace nav {
+namespace impl {
+
+namespace {
+const float INF = std::numeric_limits<float>::infinity();
+// Key of the target in the open lists, which otherwise hold node indices
+const int TARGET = -1;
+
+typedef std::pair<float, int> QueueEntry;
+typedef std::priority_queue<QueueEntry,
+                            std::vector<QueueEntry>,
+                            std::greater<QueueEntry>>
+    OpenList;
+
+// Ends and midpoint of the edge poly shares through link, clamped to the
+// part of the edge the neighbour covers for links across tile borders like
+// dtNavMeshQuery::getPortalPoints
+void portalPoints(const dtMeshTile* tile,
+                  const dtPoly* poly,
+                  const dtLink& link,
+                  vec3f* points) {
+  const float* v0 = &tile->verts[poly->verts[link.edge] * 3];
+  const float* v1 =
+      &tile->verts[poly->verts[(link.edge + 1) % poly->vertCount] * 3];
+  points[0] = Eigen::Map<const vec3f>(v0);
+  points[2] = Eigen::Map<const vec3f>(v1);
+  if (link.side != 0xff && (link.bmin != 0 || link.bmax != 255)) {
+    const float s = 1.0f / 255.0f;
+    dtVlerp(points[0].data(), v0, v1, link.bmin * s);
+    dtVlerp(points[2].data(), v0, v1, link.bmax * s);
+  }
+  points[1] = (points[0] + points[2]) / 2;
+}
+}  // namespace
+
+ClusterGraph::ClusterGraph(const dtNavMesh* navMesh,
+                           const dtQueryFilter* filter,
+                           float cellSize)
+    : navMesh_{navMesh}, cellSize_{cellSize} {
+  tilePolyBase_.resize(navMesh->getMaxTiles());
+  for (int iTile = 0; iTile < navMesh->getMaxTiles(); ++iTile) {
+    tilePolyBase_[iTile] = polyRefs_.size();
+    const dtMeshTile* tile = navMesh->getTile(iTile);
+    if (!tile || !tile->header)
+      continue;
+    const dtPolyRef base = navMesh->getPolyRefBase(tile);
+    for (int jPoly = 0; jPoly < tile->header->polyCount; ++jPoly)
+      polyRefs_.push_back(base | jPoly);
+  }
+  const int numPolys = polyRefs_.size();
+
+  // Portals between traversable polygons, and the grid cell of every
+  // traversable polygon's center
+  std::vector<bool> traversable(numPolys, false);
+  std::vector<std::pair<int, int>> polyCell(numPolys);
+  for (int iTile = 0; iTile < navMesh->getMaxTiles(); ++iTile) {
+    const dtMeshTile* tile = navMesh->getTile(iTile);
+    if (!tile || !tile->header)
+      continue;
+    for (int jPoly = 0; jPoly < tile->header->polyCount; ++jPoly) {
+      const dtPoly* poly = &tile->polys[jPoly];
+      const int a = tilePolyBase_[iTile] + jPoly;
+      if (poly->getType() != DT_POLYTYPE_GROUND ||
+          !filter->passFilter(polyRefs_[a], tile, poly))
+        continue;
+      traversable[a] = true;
+
+      vec3f center = vec3f::Zero();
+      for (int k = 0; k < poly->vertCount; ++k)
+        center += Eigen::Map<const vec3f>(&tile->verts[poly->verts[k] * 3]);
+      center /= poly->vertCount;
+      polyCell[a] = {static_cast<int>(std::floor(center[0] / cellSize_)),
+                     static_cast<int>(std::floor(center[2] / cellSize_))};
+    }
+  }
+  for (int iTile = 0; iTile < navMesh->getMaxTiles(); ++iTile) {
+    const dtMeshTile* tile = navMesh->getTile(iTile);
+    if (!tile || !tile->header)
+      continue;
+    for (int jPoly = 0; jPoly < tile->header->polyCount; ++jPoly) {
+      const int a = tilePolyBase_[iTile] + jPoly;
+      if (!traversable[a])
+        continue;
+      const dtPoly* poly = &tile->polys[jPoly];
+      // Every portal is found from both of its polygons, keep one
+      for (unsigned int iLink = poly->firstLink; iLink != DT_NULL_LINK;
+           iLink = tile->links[iLink].next) {
+        const dtLink& link = tile->links[iLink];
+        if (!link.ref)
+          continue;
+        const int b = tilePolyBase_[navMesh->decodePolyIdTile(link.ref)] +
+                      navMesh->decodePolyIdPoly(link.ref);
+        if (b <= a || !traversable[b])
+          continue;
+        portals_.emplace_back();
+        portals_.back().polys[0] = a;
+        portals_.back().polys[1] = b;
+        portalPoints(tile, poly, link, portals_.back().points);
+      }
+    }
+  }
+
+  polyPortalStart_.assign(numPolys + 1, 0);
+  for (const auto& portal : portals_) {
+    ++polyPortalStart_[portal.polys[0] + 1];
+    ++polyPortalStart_[portal.polys[1] + 1];
+  }
+  for (int i = 0; i < numPolys; ++i)
+    polyPortalStart_[i + 1] += polyPortalStart_[i];
+  polyPortals_.resize(polyPortalStart_[numPolys]);
+  {
+    std::vector<int> fill(polyPortalStart_.begin(), polyPortalStart_.end() - 1);
+    for (int i = 0; i < portals_.size(); ++i) {
+      polyPortals_[fill[portals_[i].polys[0]]++] = i;
+      polyPortals_[fill[portals_[i].polys[1]]++] = i;
+    }
+  }
+
+  // Clusters are flood filled within each cell, so polygons of different
+  // floors or of rooms separated by a wall end up in different clusters
+  polyCluster_.assign(numPolys, -1);
+  int numClusters = 0;
+  std::vector<int> stack;
+  for (int seed = 0; seed < numPolys; ++seed) {
+    if (!traversable[seed] || polyCluster_[seed] >= 0)
+      continue;
+    const int cluster = numClusters++;
+    polyCluster_[seed] = cluster;
+    stack.push_back(seed);
+    while (!stack.empty()) {
+      const int poly = stack.back();
+      stack.pop_back();
+      for (int k = polyPortalStart_[poly]; k < polyPortalStart_[poly + 1];
+           ++k) {
+        const Portal& portal = portals_[polyPortals_[k]];
+        const int other = portal.polys[portal.polys[0] == poly ? 1 : 0];
+        if (polyCluster_[other] < 0 && polyCell[other] == polyCell[seed]) {
+          polyCluster_[other] = cluster;
+          stack.push_back(other);
+        }
+      }
+    }
+  }
+
+  portalEntrance_.assign(portals_.size(), -1);
+  clusterEntranceStart_.assign(numClusters + 1, 0);
+  for (int i = 0; i < portals_.size(); ++i) {
+    const int clusterA = polyCluster_[portals_[i].polys[0]];
+    const int clusterB = polyCluster_[portals_[i].polys[1]];
+    if (clusterA == clusterB)
+      continue;
+    portalEntrance_[i] = entrancePortal_.size();
+    entrancePortal_.push_back(i);
+    ++clusterEntranceStart_[clusterA + 1];
+    ++clusterEntranceStart_[clusterB + 1];
+  }
+  for (int i = 0; i < numClusters; ++i)
+    clusterEntranceStart_[i + 1] += clusterEntranceStart_[i];
+  clusterEntrances_.resize(clusterEntranceStart_[numClusters]);
+  {
+    std::vector<int> fill(clusterEntranceStart_.begin(),
+                          clusterEntranceStart_.end() - 1);
+    for (int i = 0; i < entrancePortal_.size(); ++i) {
+      const Portal& portal = portals_[entrancePortal_[i]];
+      clusterEntrances_[fill[polyCluster_[portal.polys[0]]]++] = i;
+      clusterEntrances_[fill[polyCluster_[portal.polys[1]]]++] = i;
+    }
+  }
+
+  // Distances between the points of the entrances of every cluster.  The
+  // clusters are independent, so they are spread over all cores like
+  // PathFinder::findPaths
+  std::vector<std::vector<std::pair<int, Edge>>> clusterEdges(numClusters);
+#pragma omp parallel for schedule(dynamic, 64)
+  for (int cluster = 0; cluster < numClusters; ++cluster) {
+    auto inCluster = [this, cluster](int poly) {
+      return polyCluster_[poly] == cluster;
+    };
+    for (int i = clusterEntranceStart_[cluster];
+         i < clusterEntranceStart_[cluster + 1]; ++i) {
+      const int entrance = clusterEntrances_[i];
+      const Portal& portal = portals_[entrancePortal_[entrance]];
+      const int sourcePoly =
+          portal.polys[polyCluster_[portal.polys[0]] == cluster ? 0 : 1];
+      for (int from = entrance * POINTS_PER_PORTAL;
+           from < (entrance + 1) * POINTS_PER_PORTAL; ++from) {
+        NodeVisits& visits =
+            searchPortals(sourcePoly, nodePos(entranceNode(from)), -1,
+                          nodePos(entranceNode(from)), inCluster, nullptr);
+        for (int j = clusterEntranceStart_[cluster];
+             j < clusterEntranceStart_[cluster + 1]; ++j) {
+          for (int to = clusterEntrances_[j] * POINTS_PER_PORTAL;
+               to < (clusterEntrances_[j] + 1) * POINTS_PER_PORTAL; ++to) {
+            const Visit* visit = visits.find(entranceNode(to));
+            if (to != from && visit)
+              clusterEdges[cluster].push_back(
+                  {from, {to, visit->cost, cluster}});
+          }
+        }
+      }
+    }
+  }
+
+  const int numEntranceNodes = entrancePortal_.size() * POINTS_PER_PORTAL;
+  entranceEdgeStart_.assign(numEntranceNodes + 1, 0);
+  for (const auto& edges : clusterEdges) {
+    for (const auto& edge : edges)
+      ++entranceEdgeStart_[edge.first + 1];
+  }
+  for (int i = 0; i < numEntranceNodes; ++i)
+    entranceEdgeStart_[i + 1] += entranceEdgeStart_[i];
+  entranceEdges_.resize(entranceEdgeStart_.back());
+  {
+    std::vector<int> fill(entranceEdgeStart_.begin(),
+                          entranceEdgeStart_.end() - 1);
+    for (const auto& edges : clusterEdges) {
+      for (const auto& edge : edges)
+        entranceEdges_[fill[edge.first]++] = edge.second;
+    }
+  }
+}
+
+template <typename AllowPoly>
+ClusterGraph::NodeVisits& ClusterGraph::searchPortals(
+    int sourcePoly,
+    const vec3f& sourcePos,
+    int targetPoly,
+    const vec3f& targetPos,
+    const AllowPoly& allowPoly,
+    Visit* targetVisit) const {
+  // Every thread reuses the same visits for all of its searches
+  static thread_local NodeVisits visits;
+  visits.reset(portals_.size() * POINTS_PER_PORTAL);
+
+  // Straight line distance to the target never overestimates, and it is
+  // consistent, so every point is closed with its final cost
+  const bool hasTarget = targetPoly >= 0;
+  auto heuristic = [&](const vec3f& pos) {
+    return hasTarget ? (targetPos - pos).norm() : 0.0f;
+  };
+
+  OpenList open;
+  Visit target{INF, -1, -1, false};
+  auto relax = [&](int node, float cost, int parent, int via) {
+    Visit& visit = visits[node];
+    if (visit.closed || cost >= visit.cost)
+      return;
+    visit = {cost, parent, via, false};
+    open.emplace(cost + heuristic(nodePos(node)), node);
+  };
+  auto reachTarget = [&](float cost, int parent, int via) {
+    if (cost >= target.cost)
+      return;
+    target = {cost, parent, via, false};
+    open.emplace(cost, TARGET);
+  };
+  // Polygons are convex, so every point on their boundary sees every other
+  auto relaxPoly = [&](int poly, const vec3f& pos, float cost, int parent) {
+    if (poly == targetPoly)
+      reachTarget(cost + (targetPos - pos).norm(), parent, poly);
+    for (int k = polyPortalStart_[poly]; k < polyPortalStart_[poly + 1]; ++k) {
+      const int portal = polyPortals_[k];
+      if (parent >= 0 && portal == parent / POINTS_PER_PORTAL)
+        continue;
+      for (int i = 0; i < POINTS_PER_PORTAL; ++i) {
+        const int node = portal * POINTS_PER_PORTAL + i;
+        relax(node, cost + (nodePos(node) - pos).norm(), parent, poly);
+      }
+    }
+  };
+
+  relaxPoly(sourcePoly, sourcePos, 0, -1);
+  while (!open.empty()) {
+    const int current = open.top().second;
+    open.pop();
+    if (current == TARGET)
+      break;
+    Visit& visit = visits[current];
+    if (visit.closed)
+      continue;
+    visit.closed = true;
+
+    const Portal& portal = portals_[current / POINTS_PER_PORTAL];
+    for (int side = 0; side < 2; ++side) {
+      // Crossing the polygon the point was reached through again is never
+      // shorter than crossing it from the parent directly
+      const int poly = portal.polys[side];
+      if (poly != visit.via && allowPoly(poly))
+        relaxPoly(poly, nodePos(current), visit.cost, current);
+    }
+  }
+
+  if (targetVisit)
+    *targetVisit = target;
+  return visits;
+}
+
+int ClusterGraph::polyIndex(dtPolyRef ref) const {
+  if (!navMesh_->isValidPolyRef(ref))
+    return -1;
+  const int poly = tilePolyBase_[navMesh_->decodePolyIdTile(ref)] +
+                   navMesh_->decodePolyIdPoly(ref);
+  return polyCluster_[poly] >= 0 ? poly : -1;
+}
+
+bool ClusterGraph::findPath(dtPolyRef startRef,
+                            const vec3f& startPos,
+                            const std::vector<dtPolyRef>& endRefs,
+                            const std::vector<vec3f>& endPoses,
+                            std::vector<dtPolyRef>* corridor,
+                            int* goalIdx) const {
+  const int startPoly = polyIndex(startRef);
+  if (startPoly < 0)
+    return false;
+  const int startCluster = polyCluster_[startPoly];
+  auto inCluster = [this](int cluster) {
+    return [this, cluster](int poly) { return polyCluster_[poly] == cluster; };
+  };
+
+  const int numEnds = endRefs.size();
+  std::vector<int> endPolys(numEnds);
+  for (int i = 0; i < numEnds; ++i)
+    endPolys[i] = polyIndex(endRefs[i]);
+
+  // Search the points of the entrances, from the start to the entrances of
+  // its cluster, through the abstract graph and from the entrances of the
+  // clusters of the ends to the ends.  Ends in the cluster of the start are
+  // also reachable without leaving it
+  OpenList open;
+  std::unordered_map<int, Visit> visits;
+  float bestCost = INF;
+  int bestGoal = -1, bestParent = -1;
+  auto reachTarget = [&](float cost, int goal, int parent) {
+    if (cost >= bestCost)
+      return;
+    bestCost = cost;
+    bestGoal = goal;
+    bestParent = parent;
+    open.emplace(cost, TARGET);
+  };
+  auto heuristic = [&](const vec3f& pos) {
+    float dist = INF;
+    for (int i = 0; i < numEnds; ++i) {
+      if (endPolys[i] >= 0)
+        dist = std::min(dist, (endPoses[i] - pos).norm());
+    }
+    return dist;
+  };
+  auto relax = [&](int node, float cost, int parent, int cluster) {
+    Visit& visit =
+        visits.emplace(node, Visit{INF, -1, -1, false}).first->second;
+    if (visit.closed || cost >= visit.cost)
+      return;
+    visit = {cost, parent, cluster, false};
+    open.emplace(cost + heuristic(nodePos(entranceNode(node))), node);
+  };
+
+  // The distances within the clusters of the ends, by entrance point
+  std::vector<std::unordered_map<int, float>> endCosts(numEnds);
+  for (int i = 0; i < numEnds; ++i) {
+    if (endPolys[i] < 0)
+      continue;
+    const int endCluster = polyCluster_[endPolys[i]];
+    NodeVisits& endVisits =
+        searchPortals(endPolys[i], endPoses[i], -1, endPoses[i],
+                      inCluster(endCluster), nullptr);
+    for (int k = clusterEntranceStart_[endCluster];
+         k < clusterEntranceStart_[endCluster + 1]; ++k) {
+      for (int node = clusterEntrances_[k] * POINTS_PER_PORTAL;
+           node < (clusterEntrances_[k] + 1) * POINTS_PER_PORTAL; ++node) {
+        if (const Visit* visit = endVisits.find(entranceNode(node)))
+          endCosts[i][node] = visit->cost;
+      }
+    }
+  }
+
+  NodeVisits& startVisits = searchPortals(
+      startPoly, startPos, -1, startPos, inCluster(startCluster), nullptr);
+  for (int i = 0; i < numEnds; ++i) {
+    if (endPolys[i] < 0 || polyCluster_[endPolys[i]] != startCluster)
+      continue;
+    float cost = endPolys[i] == startPoly ? (endPoses[i] - startPos).norm()
+                                          : INF;
+    for (int k = polyPortalStart_[endPolys[i]];
+         k < polyPortalStart_[endPolys[i] + 1]; ++k) {
+      for (int j = 0; j < POINTS_PER_PORTAL; ++j) {
+        const int node = polyPortals_[k] * POINTS_PER_PORTAL + j;
+        if (const Visit* visit = startVisits.find(node))
+          cost = std::min(cost,
+                          visit->cost + (endPoses[i] - nodePos(node)).norm());
+      }
+    }
+    reachTarget(cost, i, -1);
+  }
+  for (int k = clusterEntranceStart_[startCluster];
+       k < clusterEntranceStart_[startCluster + 1]; ++k) {
+    for (int node = clusterEntrances_[k] * POINTS_PER_PORTAL;
+         node < (clusterEntrances_[k] + 1) * POINTS_PER_PORTAL; ++node) {
+      if (const Visit* visit = startVisits.find(entranceNode(node)))
+        relax(node, visit->cost, -1, startCluster);
+    }
+  }
+
+  while (!open.empty()) {
+    const int current = open.top().second;
+    open.pop();
+    if (current == TARGET)
+      break;
+    Visit& visit = visits.find(current)->second;
+    if (visit.closed)
+      continue;
+    visit.closed = true;
+
+    for (int i = 0; i < numEnds; ++i) {
+      auto it = endCosts[i].find(current);
+      if (it != endCosts[i].end())
+        reachTarget(visit.cost + it->second, i, current);
+    }
+    for (int k = entranceEdgeStart_[current];
+         k < entranceEdgeStart_[current + 1]; ++k) {
+      const Edge& edge = entranceEdges_[k];
+      relax(edge.node, visit.cost + edge.cost, current, edge.cluster);
+    }
+  }
+  if (bestGoal < 0)
+    return false;
+
+  // Refine within the clusters the abstract path goes through
+  std::vector<int> pathClusters{startCluster,
+                                polyCluster_[endPolys[bestGoal]]};
+  for (int node = bestParent; node >= 0; node = visits[node].parent)
+    pathClusters.push_back(visits[node].via);
+  std::sort(pathClusters.begin(), pathClusters.end());
+  auto onPath = [&](int poly) {
+    return std::binary_search(pathClusters.begin(), pathClusters.end(),
+                              polyCluster_[poly]);
+  };
+  Visit target;
+  NodeVisits& refineVisits =
+      searchPortals(startPoly, startPos, endPolys[bestGoal],
+                    endPoses[bestGoal], onPath, &target);
+  if (target.cost == INF)
+    return false;
+
+  // The polygons crossed on the way to every point, back to front
+  std::vector<int> polys{target.via};
+  for (int node = target.parent; node >= 0; node = refineVisits[node].parent)
+    polys.push_back(refineVisits[node].via);
+  corridor->clear();
+  for (auto it = polys.rbegin(); it != polys.rend(); ++it) {
+    if (corridor->empty() || corridor->back() != polyRefs_[*it])
+      corridor->push_back(polyRefs_[*it]);
+  }
+  *goalIdx = bestGoal;
+  return true;
+}
+
+}  // namespace impl
+}  // namespace nav
+}  // namespace esp
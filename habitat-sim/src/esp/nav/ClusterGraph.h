@@ -0,0 +1,192 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include "esp/core/esp.h"
+
+#include "DetourNavMesh.h"
+
+class dtQueryFilter;
+
+namespace esp {
+namespace nav {
+namespace impl {
+
+// Two level graph over the navmesh for hierarchical path finding, HPA*-style.
+//
+// The polygons are grouped into clusters, the connected pieces of the
+// polygons whose centers fall into the same cell of a uniform grid.  The
+// portals between polygons of different clusters are the entrances, and the
+// abstract graph connects every two entrances of a cluster by their shortest
+// distance within it.  A path is found by a search over the entrances first,
+// which only visits the clusters around the path, and then refined by a
+// search over the polygons of the clusters on the abstract path.  Neither
+// search has a fixed node budget, so the length of a path is unbounded and
+// the cost of a query grows with the number of clusters it crosses rather
+// than with the size of the navmesh.
+//
+// All searches run over the ends and midpoints of the portals between
+// polygons, so their paths hug obstacle corners and the polygon corridor they
+// return is often a little better than the one of Detour's A*, which moves
+// between portal midpoints only.  The abstract path only restricts the
+// polygons the refinement may use, paths can be longer when the shortest one
+// cuts through a cluster off the abstract path.
+//
+// Takes O(npolys * entrances per cluster * log) to construct
+class ClusterGraph {
+ public:
+  /**
+   * @param[in] navMesh The navmesh to build the graph over
+   * @param[in] filter Polygons that don't pass the filter are not traversed
+   * @param[in] cellSize Size of the grid cells the clusters are cut from
+   **/
+  ClusterGraph(const dtNavMesh* navMesh,
+               const dtQueryFilter* filter,
+               float cellSize);
+
+  /**
+   * Finds the polygon corridor from @p startPos on @p startRef to the
+   * closest of @p endPoses, each on the polygon of the same index in
+   * @p endRefs.  Returns false if no end is reachable, otherwise the
+   * corridor in @p corridor and the index of the end it leads to in
+   * @p goalIdx
+   **/
+  bool findPath(dtPolyRef startRef,
+                const vec3f& startPos,
+                const std::vector<dtPolyRef>& endRefs,
+                const std::vector<vec3f>& endPoses,
+                std::vector<dtPolyRef>* corridor,
+                int* goalIdx) const;
+
+  float cellSize() const { return cellSize_; }
+  int numClusters() const { return clusterEntranceStart_.size() - 1; }
+  int numEntrances() const { return entrancePortal_.size(); }
+
+ private:
+  // Shared edge of two neighbouring polygons
+  struct Portal {
+    int polys[2];
+    //! The ends of the edge and its midpoint, the nodes of the searches
+    vec3f points[3];
+  };
+  static const int POINTS_PER_PORTAL = 3;
+
+  // Edge of the abstract graph, whose nodes are the points of the entrances
+  struct Edge {
+    int node;
+    float cost;
+    int cluster;
+  };
+
+  // Search state of a node, the parent is -1 at the source
+  struct Visit {
+    float cost;
+    int parent;
+    //! Polygon (or cluster, in the abstract graph) crossed from the parent
+    int via;
+    bool closed;
+  };
+
+  // Visits of the nodes of a search, reset in O(1) so that a search only
+  // takes time in the number of nodes it visits
+  class NodeVisits {
+   public:
+    void reset(int numNodes) {
+      if (stamps_.size() < static_cast<size_t>(numNodes)) {
+        visits_.resize(numNodes);
+        stamps_.resize(numNodes, 0);
+      }
+      if (++stamp_ == 0) {
+        std::fill(stamps_.begin(), stamps_.end(), 0);
+        stamp_ = 1;
+      }
+    }
+    Visit* find(int node) {
+      return stamps_[node] == stamp_ ? &visits_[node] : nullptr;
+    }
+    //! Returns the visit of @p node, unvisited if it wasn't visited yet
+    Visit& operator[](int node) {
+      if (stamps_[node] != stamp_) {
+        stamps_[node] = stamp_;
+        visits_[node] = {std::numeric_limits<float>::infinity(), -1, -1,
+                         false};
+      }
+      return visits_[node];
+    }
+
+   private:
+    std::vector<Visit> visits_;
+    std::vector<uint32_t> stamps_;
+    uint32_t stamp_ = 0;
+  };
+
+  /**
+   * Dijkstra, or A* if @p targetPoly isn't -1, over the portal points of
+   * the polygons @p allowPoly accepts, starting at @p sourcePos on polygon
+   * @p sourcePoly.  Returns the nodes reached, valid until the next search
+   * on the same thread, and the cost to @p targetPos on @p targetPoly in
+   * @p targetVisit, infinity if there is no target or it can't be reached
+   **/
+  template <typename AllowPoly>
+  NodeVisits& searchPortals(int sourcePoly,
+                            const vec3f& sourcePos,
+                            int targetPoly,
+                            const vec3f& targetPos,
+                            const AllowPoly& allowPoly,
+                            Visit* targetVisit) const;
+
+  //! Index of the polygon @p ref in polyRefs_, -1 if it isn't traversable
+  int polyIndex(dtPolyRef ref) const;
+
+  const vec3f& nodePos(int node) const {
+    return portals_[node / POINTS_PER_PORTAL]
+        .points[node % POINTS_PER_PORTAL];
+  }
+  //! Node of the searches over the portals for node @p entranceNode of the
+  //! abstract graph
+  int entranceNode(int entranceNode) const {
+    return entrancePortal_[entranceNode / POINTS_PER_PORTAL] *
+               POINTS_PER_PORTAL +
+           entranceNode % POINTS_PER_PORTAL;
+  }
+
+  const dtNavMesh* navMesh_;
+  const float cellSize_;
+
+  //! Index of the first polygon of every tile in polyRefs_
+  std::vector<int> tilePolyBase_;
+  std::vector<dtPolyRef> polyRefs_;
+  //! Cluster of every polygon, -1 for polygons that aren't traversable
+  std::vector<int> polyCluster_;
+
+  std::vector<Portal> portals_;
+  //! Portals of polygon i are polyPortals_[polyPortalStart_[i],
+  //! polyPortalStart_[i + 1])
+  std::vector<int> polyPortalStart_;
+  std::vector<int> polyPortals_;
+
+  //! Portal of every entrance
+  std::vector<int> entrancePortal_;
+  //! Entrance of every portal, -1 for portals within a cluster
+  std::vector<int> portalEntrance_;
+  std::vector<int> clusterEntranceStart_;
+  std::vector<int> clusterEntrances_;
+  //! Edges of node i of the abstract graph are
+  //! entranceEdges_[entranceEdgeStart_[i], entranceEdgeStart_[i + 1])
+  std::vector<int> entranceEdgeStart_;
+  std::vector<Edge> entranceEdges_;
+
+  ESP_SMART_POINTERS(ClusterGraph)
+};
+
+}  // namespace impl
+}  // namespace nav
+}  // namespace esp
@@ -0,0 +1,106 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "EpisodeGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+#include "esp/core/random.h"
+
+namespace esp {
+namespace nav {
+
+namespace {
+// Draws candidate index from its own stream and validates it.  Returns false
+// if the candidate doesn't meet settings
+bool tryCandidate(PathFinder& pathfinder,
+                  const PointNavEpisodeSettings& settings,
+                  uint32_t seed,
+                  uint32_t index,
+                  PointNavEpisode* episode) {
+  std::seed_seq seq{seed, index};
+  uint32_t streamSeed;
+  seq.generate(&streamSeed, &streamSeed + 1);
+  core::Random random(streamSeed);
+
+  std::vector<vec3f> points;
+  if (!pathfinder.getRandomNavigablePoints(2, random, points,
+                                           settings.minIslandRadius))
+    return false;
+  episode->start = points[0];
+  episode->goal = points[1];
+  const float yaw = random.uniform_float(0, 2 * M_PI);
+  episode->startRotation = quatf(Eigen::AngleAxisf(yaw, vec3f::UnitY()));
+
+  episode->euclideanDistance = (episode->goal - episode->start).norm();
+  // The geodesic distance is at least the straight line distance
+  if (episode->euclideanDistance > settings.maxGeodesicDistance)
+    return false;
+
+  ShortestPath path;
+  path.requestedStart = episode->start;
+  path.requestedEnd = episode->goal;
+  if (!pathfinder.findPath(path))
+    return false;
+  episode->geodesicDistance = path.geodesicDistance;
+  return episode->geodesicDistance >= settings.minGeodesicDistance &&
+         episode->geodesicDistance <= settings.maxGeodesicDistance &&
+         episode->geodesicDistance >=
+             settings.minGeodesicToEuclideanRatio *
+                 episode->euclideanDistance;
+}
+}  // namespace
+
+std::vector<PointNavEpisode> generatePointNavEpisodes(
+    PathFinder& pathfinder,
+    const PointNavEpisodeSettings& settings,
+    uint32_t seed) {
+  std::vector<PointNavEpisode> episodes;
+  if (!pathfinder.isLoaded()) {
+    LOG(ERROR) << "generatePointNavEpisodes called without a loaded navmesh";
+    return episodes;
+  }
+
+  const int64_t maxCandidates =
+      static_cast<int64_t>(settings.numEpisodes) *
+      settings.maxCandidatesPerEpisode;
+  std::vector<PointNavEpisode> candidates;
+  std::vector<char> valid;
+  int64_t nextCandidate = 0;
+  while (episodes.size() < settings.numEpisodes &&
+         nextCandidate < maxCandidates) {
+    // Validate a block of candidates at a time, a few times as many as there
+    // are episodes left so that most of them are found in one go
+    const int64_t blockSize = std::min<int64_t>(
+        std::max<int64_t>(256, 4 * (settings.numEpisodes - episodes.size())),
+        maxCandidates - nextCandidate);
+    candidates.resize(blockSize);
+    valid.assign(blockSize, false);
+#pragma omp parallel for schedule(dynamic, 16)
+    for (int64_t i = 0; i < blockSize; ++i) {
+      valid[i] = tryCandidate(pathfinder, settings, seed, nextCandidate + i,
+                              &candidates[i]);
+    }
+    nextCandidate += blockSize;
+
+    for (int64_t i = 0;
+         i < blockSize && episodes.size() < settings.numEpisodes; ++i) {
+      if (valid[i])
+        episodes.push_back(candidates[i]);
+    }
+  }
+
+  if (episodes.size() < settings.numEpisodes) {
+    LOG(WARNING) << "generatePointNavEpisodes: only found "
+                 << episodes.size() << " of " << settings.numEpisodes
+                 << " episodes in " << maxCandidates << " candidates";
+  }
+  return episodes;
+}
+
+}  // namespace nav
+}  // namespace esp
@@ -0,0 +1,56 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <vector>
+
+#include "esp/core/esp.h"
+#include "esp/nav/PathFinder.h"
+
+namespace esp {
+namespace nav {
+
+struct PointNavEpisodeSettings {
+  //! Number of episodes to generate
+  int numEpisodes = 1000;
+  //! Range of the geodesic distance from the start to the goal
+  float minGeodesicDistance = 1.0;
+  float maxGeodesicDistance = 30.0;
+  //! Episodes whose geodesic distance is less than this many times the
+  //! straight line distance are rejected as too easy
+  float minGeodesicToEuclideanRatio = 1.1;
+  //! Starts and goals are only drawn on islands of at least this radius
+  float minIslandRadius = 0.0;
+  //! Generation gives up after this many candidates per episode
+  int maxCandidatesPerEpisode = 1000;
+};
+
+struct PointNavEpisode {
+  vec3f start;
+  //! Random heading about the y axis
+  quatf startRotation;
+  vec3f goal;
+  float geodesicDistance;
+  float euclideanDistance;
+};
+
+/**
+ * Generates PointNav episodes on the navmesh of @p pathfinder, start and
+ * goal pairs that meet the constraints of @p settings.
+ *
+ * Candidate i is drawn from its own random stream, derived from @p seed and
+ * i, and the candidates are validated with findPath in parallel across
+ * cores.  The episodes are the first valid candidates in order, so the
+ * result only depends on the navmesh, @p settings and @p seed, not on the
+ * number of threads.  Returns fewer than settings.numEpisodes episodes if
+ * the candidate budget runs out first.
+ **/
+std::vector<PointNavEpisode> generatePointNavEpisodes(
+    PathFinder& pathfinder,
+    const PointNavEpisodeSettings& settings,
+    uint32_t seed);
+
+}  // namespace nav
+}  // namespace esp
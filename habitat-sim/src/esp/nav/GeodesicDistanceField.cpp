@@ -0,0 +1,254 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "GeodesicDistanceField.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+
+#include "DetourNavMeshQuery.h"
+
+namespace esp {
+namespace nav {
+namespace impl {
+
+namespace {
+inline Eigen::Map<const vec3f> tileVert(const dtMeshTile* tile, int vertIdx) {
+  return Eigen::Map<const vec3f>(&tile->verts[vertIdx * 3]);
+}
+
+// Finds the edge of poly that links to neighbourRef, -1 if there is none
+int linkEdge(const dtMeshTile* tile,
+             const dtPoly* poly,
+             dtPolyRef neighbourRef) {
+  for (unsigned int iLink = poly->firstLink; iLink != DT_NULL_LINK;
+       iLink = tile->links[iLink].next) {
+    if (tile->links[iLink].ref == neighbourRef)
+      return tile->links[iLink].edge;
+  }
+  return -1;
+}
+}  // namespace
+
+NavMeshGraph::NavMeshGraph(const dtNavMesh* navMesh,
+                           const dtQueryFilter* filter) {
+  tileVertBase_.resize(navMesh->getMaxTiles());
+  for (int iTile = 0; iTile < navMesh->getMaxTiles(); ++iTile) {
+    tileVertBase_[iTile] = nodePos_.size();
+    const dtMeshTile* tile = navMesh->getTile(iTile);
+    if (!tile || !tile->header)
+      continue;
+    for (int iVert = 0; iVert < tile->header->vertCount; ++iVert) {
+      nodePos_.emplace_back(tileVert(tile, iVert));
+    }
+  }
+  const int numNodes = nodePos_.size();
+  isBorder_.assign(numNodes, false);
+
+  // Count the edges first, fill them in second
+  adjOffsets_.assign(numNodes + 1, 0);
+  for (int pass = 0; pass < 2; ++pass) {
+    std::vector<int> fill;
+    if (pass == 1) {
+      for (int i = 0; i < numNodes; ++i)
+        adjOffsets_[i + 1] += adjOffsets_[i];
+      adjNodes_.resize(adjOffsets_[numNodes]);
+      fill.assign(adjOffsets_.begin(), adjOffsets_.end() - 1);
+    }
+    auto addEdge = [&](int from, int to) {
+      if (pass == 0)
+        ++adjOffsets_[from + 1];
+      else
+        adjNodes_[fill[from]++] = to;
+    };
+
+    for (int iTile = 0; iTile < navMesh->getMaxTiles(); ++iTile) {
+      const dtMeshTile* tile = navMesh->getTile(iTile);
+      if (!tile || !tile->header)
+        continue;
+      const dtPolyRef base = navMesh->getPolyRefBase(tile);
+
+      for (int jPoly = 0; jPoly < tile->header->polyCount; ++jPoly) {
+        const dtPoly* poly = &tile->polys[jPoly];
+        if (poly->getType() != DT_POLYTYPE_GROUND ||
+            !filter->passFilter(base | jPoly, tile, poly))
+          continue;
+
+        // Polygons are convex, so all of their vertices see each other
+        for (int a = 0; a < poly->vertCount; ++a) {
+          for (int b = 0; b < poly->vertCount; ++b) {
+            if (a != b)
+              addEdge(nodeIndex(iTile, poly->verts[a]),
+                      nodeIndex(iTile, poly->verts[b]));
+          }
+        }
+
+        // Edges without a neighbour, or with one the filter excludes, are
+        // on the border
+        for (int a = 0; a < poly->vertCount; ++a) {
+          const unsigned short nei = poly->neis[a];
+          bool border = nei == 0;
+          if (nei != 0 && !(nei & DT_EXT_LINK))
+            border = !filter->passFilter(base | (nei - 1), tile,
+                                         &tile->polys[nei - 1]);
+          if (border) {
+            isBorder_[nodeIndex(iTile, poly->verts[a])] = true;
+            isBorder_[nodeIndex(iTile,
+                               poly->verts[(a + 1) % poly->vertCount])] =
+                true;
+          }
+        }
+
+        // Neighbours in other tiles don't share vertex indices, connect the
+        // vertices on either side of the shared edge instead
+        for (unsigned int iLink = poly->firstLink; iLink != DT_NULL_LINK;
+             iLink = tile->links[iLink].next) {
+          const dtLink& link = tile->links[iLink];
+          const unsigned int neighbourTileIdx =
+              navMesh->decodePolyIdTile(link.ref);
+          if (neighbourTileIdx == iTile)
+            continue;
+
+          const dtMeshTile* neighbourTile = 0;
+          const dtPoly* neighbourPoly = 0;
+          navMesh->getTileAndPolyByRefUnsafe(link.ref, &neighbourTile,
+                                             &neighbourPoly);
+          if (!filter->passFilter(link.ref, neighbourTile, neighbourPoly))
+            continue;
+          const int neighbourEdge =
+              linkEdge(neighbourTile, neighbourPoly, base | jPoly);
+          if (neighbourEdge < 0)
+            continue;
+
+          for (int a = 0; a < 2; ++a) {
+            const int vert = poly->verts[(link.edge + a) % poly->vertCount];
+            for (int b = 0; b < 2; ++b) {
+              const int neighbourVert =
+                  neighbourPoly->verts[(neighbourEdge + b) %
+                                       neighbourPoly->vertCount];
+              addEdge(nodeIndex(iTile, vert),
+                      nodeIndex(neighbourTileIdx, neighbourVert));
+            }
+          }
+        }
+      }
+    }
+  }
+
+  for (int i = 0; i < numNodes; ++i) {
+    if (isBorder_[i])
+      borderNodes_.push_back(i);
+  }
+}
+
+void NavMeshGraph::shortestDistances(std::vector<float>* dist,
+                                     std::vector<int>* parents) const {
+  if (parents)
+    parents->assign(dist->size(), -1);
+  typedef std::pair<float, int> QueueEntry;
+  std::priority_queue<QueueEntry, std::vector<QueueEntry>,
+                      std::greater<QueueEntry>>
+      queue;
+  for (int i = 0; i < dist->size(); ++i) {
+    if ((*dist)[i] < std::numeric_limits<float>::infinity())
+      queue.emplace((*dist)[i], i);
+  }
+
+  while (!queue.empty()) {
+    const QueueEntry top = queue.top();
+    queue.pop();
+    const int node = top.second;
+    if (top.first > (*dist)[node])
+      continue;
+
+    for (int iAdj = adjOffsets_[node]; iAdj < adjOffsets_[node + 1]; ++iAdj) {
+      const int neighbour = adjNodes_[iAdj];
+      const float neighbourDist =
+          top.first + (nodePos_[neighbour] - nodePos_[node]).norm();
+      if (neighbourDist < (*dist)[neighbour]) {
+        (*dist)[neighbour] = neighbourDist;
+        if (parents)
+          (*parents)[neighbour] = node;
+        queue.emplace(neighbourDist, neighbour);
+      }
+    }
+  }
+}
+
+GeodesicDistanceField::GeodesicDistanceField(
+    const dtNavMesh* navMesh,
+    const dtQueryFilter* filter,
+    const std::vector<PolyPoint>& goals)
+    : navMesh_{navMesh} {
+  const NavMeshGraph graph(navMesh, filter);
+  tileVertBase_ = graph.tileVertBase();
+
+  // Seed the search with the vertices of the polygons the goals lie on
+  nodeDist_.assign(graph.numNodes(), std::numeric_limits<float>::infinity());
+  for (const auto& goal : goals) {
+    if (!navMesh->isValidPolyRef(goal.first))
+      continue;
+    goalsByPoly_[goal.first].emplace_back(goal.second);
+
+    const dtMeshTile* tile = 0;
+    const dtPoly* poly = 0;
+    navMesh->getTileAndPolyByRefUnsafe(goal.first, &tile, &poly);
+    const unsigned int iTile = navMesh->decodePolyIdTile(goal.first);
+    for (int iVert = 0; iVert < poly->vertCount; ++iVert) {
+      const int node = nodeIndex(iTile, poly->verts[iVert]);
+      nodeDist_[node] = std::min(nodeDist_[node],
+                                 (graph.nodePos(node) - goal.second).norm());
+    }
+  }
+  graph.shortestDistances(&nodeDist_);
+}
+
+float GeodesicDistanceField::distance(dtPolyRef ref, const vec3f& pt) const {
+  return distance(ref, pt, nullptr);
+}
+
+float GeodesicDistanceField::distance(dtPolyRef ref,
+                                      const vec3f& pt,
+                                      vec3f* nextPoint) const {
+  float dist = std::numeric_limits<float>::infinity();
+  if (!navMesh_->isValidPolyRef(ref))
+    return dist;
+
+  auto goalsIt = goalsByPoly_.find(ref);
+  if (goalsIt != goalsByPoly_.end()) {
+    for (const vec3f& goal : goalsIt->second) {
+      const float goalDist = (goal - pt).norm();
+      if (goalDist < dist) {
+        dist = goalDist;
+        if (nextPoint)
+          *nextPoint = goal;
+      }
+    }
+  }
+
+  const dtMeshTile* tile = 0;
+  const dtPoly* poly = 0;
+  navMesh_->getTileAndPolyByRefUnsafe(ref, &tile, &poly);
+  const unsigned int iTile = navMesh_->decodePolyIdTile(ref);
+  for (int iVert = 0; iVert < poly->vertCount; ++iVert) {
+    const float vertDist = nodeDist_[nodeIndex(iTile, poly->verts[iVert])];
+    if (vertDist >= dist)
+      continue;
+    const float totalDist =
+        vertDist + (tileVert(tile, poly->verts[iVert]) - pt).norm();
+    if (totalDist < dist) {
+      dist = totalDist;
+      if (nextPoint)
+        *nextPoint = tileVert(tile, poly->verts[iVert]);
+    }
+  }
+
+  return dist;
+}
+
+}  // namespace impl
+}  // namespace nav
+}  // namespace esp
@@ -0,0 +1,128 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "esp/core/esp.h"
+
+#include "DetourNavMesh.h"
+
+class dtQueryFilter;
+
+namespace esp {
+namespace nav {
+namespace impl {
+
+// Graph over the vertices of the navmesh polygons.  Two vertices are
+// connected if they belong to the same (convex) polygon, so every edge of
+// the graph is a straight line that stays on the navmesh.  Vertices of
+// different tiles are distinct nodes, the vertices on either side of an edge
+// shared by two tiles are connected instead.
+class NavMeshGraph {
+ public:
+  /**
+   * @param[in] navMesh The navmesh to build the graph over
+   * @param[in] filter Polygons that don't pass the filter are not traversed
+   **/
+  NavMeshGraph(const dtNavMesh* navMesh, const dtQueryFilter* filter);
+
+  int numNodes() const { return nodePos_.size(); }
+  const vec3f& nodePos(int node) const { return nodePos_[node]; }
+  int nodeIndex(unsigned int tileIdx, unsigned short vertIdx) const {
+    return tileVertBase_[tileIdx] + vertIdx;
+  }
+  //! Index of the first vertex of every tile
+  const std::vector<int>& tileVertBase() const { return tileVertBase_; }
+
+  //! Vertices on the border of the navmesh, the only ones shortest paths
+  //! bend at
+  const std::vector<int>& borderNodes() const { return borderNodes_; }
+  bool isBorder(int node) const { return isBorder_[node]; }
+
+  /**
+   * Runs Dijkstra from the nodes with a finite distance in @p dist, which
+   * holds the distance of every node afterwards.  @p parents, if given, gets
+   * the node every node was reached from, -1 for the ones it started from
+   * and the unreachable ones.
+   **/
+  void shortestDistances(std::vector<float>* dist,
+                         std::vector<int>* parents = nullptr) const;
+
+ private:
+  std::vector<vec3f> nodePos_;
+  std::vector<int> tileVertBase_;
+  std::vector<int> borderNodes_;
+  std::vector<bool> isBorder_;
+  //! Adjacency list stored as offsets into one flat array
+  std::vector<int> adjOffsets_;
+  std::vector<int> adjNodes_;
+
+  ESP_SMART_POINTERS(NavMeshGraph)
+};
+
+// Geodesic distance from anywhere on the navmesh to the closest of a set of
+// goals.
+//
+// The field is built by running a single multi-source Dijkstra over
+// NavMeshGraph.  Looking up a point then only needs the polygon it lies on:
+// the distance is the minimum over the polygon's vertices of the straight
+// line to the vertex plus that vertex's distance, or the straight line to a
+// goal on the same polygon.
+//
+// Paths in the graph bend at polygon corners only, so the field is an upper
+// bound of the true geodesic distance that is tight wherever the shortest
+// path hugs obstacle corners and slightly long across open areas.
+//
+// Takes O(nverts log nverts) to construct and O(1) to query
+class GeodesicDistanceField {
+ public:
+  typedef std::pair<dtPolyRef, vec3f> PolyPoint;
+
+  /**
+   * @param[in] navMesh The navmesh to build the field over
+   * @param[in] filter Polygons that don't pass the filter are not traversed
+   * @param[in] goals The goals, already snapped to the navmesh polygon they
+   * lie on
+   **/
+  GeodesicDistanceField(const dtNavMesh* navMesh,
+                        const dtQueryFilter* filter,
+                        const std::vector<PolyPoint>& goals);
+
+  /**
+   * Returns the distance from @p pt, which must lie on polygon @p ref, to the
+   * closest goal.  Infinity if no goal is reachable from @p ref
+   **/
+  float distance(dtPolyRef ref, const vec3f& pt) const;
+
+  /**
+   * Same as distance, also returns the first point the shortest path from
+   * @p pt goes through, either a polygon vertex or a goal, in @p nextPoint.
+   * @p nextPoint is unchanged if no goal is reachable
+   **/
+  float distance(dtPolyRef ref, const vec3f& pt, vec3f* nextPoint) const;
+
+ private:
+  const dtNavMesh* navMesh_;
+
+  //! Index of the first vertex of every tile in nodeDist_
+  std::vector<int> tileVertBase_;
+  //! Distance to the closest goal for every vertex of the navmesh
+  std::vector<float> nodeDist_;
+  //! Goals grouped by the polygon they lie on
+  std::unordered_map<dtPolyRef, std::vector<vec3f>> goalsByPoly_;
+
+  inline int nodeIndex(unsigned int tileIdx, unsigned short vertIdx) const {
+    return tileVertBase_[tileIdx] + vertIdx;
+  }
+
+  ESP_SMART_POINTERS(GeodesicDistanceField)
+};
+
+}  // namespace impl
+}  // namespace nav
+}  // namespace esp
@@ -1,9 +1,53 @@
 #include "esp/nav/GreedyFollower.h"
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <stdexcept>
 #include "Sophus/sophus/so3.hpp"
 #include "esp/geo/geo.h"
+#include "esp/scene/ObjectControls.h"
 
 namespace esp {
 
+namespace {
+nav::GreedyGeodesicFollowerImpl::MoveFn nativeMoveFn(
+    const scene::ObjectControls::ptr& controls,
+    const std::string& actName,
+    const agent::ActuationMap& actuation) {
+  // Bound to python, where an action name is easily misspelled
+  if (!controls->getMoveFuncMap().count(actName))
+    throw std::invalid_argument("Unknown action: " + actName);
+  const float amount = actuation.at("amount");
+  return [controls, actName, amount](scene::SceneNode* node) {
+    controls->action(*node, actName, amount, true);
+  };
+}
+}  // namespace
+
+nav::GreedyGeodesicFollowerImpl::GreedyGeodesicFollowerImpl(
+    PathFinder::ptr& pathfinder,
+    const std::string& forwardAction,
+    const agent::ActuationMap& forwardActuation,
+    const std::string& leftAction,
+    const agent::ActuationMap& leftActuation,
+    const std::string& rightAction,
+    const agent::ActuationMap& rightActuation,
+    double goalDist)
+    : pathfinder_{pathfinder},
+      forwardAmount_{forwardActuation.at("amount")},
+      goalDist_{goalDist},
+      turnAmount_{leftActuation.at("amount") * M_PI / 180.0} {
+  // The moves and the step filter only capture shared pointers, the follower
+  // may be copied
+  auto controls = scene::ObjectControls::create();
+  controls->setMoveFilterFunction(
+      [pathfinder](const vec3f& start, const vec3f& end) {
+        return pathfinder->tryStep(start, end);
+      });
+  moveForward_ = nativeMoveFn(controls, forwardAction, forwardActuation);
+  turnLeft_ = nativeMoveFn(controls, leftAction, leftActuation);
+  turnRight_ = nativeMoveFn(controls, rightAction, rightActuation);
+}
+
 // There are some cases were we can't perfectly align along the shortest path
 // and the agent will get stuck, so we need to check that forward will actually
 // move us forward, if it doesn't, we will check to see if either of the turn
@@ -83,7 +127,11 @@ nav::GreedyGeodesicFollowerImpl::calcStepAlong(
   moveForward_(&dummyNode_);
   const float newGeoDist =
       this->geoDist(dummyNode_.getAbsolutePosition(), path.requestedEnd);
-  if ((path.geodesicDistance - newGeoDist) > 0.5 * forwardAmount_) {
+  // Both distances from the field, so that its error cancels out
+  const float curGeoDist =
+      useDistanceField_ ? this->geoDist(std::get<0>(state), path.requestedEnd)
+                        : path.geodesicDistance;
+  if ((curGeoDist - newGeoDist) > 0.5 * forwardAmount_) {
     return CODES::FORWARD;
   }
 
@@ -104,7 +152,7 @@ nav::GreedyGeodesicFollowerImpl::nextActionAlong(
   nav::ShortestPath path;
   path.requestedStart = std::get<0>(start);
   path.requestedEnd = end;
-  pathfinder_->findPath(path);
+  corridor_.findPath(path);
 
   CODES action = calcStepAlong(start, path);
   if (action == CODES::FORWARD)
@@ -124,7 +172,7 @@ nav::GreedyGeodesicFollowerImpl::findPath(
   nav::ShortestPath path;
   path.requestedStart = std::get<0>(state);
   path.requestedEnd = end;
-  pathfinder_->findPath(path);
+  corridor_.findPath(path);
 
   do {
     CODES nextAction = calcStepAlong(state, path);
@@ -141,7 +189,7 @@ nav::GreedyGeodesicFollowerImpl::findPath(
         moveForward_(&dummyNode_);
 
         path.requestedStart = dummyNode_.getAbsolutePosition();
-        pathfinder_->findPath(path);
+        corridor_.findPath(path);
         break;
 
       case CODES::LEFT:
@@ -1,6 +1,8 @@
 #pragma once
 
+#include "esp/agent/Agent.h"
 #include "esp/core/esp.h"
+#include "esp/nav/PathCorridor.h"
 #include "esp/nav/PathFinder.h"
 #include "esp/scene/SceneGraph.h"
 #include "esp/scene/SceneNode.h"
@@ -60,6 +62,37 @@ class GreedyGeodesicFollowerImpl {
         forwardAmount_{forwardAmount},
         turnAmount_{turnAmount} {};
 
+  /**
+   * Implements a follower that moves natively through scene::ObjectControls
+   *with PathFinder::tryStep as the step filter, so finding a path never calls
+   *back into python
+   *
+   * Params
+   * @param[in] pathfinder Instance of the pathfinder used for calculating the
+   *geodesic shortest path and filtering steps
+   * @param[in] forwardAction Name of the ObjectControls action that moves
+   *forward, i.e. "moveForward"
+   * @param[in] forwardActuation Actuation of forwardAction, its "amount" is
+   *the distance moved
+   * @param[in] leftAction Name of the ObjectControls action that turns left,
+   *i.e. "turnLeft"
+   * @param[in] leftActuation Actuation of leftAction, its "amount" is the
+   *angle turned in degrees
+   * @param[in] rightAction Name of the ObjectControls action that turns right,
+   *i.e. "turnRight"
+   * @param[in] rightActuation Actuation of rightAction
+   * @param[in] goalDist How close the agent needs to get to the goal before
+   *calling stop
+   **/
+  GreedyGeodesicFollowerImpl(PathFinder::ptr& pathfinder,
+                             const std::string& forwardAction,
+                             const agent::ActuationMap& forwardActuation,
+                             const std::string& leftAction,
+                             const agent::ActuationMap& leftActuation,
+                             const std::string& rightAction,
+                             const agent::ActuationMap& rightActuation,
+                             double goalDist);
+
   CODES nextActionAlong(const State& start, const vec3f& end);
 
   /**
@@ -94,10 +127,27 @@ class GreedyGeodesicFollowerImpl {
     return findPath(std::make_tuple(startPos, rot), end);
   }
 
+  /**
+   * Looks the distance to the goal up in the distance field of
+   * PathFinder::geodesicDistanceToGoals when checking whether a step forward
+   * makes progress, instead of running a findPath for every step.  The field
+   * of a goal is built on first use and cached by the pathfinder, so this
+   * pays off for episodes with many steps towards the same goal.  Off by
+   * default, as the field runs a few percent long across open space, which
+   * can change a decision
+   **/
+  void setUseDistanceField(bool useDistanceField) {
+    useDistanceField_ = useDistanceField;
+  }
+  bool getUseDistanceField() const { return useDistanceField_; }
+
  private:
   PathFinder::ptr pathfinder_;
+  //! Keeps the path to the goal up to date as the agent moves along it
+  PathCorridor corridor_{pathfinder_};
   MoveFn moveForward_, turnLeft_, turnRight_;
   const double forwardAmount_, goalDist_, turnAmount_;
+  bool useDistanceField_ = false;
 
   scene::SceneGraph dummyScene_;
   scene::SceneNode dummyNode_{dummyScene_.getRootNode()};
@@ -105,6 +155,8 @@ class GreedyGeodesicFollowerImpl {
   CODES calcStepAlong(const State& start, const ShortestPath& path);
 
   inline float geoDist(const vec3f& start, const vec3f& end) {
+    if (useDistanceField_)
+      return pathfinder_->geodesicDistanceToGoals(start, {end});
     ShortestPath path;
     path.requestedStart = start;
     path.requestedEnd = end;
@@ -0,0 +1,146 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "NavMeshSampler.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "DetourNavMeshQuery.h"
+
+namespace esp {
+namespace nav {
+namespace impl {
+
+NavMeshSampler::NavMeshSampler(
+    const dtNavMesh* navMesh,
+    const dtQueryFilter* filter,
+    const std::function<uint32_t(dtPolyRef)>& polyIsland,
+    const std::vector<float>& islandRadii)
+    : islandRadii_{islandRadii} {
+  const int numIslands = islandRadii_.size();
+  std::vector<Triangle> triangles;
+  std::vector<int> triangleIslands;
+  for (int iTile = 0; iTile < navMesh->getMaxTiles(); ++iTile) {
+    const dtMeshTile* tile = navMesh->getTile(iTile);
+    if (!tile->header)
+      continue;
+
+    const dtPolyRef base = navMesh->getPolyRefBase(tile);
+    for (int jPoly = 0; jPoly < tile->header->polyCount; ++jPoly) {
+      const dtPolyRef ref = base | jPoly;
+      const dtPoly* poly = &tile->polys[jPoly];
+      if (poly->getType() != DT_POLYTYPE_GROUND ||
+          !filter->passFilter(ref, tile, poly))
+        continue;
+      const uint32_t island = polyIsland(ref);
+      if (island >= islandRadii_.size())
+        continue;
+
+      // Polygons are convex, so a triangle fan covers them
+      auto vert = [&](int k) {
+        return Eigen::Map<const vec3f>(&tile->verts[poly->verts[k] * 3]);
+      };
+      for (int k = 2; k < poly->vertCount; ++k) {
+        triangles.push_back({ref, {vert(0), vert(k - 1), vert(k)}, 0});
+        triangleIslands.push_back(island);
+      }
+    }
+  }
+
+  // Group the triangles by island, keeping their order within an island
+  islandStart_.assign(numIslands + 1, 0);
+  for (const int island : triangleIslands)
+    ++islandStart_[island + 1];
+  for (int i = 0; i < numIslands; ++i)
+    islandStart_[i + 1] += islandStart_[i];
+  triangles_.resize(triangles.size());
+  std::vector<int> next(islandStart_.begin(), islandStart_.end() - 1);
+  for (int i = 0; i < triangles.size(); ++i)
+    triangles_[next[triangleIslands[i]]++] = triangles[i];
+
+  float largestArea = 0;
+  for (int i = 0; i < numIslands; ++i) {
+    float area = 0;
+    for (int j = islandStart_[i]; j < islandStart_[i + 1]; ++j) {
+      Triangle& triangle = triangles_[j];
+      const vec3f e1 = triangle.verts[1] - triangle.verts[0];
+      const vec3f e2 = triangle.verts[2] - triangle.verts[0];
+      area += 0.5f * e1.cross(e2).norm();
+      triangle.cumulativeArea = area;
+    }
+    if (area > largestArea) {
+      largestArea = area;
+      largestIsland_ = i;
+    }
+  }
+}
+
+bool NavMeshSampler::sample(int numPoints,
+                            core::Random& random,
+                            const dtNavMeshQuery* navQuery,
+                            float minIslandRadius,
+                            bool largestIslandOnly,
+                            std::vector<vec3f>* points) const {
+  std::vector<int> islands;
+  std::vector<float> cumulativeAreas;
+  float totalArea = 0;
+  auto addIsland = [&](int island) {
+    const int last = islandStart_[island + 1] - 1;
+    if (last < islandStart_[island] || triangles_[last].cumulativeArea <= 0)
+      return;
+    totalArea += triangles_[last].cumulativeArea;
+    islands.push_back(island);
+    cumulativeAreas.push_back(totalArea);
+  };
+  if (largestIslandOnly) {
+    if (largestIsland_ >= 0 &&
+        islandRadii_[largestIsland_] >= minIslandRadius)
+      addIsland(largestIsland_);
+  } else {
+    for (int i = 0; i < islandRadii_.size(); ++i) {
+      if (islandRadii_[i] >= minIslandRadius)
+        addIsland(i);
+    }
+  }
+  if (islands.empty())
+    return false;
+
+  points->reserve(points->size() + numPoints);
+  for (int i = 0; i < numPoints; ++i) {
+    // One number picks the island and then the triangle within it
+    float u = random.uniform_float_01() * totalArea;
+    const int k = std::min<int>(
+        std::upper_bound(cumulativeAreas.begin(), cumulativeAreas.end(), u) -
+            cumulativeAreas.begin(),
+        islands.size() - 1);
+    if (k > 0)
+      u -= cumulativeAreas[k - 1];
+    const auto first = triangles_.begin() + islandStart_[islands[k]];
+    const auto last = triangles_.begin() + islandStart_[islands[k] + 1];
+    const Triangle& triangle =
+        *std::min(std::upper_bound(first, last, u,
+                                   [](float u, const Triangle& triangle) {
+                                     return u < triangle.cumulativeArea;
+                                   }),
+                  last - 1);
+
+    // Uniform in the triangle, as in dtRandomPointInConvexPoly
+    const float a = std::sqrt(random.uniform_float_01());
+    const float b = random.uniform_float_01();
+    vec3f pt = (1 - a) * triangle.verts[0] +
+               a * (1 - b) * triangle.verts[1] + a * b * triangle.verts[2];
+    // The detail mesh can be above or below the polygon
+    float height;
+    if (dtStatusSucceed(
+            navQuery->getPolyHeight(triangle.ref, pt.data(), &height)))
+      pt[1] = height;
+    points->push_back(pt);
+  }
+  return true;
+}
+
+}  // namespace impl
+}  // namespace nav
+}  // namespace esp
@@ -0,0 +1,82 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "esp/core/esp.h"
+#include "esp/core/random.h"
+
+#include "DetourNavMesh.h"
+
+class dtNavMeshQuery;
+class dtQueryFilter;
+
+namespace esp {
+namespace nav {
+namespace impl {
+
+// Samples points uniformly by area over the navmesh, or over some of its
+// islands.
+//
+// Detour's findRandomPoint walks every tile and polygon of the navmesh for
+// each point.  The sampler instead lists the triangles of the polygons once,
+// grouped by island, along with their cumulative area, so drawing a point is
+// a binary search for its island and one for its triangle.  Every point takes
+// three numbers of the caller's random stream, so the same stream always
+// gives the same points whichever thread draws them.
+//
+// Takes O(npolys) to construct and O(log npolys) per point
+class NavMeshSampler {
+ public:
+  /**
+   * @param[in] navMesh The navmesh to sample
+   * @param[in] filter Polygons that don't pass the filter are not sampled
+   * @param[in] polyIsland Island of a polygon, polygons on islands past the
+   * end of @p islandRadii are not sampled
+   * @param[in] islandRadii Radius of every island
+   **/
+  NavMeshSampler(const dtNavMesh* navMesh,
+                 const dtQueryFilter* filter,
+                 const std::function<uint32_t(dtPolyRef)>& polyIsland,
+                 const std::vector<float>& islandRadii);
+
+  /**
+   * Appends @p numPoints points drawn from @p random to @p points, on the
+   * islands with a radius of at least @p minIslandRadius, or only on the
+   * island with the largest area if @p largestIslandOnly.  Returns false,
+   * without drawing any points, if no island qualifies
+   **/
+  bool sample(int numPoints,
+              core::Random& random,
+              const dtNavMeshQuery* navQuery,
+              float minIslandRadius,
+              bool largestIslandOnly,
+              std::vector<vec3f>* points) const;
+
+ private:
+  // One triangle of the fan of a polygon
+  struct Triangle {
+    dtPolyRef ref;
+    vec3f verts[3];
+    //! Area of the triangles of the island up to and including this one
+    float cumulativeArea;
+  };
+
+  //! Triangles of island i are
+  //! triangles_[islandStart_[i], islandStart_[i + 1])
+  std::vector<int> islandStart_;
+  std::vector<Triangle> triangles_;
+  std::vector<float> islandRadii_;
+  //! Island with the largest area, -1 if the navmesh is empty
+  int largestIsland_ = -1;
+
+  ESP_SMART_POINTERS(NavMeshSampler)
+};
+
+}  // namespace impl
+}  // namespace nav
+}  // namespace esp
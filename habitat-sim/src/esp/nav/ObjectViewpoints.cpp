@@ -0,0 +1,127 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "ObjectViewpoints.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "esp/nav/TriangleGridIndex.h"
+#include "esp/scene/SemanticScene.h"
+
+namespace esp {
+namespace nav {
+
+namespace {
+// Mesh hits this close to the box of an object, in units of its half
+// extents, are on its own surface
+constexpr float kObjectSurfaceMargin = 0.1;
+// The navmesh can lie a little above the floor an object stands on
+constexpr float kHeightSlack = 0.5;
+
+std::vector<vec3f> objectViewpoints(const PathFinder& pathfinder,
+                                    const impl::TriangleGridIndex& meshIndex,
+                                    const geo::OBB& obb,
+                                    const ObjectViewpointSettings& settings) {
+  const box3f aabb = obb.toAABB();
+  // Parts of the object to look at, its center and its corners pulled in a
+  // little so that they aren't on the surface of the object
+  std::vector<vec3f> targets{obb.center()};
+  for (int i = 0; i < 8; ++i) {
+    const vec3f corner(i & 1 ? 1 : -1, i & 2 ? 1 : -1, i & 4 ? 1 : -1);
+    targets.emplace_back(obb.localToWorld() * (0.75f * corner));
+  }
+  auto onObject = [&obb](const vec3f& hit) {
+    return obb.contains(hit, kObjectSurfaceMargin);
+  };
+
+  std::vector<vec3f> viewpoints;
+  const float minX = aabb.min()[0] - settings.radius;
+  const float minZ = aabb.min()[2] - settings.radius;
+  const int numX = (aabb.sizes()[0] + 2 * settings.radius) / settings.spacing;
+  const int numZ = (aabb.sizes()[2] + 2 * settings.radius) / settings.spacing;
+  for (int i = 0; i <= numZ; ++i) {
+    for (int j = 0; j <= numX; ++j) {
+      const vec3f candidate(minX + j * settings.spacing, aabb.min()[1],
+                            minZ + i * settings.spacing);
+      // The navmesh has to be under the candidate, not just near it
+      const vec3f pt = pathfinder.snapPoint(candidate);
+      if (!pt.allFinite() ||
+          std::abs(pt[0] - candidate[0]) > 0.5f * settings.spacing ||
+          std::abs(pt[2] - candidate[2]) > 0.5f * settings.spacing)
+        continue;
+      if (pt[1] < aabb.min()[1] - settings.maxYDelta ||
+          pt[1] > aabb.max()[1] + kHeightSlack)
+        continue;
+      // Level with the box, the distance to it is the one to its footprint
+      vec3f level = pt;
+      level[1] = std::min(std::max(pt[1], aabb.min()[1]), aabb.max()[1]);
+      if (obb.distance(level) > settings.radius)
+        continue;
+      if (pathfinder.islandRadius(pt) < settings.minIslandRadius)
+        continue;
+
+      const vec3f eye = pt + settings.eyeHeight * vec3f::UnitY();
+      for (const vec3f& target : targets) {
+        if (!meshIndex.segmentHits(eye, target, onObject)) {
+          viewpoints.push_back(pt);
+          break;
+        }
+      }
+    }
+  }
+  return viewpoints;
+}
+}  // namespace
+
+std::vector<std::vector<vec3f>> sampleObjectViewpoints(
+    const PathFinder& pathfinder,
+    const assets::MeshData& mesh,
+    const std::vector<geo::OBB>& objects,
+    const ObjectViewpointSettings& settings) {
+  const int numObjects = objects.size();
+  std::vector<std::vector<vec3f>> viewpoints(numObjects);
+  if (!pathfinder.isLoaded()) {
+    LOG(ERROR) << "sampleObjectViewpoints called without a loaded navmesh";
+    return viewpoints;
+  }
+  if (settings.spacing <= 0 || settings.cellSize <= 0) {
+    LOG(ERROR) << "sampleObjectViewpoints needs spacing and cellSize > 0";
+    return viewpoints;
+  }
+
+  const impl::TriangleGridIndex meshIndex(mesh, settings.cellSize);
+#pragma omp parallel for schedule(dynamic, 1)
+  for (int i = 0; i < numObjects; ++i) {
+    viewpoints[i] =
+        objectViewpoints(pathfinder, meshIndex, objects[i], settings);
+  }
+  return viewpoints;
+}
+
+std::vector<std::vector<vec3f>> sampleObjectViewpoints(
+    const PathFinder& pathfinder,
+    const assets::MeshData& mesh,
+    const scene::SemanticScene& semanticScene,
+    const ObjectViewpointSettings& settings) {
+  const auto& objects = semanticScene.objects();
+  std::vector<geo::OBB> obbs;
+  std::vector<int> objectIndices;
+  for (int i = 0; i < objects.size(); ++i) {
+    if (objects[i]) {
+      obbs.push_back(objects[i]->obb());
+      objectIndices.push_back(i);
+    }
+  }
+
+  std::vector<std::vector<vec3f>> obbViewpoints =
+      sampleObjectViewpoints(pathfinder, mesh, obbs, settings);
+  std::vector<std::vector<vec3f>> viewpoints(objects.size());
+  for (int i = 0; i < objectIndices.size(); ++i)
+    viewpoints[objectIndices[i]] = std::move(obbViewpoints[i]);
+  return viewpoints;
+}
+
+}  // namespace nav
+}  // namespace esp
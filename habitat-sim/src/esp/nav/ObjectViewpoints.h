@@ -0,0 +1,63 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <vector>
+
+#include "esp/assets/MeshData.h"
+#include "esp/core/esp.h"
+#include "esp/geo/OBB.h"
+#include "esp/nav/PathFinder.h"
+
+namespace esp {
+namespace scene {
+class SemanticScene;
+}
+namespace nav {
+
+struct ObjectViewpointSettings {
+  //! Viewpoints are within this distance of the footprint of an object
+  float radius = 1.0;
+  //! Viewpoints are at most this far below the bottom of an object
+  float maxYDelta = 1.5;
+  //! Spacing of the grid of candidate viewpoints around an object
+  float spacing = 0.1;
+  //! Viewpoints are only on islands of at least this radius
+  float minIslandRadius = 0.0;
+  //! Height of the camera above the navmesh that has to see the object
+  float eyeHeight = 1.5;
+  //! Cell size of the grid over the scene mesh for line of sight tests
+  float cellSize = 0.5;
+};
+
+/**
+ * Samples navigable viewpoints of every one of @p objects, e.g. the goals of
+ * an ObjectNav episode.  Candidates on a grid around each object are snapped
+ * to the navmesh of @p pathfinder, and kept if they are within the radius
+ * and height of @p settings, on a large enough island, and if a camera at
+ * the eye height above them has a line of sight through @p mesh, the scene
+ * mesh, to the center or a corner of the object.  Hits with the mesh inside
+ * the object's box are its own surface and don't block the view.
+ *
+ * Objects are processed in parallel across cores.  Returns one list of
+ * viewpoints per object, in order, empty for objects that can't be seen
+ * from the navmesh.
+ **/
+std::vector<std::vector<vec3f>> sampleObjectViewpoints(
+    const PathFinder& pathfinder,
+    const assets::MeshData& mesh,
+    const std::vector<geo::OBB>& objects,
+    const ObjectViewpointSettings& settings);
+
+//! Same as above for every object of @p semanticScene, in the order of
+//! semanticScene.objects()
+std::vector<std::vector<vec3f>> sampleObjectViewpoints(
+    const PathFinder& pathfinder,
+    const assets::MeshData& mesh,
+    const scene::SemanticScene& semanticScene,
+    const ObjectViewpointSettings& settings);
+
+}  // namespace nav
+}  // namespace esp
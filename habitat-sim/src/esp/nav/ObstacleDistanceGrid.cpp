@@ -0,0 +1,291 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "ObstacleDistanceGrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+#include "DetourCommon.h"
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+
+namespace esp {
+namespace nav {
+namespace impl {
+
+namespace {
+// Samples closer than this in height are the same surface
+const float SAME_SURFACE_HEIGHT = 0.05;
+// How far a lookup may be above or below a sample, same as the default of
+// PathFinder::isNavigable
+const float MAX_Y_DELTA = 0.5;
+
+// A sample that still needs its distance computed
+struct PendingSample {
+  int node;
+  float height;
+  //! Polygon the node lies on, 0 for nodes off the navmesh
+  dtPolyRef ref;
+};
+}  // namespace
+
+ObstacleDistanceGrid::ObstacleDistanceGrid(const dtNavMesh* navMesh,
+                                           const dtQueryFilter* filter,
+                                           float cellSize,
+                                           float maxSearchRadius)
+    : cellSize_{cellSize}, maxSearchRadius_{maxSearchRadius} {
+  dtNavMeshQuery* navQuery = dtAllocNavMeshQuery();
+  navQuery->init(navMesh, 2048);
+
+  // Bounds of the navmesh with one extra node all around for the samples off
+  // the navmesh
+  vec3f bmin = vec3f::Constant(std::numeric_limits<float>::max());
+  vec3f bmax = vec3f::Constant(std::numeric_limits<float>::lowest());
+  for (int iTile = 0; iTile < navMesh->getMaxTiles(); ++iTile) {
+    const dtMeshTile* tile = navMesh->getTile(iTile);
+    if (!tile->header)
+      continue;
+    bmin = bmin.cwiseMin(Eigen::Map<const vec3f>(tile->header->bmin));
+    bmax = bmax.cwiseMax(Eigen::Map<const vec3f>(tile->header->bmax));
+  }
+  if ((bmin.array() > bmax.array()).any()) {
+    bmin = bmax = vec3f::Zero();
+  }
+  originX_ = (std::floor(bmin[0] / cellSize_) - 1) * cellSize_;
+  originZ_ = (std::floor(bmin[2] / cellSize_) - 1) * cellSize_;
+  sizeX_ = static_cast<int>(std::ceil((bmax[0] - originX_) / cellSize_)) + 2;
+  sizeZ_ = static_cast<int>(std::ceil((bmax[2] - originZ_) / cellSize_)) + 2;
+  const int numNodes = sizeX_ * sizeZ_;
+
+  // Nodes on the navmesh, one sample per polygon they lie in
+  std::vector<PendingSample> pending;
+  for (int iTile = 0; iTile < navMesh->getMaxTiles(); ++iTile) {
+    const dtMeshTile* tile = navMesh->getTile(iTile);
+    if (!tile->header)
+      continue;
+    const dtPolyRef base = navMesh->getPolyRefBase(tile);
+    for (int jPoly = 0; jPoly < tile->header->polyCount; ++jPoly) {
+      const dtPoly* poly = &tile->polys[jPoly];
+      if (poly->getType() != DT_POLYTYPE_GROUND ||
+          !filter->passFilter(base | jPoly, tile, poly))
+        continue;
+
+      float verts[DT_VERTS_PER_POLYGON * 3];
+      float minX = std::numeric_limits<float>::max(), maxX = -minX;
+      float minZ = minX, maxZ = -minX;
+      for (int k = 0; k < poly->vertCount; ++k) {
+        dtVcopy(&verts[k * 3], &tile->verts[poly->verts[k] * 3]);
+        minX = std::min(minX, verts[k * 3]);
+        maxX = std::max(maxX, verts[k * 3]);
+        minZ = std::min(minZ, verts[k * 3 + 2]);
+        maxZ = std::max(maxZ, verts[k * 3 + 2]);
+      }
+
+      const int x0 = std::ceil((minX - originX_) / cellSize_);
+      const int x1 = std::floor((maxX - originX_) / cellSize_);
+      const int z0 = std::ceil((minZ - originZ_) / cellSize_);
+      const int z1 = std::floor((maxZ - originZ_) / cellSize_);
+      for (int z = z0; z <= z1; ++z) {
+        for (int x = x0; x <= x1; ++x) {
+          vec3f pt(originX_ + x * cellSize_, 0, originZ_ + z * cellSize_);
+          float height;
+          if (!dtPointInPolygon(pt.data(), verts, poly->vertCount) ||
+              dtStatusFailed(
+                  navQuery->getPolyHeight(base | jPoly, pt.data(), &height)))
+            continue;
+          pending.push_back({z * sizeX_ + x, height, base | jPoly});
+        }
+      }
+    }
+  }
+
+  auto byNodeAndHeight = [](const PendingSample& a, const PendingSample& b) {
+    return a.node < b.node || (a.node == b.node && a.height < b.height);
+  };
+  auto sameSurface = [](const PendingSample& a, const PendingSample& b) {
+    return a.node == b.node && b.height - a.height < SAME_SURFACE_HEIGHT;
+  };
+  // Nodes on the edge between polygons lie in both
+  std::sort(pending.begin(), pending.end(), byNodeAndHeight);
+  pending.erase(std::unique(pending.begin(), pending.end(), sameSurface),
+                pending.end());
+
+  // Nodes next to the navmesh get a sample at the height of every surface
+  // they are next to, unless they lie on that surface themselves
+  std::vector<int> onMeshStart(numNodes + 1, 0);
+  for (const auto& sample : pending)
+    ++onMeshStart[sample.node + 1];
+  for (int i = 0; i < numNodes; ++i)
+    onMeshStart[i + 1] += onMeshStart[i];
+  const int numOnMesh = pending.size();
+  for (int z = 0; z < sizeZ_; ++z) {
+    for (int x = 0; x < sizeX_; ++x) {
+      const int node = z * sizeX_ + x;
+      const size_t firstOffMesh = pending.size();
+      for (int nz = std::max(z - 1, 0); nz <= std::min(z + 1, sizeZ_ - 1);
+           ++nz) {
+        for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, sizeX_ - 1);
+             ++nx) {
+          const int neighbour = nz * sizeX_ + nx;
+          for (int i = onMeshStart[neighbour]; i < onMeshStart[neighbour + 1];
+               ++i) {
+            const float height = pending[i].height;
+            auto near = [height](const PendingSample& sample) {
+              return std::abs(sample.height - height) < MAX_Y_DELTA;
+            };
+            if (std::any_of(pending.begin() + onMeshStart[node],
+                            pending.begin() + onMeshStart[node + 1], near) ||
+                std::any_of(pending.begin() + firstOffMesh, pending.end(),
+                            near))
+              continue;
+            pending.push_back({node, height, 0});
+          }
+        }
+      }
+    }
+  }
+  dtFreeNavMeshQuery(navQuery);
+
+  // The wall searches are independent, spread them over all cores like
+  // PathFinder::findPaths.  Samples that turn out to be too far from the
+  // navmesh get an infinite height and are dropped below
+  std::vector<Sample> computed(pending.size());
+  const int numWorkers =
+      std::max(1, std::min<int>(pending.size(),
+                                std::thread::hardware_concurrency()));
+  const float offMeshExt[3] = {2 * cellSize_, MAX_Y_DELTA, 2 * cellSize_};
+#pragma omp parallel for schedule(static, 1)
+  for (int iWorker = 0; iWorker < numWorkers; ++iWorker) {
+    dtNavMeshQuery* workerQuery = dtAllocNavMeshQuery();
+    workerQuery->init(navMesh, 2048);
+    const int blockEnd = (iWorker + 1) * pending.size() / numWorkers;
+    for (int i = iWorker * pending.size() / numWorkers; i < blockEnd; ++i) {
+      const PendingSample& sample = pending[i];
+      const vec3f pt(originX_ + (sample.node % sizeX_) * cellSize_,
+                     sample.height,
+                     originZ_ + (sample.node / sizeX_) * cellSize_);
+      Sample& result = computed[i];
+      result = {sample.height, maxSearchRadius_, 0, 0};
+
+      vec3f hitPos, hitNormal;
+      float hitDist;
+      if (i < numOnMesh) {
+        workerQuery->findDistanceToWall(sample.ref, pt.data(),
+                                        maxSearchRadius_, filter, &hitDist,
+                                        hitPos.data(), hitNormal.data());
+        if (hitDist >= maxSearchRadius_)
+          continue;
+        result.dist = hitDist;
+        hitNormal = pt - hitPos;
+      } else {
+        dtPolyRef ref = 0;
+        if (dtStatusFailed(workerQuery->findNearestPoly(
+                pt.data(), offMeshExt, filter, &ref, hitPos.data())) ||
+            ref == 0) {
+          result.height = std::numeric_limits<float>::infinity();
+          continue;
+        }
+        hitNormal = hitPos - pt;
+        hitNormal[1] = 0;
+        result.dist = -hitNormal.norm();
+      }
+      hitNormal[1] = 0;
+      if (hitNormal.norm() > 1e-6) {
+        hitNormal.normalize();
+        result.normalX = hitNormal[0];
+        result.normalZ = hitNormal[2];
+      }
+    }
+    dtFreeNavMeshQuery(workerQuery);
+  }
+
+  // Gather the samples of every node, ordered by height
+  std::vector<int> order(pending.size());
+  for (int i = 0; i < order.size(); ++i)
+    order[i] = i;
+  std::sort(order.begin(), order.end(), [&](int a, int b) {
+    return byNodeAndHeight(pending[a], pending[b]);
+  });
+  nodeStart_.assign(numNodes + 1, 0);
+  samples_.reserve(pending.size());
+  for (int i : order) {
+    if (computed[i].height == std::numeric_limits<float>::infinity())
+      continue;
+    samples_.push_back(computed[i]);
+    ++nodeStart_[pending[i].node + 1];
+  }
+  for (int i = 0; i < numNodes; ++i)
+    nodeStart_[i + 1] += nodeStart_[i];
+}
+
+const ObstacleDistanceGrid::Sample* ObstacleDistanceGrid::findSample(
+    int x,
+    int z,
+    float height) const {
+  const Sample* best = nullptr;
+  const int node = z * sizeX_ + x;
+  for (int i = nodeStart_[node]; i < nodeStart_[node + 1]; ++i) {
+    const float dy = std::abs(samples_[i].height - height);
+    if (dy <= MAX_Y_DELTA &&
+        (!best || dy < std::abs(best->height - height)))
+      best = &samples_[i];
+  }
+  return best;
+}
+
+bool ObstacleDistanceGrid::closestObstacleSurfacePoint(
+    const vec3f& pt,
+    float maxSearchRadius,
+    HitRecord* hit) const {
+  const float fx = (pt[0] - originX_) / cellSize_;
+  const float fz = (pt[2] - originZ_) / cellSize_;
+  const int x = std::floor(fx);
+  const int z = std::floor(fz);
+  if (x < 0 || z < 0 || x + 1 >= sizeX_ || z + 1 >= sizeZ_)
+    return false;
+  const float tx = fx - x, tz = fz - z;
+
+  float dist = 0, normalX = 0, normalZ = 0;
+  bool wallEverywhere = true;
+  for (int corner = 0; corner < 4; ++corner) {
+    const int cx = corner & 1, cz = corner >> 1;
+    const Sample* sample = findSample(x + cx, z + cz, pt[1]);
+    if (!sample)
+      return false;
+    const float weight = (cx ? tx : 1 - tx) * (cz ? tz : 1 - tz);
+    dist += weight * sample->dist;
+    normalX += weight * sample->normalX;
+    normalZ += weight * sample->normalZ;
+    wallEverywhere = wallEverywhere && sample->dist < maxSearchRadius_;
+  }
+
+  if (!wallEverywhere) {
+    // A node without a wall in reach bounds the distance at pt from below
+    if (maxSearchRadius > maxSearchRadius_ - cellSize_ * std::sqrt(2.0f))
+      return false;
+    *hit = {pt, vec3f::Zero(), maxSearchRadius};
+    return true;
+  }
+
+  const float normalLength = std::hypot(normalX, normalZ);
+  // The walls of the nodes point in opposite directions, e.g. on the medial
+  // axis of a corridor narrower than a cell
+  if (normalLength < 1e-3)
+    return false;
+  normalX /= normalLength;
+  normalZ /= normalLength;
+
+  // Samples off the navmesh are only there to interpolate up to its boundary
+  dist = std::min(std::max(dist, 0.0f), maxSearchRadius);
+  *hit = {vec3f(pt[0] - dist * normalX, pt[1], pt[2] - dist * normalZ),
+          vec3f(normalX, 0, normalZ), dist};
+  return true;
+}
+
+}  // namespace impl
+}  // namespace nav
+}  // namespace esp
@@ -0,0 +1,93 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <vector>
+
+#include "esp/core/esp.h"
+#include "esp/nav/PathFinder.h"
+
+class dtNavMesh;
+class dtQueryFilter;
+
+namespace esp {
+namespace nav {
+namespace impl {
+
+// Distance to the closest obstacle sampled on a regular grid over the navmesh,
+// so that PathFinder::closestObstacleSurfacePoint becomes a lookup instead of
+// a local search of the navmesh.
+//
+// The grid is 2.5D: every grid node holds one sample per navmesh surface
+// above or below it, so stacked floors don't interfere.  Nodes on the navmesh
+// store the exact result of Detour's findDistanceToWall.  Nodes just off the
+// navmesh store the negative distance to it, which makes the field signed and
+// lets lookups interpolate right up to the boundary.
+//
+// Lookups interpolate the distance and the direction to the wall bilinearly
+// between the four surrounding nodes.  They fail if one of the nodes has no
+// sample at the height of the query, e.g. far off the navmesh, or if the
+// search radius of the query is larger than the one the grid was built with.
+//
+// Takes O(nodes) wall searches to construct and O(1) to query
+class ObstacleDistanceGrid {
+ public:
+  /**
+   * @param[in] navMesh The navmesh to build the grid over
+   * @param[in] filter Polygons that don't pass the filter are obstacles
+   * @param[in] cellSize The spacing of the grid nodes
+   * @param[in] maxSearchRadius Radius of the wall searches, lookups with a
+   *larger radius fail
+   **/
+  ObstacleDistanceGrid(const dtNavMesh* navMesh,
+                       const dtQueryFilter* filter,
+                       float cellSize,
+                       float maxSearchRadius);
+
+  /**
+   * Looks up the closest obstacle to @p pt like
+   * PathFinder::closestObstacleSurfacePoint.  The normal is horizontal, the
+   * hit position at the height of @p pt.  Returns false if the grid can't
+   * answer the query
+   **/
+  bool closestObstacleSurfacePoint(const vec3f& pt,
+                                   float maxSearchRadius,
+                                   HitRecord* hit) const;
+
+  float cellSize() const { return cellSize_; }
+
+  //! Number of samples over all grid nodes
+  size_t numSamples() const { return samples_.size(); }
+
+ private:
+  struct Sample {
+    float height;
+    //! Distance to the closest wall, negative off the navmesh and
+    //! maxSearchRadius_ if there is no wall within it
+    float dist;
+    //! Horizontal direction from the wall towards the navmesh, zero if there
+    //! is no wall within maxSearchRadius_
+    float normalX, normalZ;
+  };
+
+  //! Returns the sample of node (x, z) closest to @p height, null if none is
+  //! close enough
+  const Sample* findSample(int x, int z, float height) const;
+
+  const float cellSize_, maxSearchRadius_;
+  //! Position of node (0, 0)
+  float originX_, originZ_;
+  int sizeX_, sizeZ_;
+  //! Samples of node (x, z) are
+  //! samples_[nodeStart_[z * sizeX_ + x], nodeStart_[z * sizeX_ + x + 1])
+  std::vector<int> nodeStart_;
+  std::vector<Sample> samples_;
+
+  ESP_SMART_POINTERS(ObstacleDistanceGrid)
+};
+
+}  // namespace impl
+}  // namespace nav
+}  // namespace esp
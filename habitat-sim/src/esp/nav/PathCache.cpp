@@ -0,0 +1,118 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "PathCache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+
+namespace esp {
+namespace nav {
+namespace impl {
+
+PathCache::PathCache(size_t maxBytes, float quantization)
+    : maxBytes_{maxBytes}, quantization_{quantization} {}
+
+bool PathCache::Key::operator==(const Key& other) const {
+  return startRef == other.startRef && endRef == other.endRef &&
+         std::equal(start, start + 3, other.start) &&
+         std::equal(end, end + 3, other.end);
+}
+
+size_t PathCache::KeyHash::operator()(const Key& key) const {
+  size_t seed = std::hash<dtPolyRef>()(key.startRef);
+  auto combine = [&seed](size_t value) {
+    seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+  };
+  combine(std::hash<dtPolyRef>()(key.endRef));
+  for (int i = 0; i < 3; ++i) {
+    combine(std::hash<int32_t>()(key.start[i]));
+    combine(std::hash<int32_t>()(key.end[i]));
+  }
+  return seed;
+}
+
+PathCache::Key PathCache::makeKey(dtPolyRef startRef,
+                                  const vec3f& start,
+                                  dtPolyRef endRef,
+                                  const vec3f& end) const {
+  Key key;
+  key.startRef = startRef;
+  key.endRef = endRef;
+  for (int i = 0; i < 3; ++i) {
+    if (quantization_ > 0) {
+      key.start[i] = std::floor(start[i] / quantization_);
+      key.end[i] = std::floor(end[i] / quantization_);
+    } else {
+      std::memcpy(&key.start[i], &start[i], sizeof(float));
+      std::memcpy(&key.end[i], &end[i], sizeof(float));
+    }
+  }
+  return key;
+}
+
+size_t PathCache::entryBytes(const Entry& entry) {
+  // The list node and the index entry cost about as much as the key each
+  return 3 * sizeof(Key) + 4 * sizeof(void*) +
+         entry.second.capacity() * sizeof(dtPolyRef);
+}
+
+bool PathCache::find(const Key& key, std::vector<dtPolyRef>* polys) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = index_.find(key);
+  if (it == index_.end()) {
+    ++misses_;
+    return false;
+  }
+  ++hits_;
+  entries_.splice(entries_.begin(), entries_, it->second);
+  polys->assign(it->second->second.begin(), it->second->second.end());
+  return true;
+}
+
+void PathCache::insert(const Key& key, const dtPolyRef* polys, int numPolys) {
+  Entry entry{key, std::vector<dtPolyRef>(polys, polys + numPolys)};
+  const size_t newBytes = entryBytes(entry);
+  if (newBytes > maxBytes_)
+    return;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  // Another thread may have cached the same query in the meantime
+  if (index_.count(key))
+    return;
+  entries_.emplace_front(std::move(entry));
+  index_[key] = entries_.begin();
+  bytes_ += newBytes;
+  while (bytes_ > maxBytes_) {
+    bytes_ -= entryBytes(entries_.back());
+    index_.erase(entries_.back().first);
+    entries_.pop_back();
+  }
+}
+
+uint64_t PathCache::hits() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return hits_;
+}
+
+uint64_t PathCache::misses() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return misses_;
+}
+
+size_t PathCache::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.size();
+}
+
+size_t PathCache::bytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return bytes_;
+}
+
+}  // namespace impl
+}  // namespace nav
+}  // namespace esp
@@ -0,0 +1,91 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "esp/core/esp.h"
+
+#include "DetourNavMesh.h"
+
+namespace esp {
+namespace nav {
+namespace impl {
+
+// LRU cache of the polygon corridors of findPath, for training and evaluation
+// loops that ask for the same start and goal over and over.
+//
+// Entries are keyed on the start and end polygons and on the endpoints
+// quantized to a grid, so nearby queries share an entry.  Only the corridor
+// is cached, not the path: a hit still runs the string pulling through the
+// corridor with the exact endpoints, which is cheap next to the search, so
+// the path always starts and ends at the requested points even when they
+// differ from those of the query that filled the entry.
+//
+// The cache is thread safe and evicts the least recently used corridors to
+// stay within a budget of bytes.
+class PathCache {
+ public:
+  /**
+   * @param[in] maxBytes Memory budget of the entries
+   * @param[in] quantization Size of the grid cells the endpoints are
+   * quantized to, 0 to only share entries between identical endpoints
+   **/
+  PathCache(size_t maxBytes, float quantization);
+
+  struct Key {
+    dtPolyRef startRef, endRef;
+    int32_t start[3], end[3];
+    bool operator==(const Key& other) const;
+  };
+
+  Key makeKey(dtPolyRef startRef,
+              const vec3f& start,
+              dtPolyRef endRef,
+              const vec3f& end) const;
+
+  //! Copies the corridor cached for @p key to @p polys and returns true, or
+  //! returns false if there is none
+  bool find(const Key& key, std::vector<dtPolyRef>* polys);
+
+  //! Caches the corridor @p polys of @p numPolys polygons for @p key
+  void insert(const Key& key, const dtPolyRef* polys, int numPolys);
+
+  uint64_t hits() const;
+  uint64_t misses() const;
+  size_t size() const;
+  size_t bytes() const;
+  size_t maxBytes() const { return maxBytes_; }
+  float quantization() const { return quantization_; }
+
+ private:
+  struct KeyHash {
+    size_t operator()(const Key& key) const;
+  };
+  typedef std::pair<Key, std::vector<dtPolyRef>> Entry;
+
+  static size_t entryBytes(const Entry& entry);
+
+  const size_t maxBytes_;
+  const float quantization_;
+
+  mutable std::mutex mutex_;
+  //! Most recently used first
+  std::list<Entry> entries_;
+  std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index_;
+  size_t bytes_ = 0;
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+
+  ESP_SMART_POINTERS(PathCache)
+};
+
+}  // namespace impl
+}  // namespace nav
+}  // namespace esp
@@ -0,0 +1,147 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "PathCorridor.h"
+
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "DetourCommon.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourPathCorridor.h"
+
+#include "esp/nav/PolyPath.h"
+
+namespace esp {
+namespace nav {
+
+namespace {
+// Room the corridor has to grow past the polygons of the path it starts
+// with, as the start moves off of it
+static const int CORRIDOR_SLACK = 256;
+}  // namespace
+
+struct PathCorridor::Impl {
+  Impl() { navQuery_ = dtAllocNavMeshQuery(); }
+  ~Impl() { dtFreeNavMeshQuery(navQuery_); }
+
+  bool findPath(ShortestPath& path, PathFinder& pathfinder) {
+    path.points.clear();
+    path.geodesicDistance = std::numeric_limits<float>::infinity();
+    const dtNavMesh* navMesh = pathfinder.navMesh_;
+    const dtQueryFilter* filter = pathfinder.filter_;
+    if (!navMesh)
+      return false;
+    // The navmesh may have been replaced or had its tiles rebuilt, either
+    // way the corridor's polygons can't be trusted
+    if (pathfinder.navMeshGeneration_ != navMeshGeneration_) {
+      valid_ = false;
+      if (dtStatusFailed(navQuery_->init(navMesh, PathFinder::MAX_NODES)))
+        return false;
+      navMeshGeneration_ = pathfinder.navMeshGeneration_;
+    }
+
+    if (!valid_ || path.requestedEnd != requestedEnd_ ||
+        !corridor_->isValid(corridor_->getPathCount(), navQuery_, filter) ||
+        !movePosition(path.requestedStart, filter)) {
+      if (!replan(path.requestedStart, path.requestedEnd, pathfinder))
+        return false;
+    }
+
+    // The straightened path over the corridor, without its start
+    const int maxCorners = corridor_->getPathCount() + 2;
+    std::vector<float> corners(maxCorners * 3);
+    std::vector<unsigned char> cornerFlags(maxCorners);
+    std::vector<dtPolyRef> cornerPolys(maxCorners);
+    const int numCorners =
+        corridor_->findCorners(corners.data(), cornerFlags.data(),
+                               cornerPolys.data(), maxCorners, navQuery_,
+                               filter);
+
+    path.points.emplace_back(Eigen::Map<const vec3f>(corridor_->getPos()));
+    path.geodesicDistance = 0;
+    for (int i = 0; i < numCorners; ++i) {
+      path.points.emplace_back(Eigen::Map<const vec3f>(&corners[i * 3]));
+      path.geodesicDistance +=
+          (path.points.back() - path.points[path.points.size() - 2]).norm();
+    }
+    return true;
+  }
+
+  // Moves the start of the corridor to pos, fails if pos can't be reached by
+  // moving along the navmesh surface from the current start
+  bool movePosition(const vec3f& pos, const dtQueryFilter* filter) {
+    if (!corridor_->movePosition(pos.data(), navQuery_, filter))
+      return false;
+    // The corridor drops polygons off its end once it is full
+    if (corridor_->getLastPoly() != endRef_)
+      return false;
+
+    const vec3f moved = Eigen::Map<const vec3f>(corridor_->getPos());
+    // Same tolerances as PathFinder::isNavigable
+    return (Eigen::Vector2f(pos[0], pos[2]) -
+            Eigen::Vector2f(moved[0], moved[2]))
+                   .norm() <= 1e-2 &&
+           std::abs(pos[1] - moved[1]) <= 0.5;
+  }
+
+  // Same search as PathFinder::findPath, with all of its speedups
+  bool replan(const vec3f& start, const vec3f& end, PathFinder& pathfinder) {
+    valid_ = false;
+    ++numReplans_;
+
+    impl::PolyPath polyPath;
+    if (!pathfinder.findPolyPath(start, {end}, navQuery_, &polyPath))
+      return false;
+
+    const std::vector<dtPolyRef>& polys = polyPath.polys;
+    const int numPolys = polys.size();
+    if (corridorCapacity_ < numPolys + CORRIDOR_SLACK) {
+      corridor_ = std::make_unique<dtPathCorridor>();
+      corridorCapacity_ = numPolys + CORRIDOR_SLACK;
+      if (!corridor_->init(corridorCapacity_)) {
+        corridorCapacity_ = 0;
+        return false;
+      }
+    }
+    corridor_->reset(polys[0], polyPath.start.data());
+    corridor_->setCorridor(polyPath.end.data(), polys.data(), numPolys);
+    requestedEnd_ = end;
+    endRef_ = polys.back();
+    valid_ = true;
+    return true;
+  }
+
+  //! Sized for the longest path so far, see replan
+  std::unique_ptr<dtPathCorridor> corridor_;
+  int corridorCapacity_ = 0;
+  dtNavMeshQuery* navQuery_;
+  //! PathFinder::navMeshGeneration_ navQuery_ was initialized for
+  uint64_t navMeshGeneration_ = 0;
+
+  //! Whether corridor_ holds a path to requestedEnd_, through endRef_
+  bool valid_ = false;
+  vec3f requestedEnd_;
+  dtPolyRef endRef_ = 0;
+  int numReplans_ = 0;
+};
+
+PathCorridor::PathCorridor(const PathFinder::ptr& pathfinder)
+    : pimpl_(spimpl::make_unique_impl<Impl>()), pathfinder_(pathfinder) {}
+
+bool PathCorridor::findPath(ShortestPath& path) {
+  return pimpl_->findPath(path, *pathfinder_);
+}
+
+void PathCorridor::reset() {
+  pimpl_->valid_ = false;
+}
+
+int PathCorridor::getNumReplans() const {
+  return pimpl_->numReplans_;
+}
+
+}  // namespace nav
+}  // namespace esp
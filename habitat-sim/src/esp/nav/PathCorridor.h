@@ -0,0 +1,50 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "esp/core/esp.h"
+#include "esp/nav/PathFinder.h"
+
+namespace esp {
+namespace nav {
+
+/**
+ * Shortest path to a fixed goal from a start that moves in small steps, like
+ * an agent following the path.
+ *
+ * Keeps the polygons the last path went through.  When the start moves, the
+ * corridor is only updated around the old start and the path straightened
+ * again over the corridor, which is much cheaper than a new search.  A full
+ * search is only run if the goal changes, the start moves to somewhere it
+ * can't reach along the navmesh surface or the navmesh changes.
+ *
+ * Not thread safe, use one PathCorridor per agent.
+ **/
+class PathCorridor {
+ public:
+  explicit PathCorridor(const PathFinder::ptr& pathfinder);
+
+  /**
+   * Fills @p path with the same results as PathFinder::findPath, reusing the
+   * corridor of the previous call if possible.  Paths found by moving the
+   * corridor follow its polygons, so they can differ slightly from a new
+   * search, which isn't optimal either.
+   **/
+  bool findPath(ShortestPath& path);
+
+  //! Forgets the corridor so that the next findPath runs a full search
+  void reset();
+
+  //! Returns the number of full searches run so far
+  int getNumReplans() const;
+
+  ESP_SMART_POINTERS_WITH_UNIQUE_PIMPL(PathCorridor)
+
+ protected:
+  PathFinder::ptr pathfinder_;
+};
+
+}  // namespace nav
+}  // namespace esp
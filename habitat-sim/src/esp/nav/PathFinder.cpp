@@ -3,22 +3,49 @@
 // LICENSE file in the root directory of this source tree.
 
 #include "PathFinder.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <list>
+#include <mutex>
+#include <sstream>
 #include <stack>
+#include <thread>
 #include <unordered_map>
+#include <unordered_set>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <cstdio>
 #define _USE_MATH_DEFINES
 #include <cmath>
 #include <limits>
+#include <numeric>
 
 #include "esp/assets/SceneLoader.h"
 #include "esp/core/esp.h"
-
+#include "esp/core/random.h"
+#include "esp/nav/ClusterGraph.h"
+#include "esp/nav/GeodesicDistanceField.h"
+#include "esp/nav/NavMeshSampler.h"
+#include "esp/nav/ObstacleDistanceGrid.h"
+#include "esp/nav/PathCache.h"
+#include "esp/nav/PolyGridIndex.h"
+#include "esp/nav/PolyPath.h"
+#include "esp/scene/SemanticScene.h"
+
+#include "DetourCommon.h"
 #include "DetourNavMesh.h"
 #include "DetourNavMeshBuilder.h"
 #include "DetourNavMeshQuery.h"
 #include "DetourNode.h"
 #include "Recast.h"
+#include "RecastAlloc.h"
 
 using namespace esp;
 
@@ -26,16 +53,35 @@ namespace esp {
 namespace nav {
 namespace {
 
+//! Island id of polygons that aren't part of any island yet
+const uint32_t NO_ISLAND = std::numeric_limits<uint32_t>::max();
+
+//! Maximum number of polygons a single step of tryStep can cross
+const int MAX_STEP_POLYS = 256;
+
+//! How far short of a navmesh border vertex a ray may stop for the vertex to
+//! still count as in sight, see geodesicDistanceMatrix
+const float kVertexSightSlack = 0.01f;  // 1cm
+
+// Snaps pt to the closest point on the navmesh.  polyGridIndex, if given,
+// answers the query for points that lie on the navmesh
 std::tuple<dtStatus, dtPolyRef, vec3f> projectToPoly(
     const vec3f& pt,
     const dtNavMeshQuery* navQuery,
-    const dtQueryFilter* filter) {
+    const dtQueryFilter* filter,
+    const esp::nav::impl::PolyGridIndex* polyGridIndex = nullptr) {
+  dtPolyRef polyRef;
+  vec3f polyXYZ;
+  if (polyGridIndex) {
+    polyRef = polyGridIndex->findPolyUnder(pt, navQuery, filter, &polyXYZ);
+    if (polyRef)
+      return std::make_tuple(DT_SUCCESS, polyRef, polyXYZ);
+  }
+
   // Defines size of the bounding box to search in for the nearest polygon.  If
   // there is no polygon inside the bounding box, the status is set to failure
   // and polyRef == 0
   constexpr float polyPickExt[3] = {2, 4, 2};  // [2 * dx, 2 * dy, 2 * dz]
-  dtPolyRef polyRef;
-  vec3f polyXYZ;
   dtStatus status = navQuery->findNearestPoly(pt.data(), polyPickExt, filter,
                                               &polyRef, polyXYZ.data());
 
@@ -49,81 +95,279 @@ namespace impl {
 // are connected This gives O(1) lookup for if a path between two polygons
 // exists or not
 // Takes O(npolys) to construct
+//
+// The island of every polygon is stored in one dense array per tile, indexed
+// by the polygon index of the ref, so lookups are two array reads instead of
+// a hash map lookup
 class IslandSystem {
  public:
-  IslandSystem(const dtNavMesh* navMesh, const dtQueryFilter* filter) {
-    std::vector<vec3f> islandVerts;
+  IslandSystem(const dtNavMesh* navMesh, const dtQueryFilter* filter)
+      : navMesh_{navMesh}, filter_{filter} {
+    tileIslands_.resize(navMesh->getMaxTiles());
+    tileSalts_.resize(navMesh->getMaxTiles(), 0);
 
     // Iterate over all tiles
     for (int iTile = 0; iTile < navMesh->getMaxTiles(); ++iTile) {
       const dtMeshTile* tile = navMesh->getTile(iTile);
-      if (!tile)
+      if (!tile || !tile->header)
+        continue;
+      initTile(tile);
+    }
+    for (int iTile = 0; iTile < navMesh->getMaxTiles(); ++iTile) {
+      const dtMeshTile* tile = navMesh->getTile(iTile);
+      if (!tile || !tile->header)
+        continue;
+      addTileIslands(tile);
+    }
+  }
+
+  //! Radius and area of an island, as saved with the navmesh
+  struct IslandRecord {
+    float radius;
+    float area;
+  };
+
+  // Restores islands saved from islandRecords and tileIslands instead of
+  // running connected component analysis.  tileIslands holds the island of
+  // every polygon, indexed by tile index and then polygon index.
+  IslandSystem(const dtNavMesh* navMesh,
+               const dtQueryFilter* filter,
+               const std::vector<IslandRecord>& islandRecords,
+               std::vector<std::vector<uint32_t>> tileIslands)
+      : navMesh_{navMesh},
+        filter_{filter},
+        tileIslands_{std::move(tileIslands)} {
+    tileIslands_.resize(navMesh->getMaxTiles());
+    tileSalts_.resize(navMesh->getMaxTiles(), 0);
+    islands_.resize(islandRecords.size());
+    for (int i = 0; i < islandRecords.size(); ++i) {
+      islands_[i].radius = islandRecords[i].radius;
+      islands_[i].area = islandRecords[i].area;
+    }
+
+    for (int iTile = 0; iTile < navMesh->getMaxTiles(); ++iTile) {
+      const dtMeshTile* tile = navMesh->getTile(iTile);
+      if (!tile || !tile->header)
         continue;
+      tileSalts_[iTile] = tile->salt;
+      tileIslands_[iTile].resize(tile->header->polyCount, NO_ISLAND);
 
-      // Iterate over all polygons in a tile
+      const dtPolyRef base = navMesh->getPolyRefBase(tile);
       for (int jPoly = 0; jPoly < tile->header->polyCount; ++jPoly) {
-        // Get the polygon reference from the tile and polygon id
-        dtPolyRef startRef = navMesh->encodePolyId(iTile, tile->salt, jPoly);
-
-        // If the polygon ref is valid, and we haven't seen it yet,
-        // start connected component analysis from this polygon
-        if (navMesh->isValidPolyRef(startRef) &&
-            (polyToIsland_.find(startRef) == polyToIsland_.end())) {
-          uint32_t newIslandId = islandRadius_.size();
-          expandFrom(navMesh, filter, newIslandId, startRef, islandVerts);
-
-          // The radius is calculated as the max deviation from the mean for all
-          // points in the island
-          vec3f centroid = vec3f::Zero();
-          for (auto& v : islandVerts) {
-            centroid += v;
-          }
-          centroid /= islandVerts.size();
-
-          float maxRadius = 0.0;
-          for (auto& v : islandVerts) {
-            maxRadius = std::max(maxRadius, (v - centroid).norm());
-          }
-
-          islandRadius_.emplace_back(maxRadius);
-        }
+        const uint32_t islandId = tileIslands_[iTile][jPoly];
+        if (islandId < islands_.size())
+          islands_[islandId].polys.push_back(base | jPoly);
+        else
+          tileIslands_[iTile][jPoly] = NO_ISLAND;
       }
     }
+    for (uint32_t islandId = 0; islandId < islands_.size(); ++islandId) {
+      if (islands_[islandId].polys.empty())
+        freeIslandIds_.push_back(islandId);
+    }
+  }
+
+  std::vector<IslandRecord> islandRecords() const {
+    std::vector<IslandRecord> records;
+    for (const Island& island : islands_) {
+      records.push_back({island.radius, island.area});
+    }
+    return records;
+  }
+
+  //! Island of every polygon of tile, indexed by polygon index
+  const std::vector<uint32_t>& tileIslands(const dtMeshTile* tile) const {
+    return tileIslands_[navMesh_->decodePolyIdTile(
+        navMesh_->getPolyRefBase(tile))];
   }
 
   inline bool hasConnection(dtPolyRef startRef, dtPolyRef endRef) const {
     // If both polygons are on the same island, there must be a path between
     // them
-    auto itStart = polyToIsland_.find(startRef);
-    if (itStart == polyToIsland_.end())
-      return false;
-
-    auto itEnd = polyToIsland_.find(endRef);
-    if (itEnd == polyToIsland_.end())
+    const uint32_t startIsland = islandOf(startRef);
+    if (startIsland == NO_ISLAND)
       return false;
 
-    return itStart->second == itEnd->second;
+    return startIsland == islandOf(endRef);
   }
 
   inline float islandRadius(dtPolyRef ref) const {
-    auto itRef = polyToIsland_.find(ref);
-    if (itRef == polyToIsland_.end())
+    const uint32_t islandId = islandOf(ref);
+    if (islandId == NO_ISLAND)
+      return 0.0;
+
+    return islands_[islandId].radius;
+  }
+
+  inline float islandArea(dtPolyRef ref) const {
+    const uint32_t islandId = islandOf(ref);
+    if (islandId == NO_ISLAND)
       return 0.0;
 
-    return islandRadius_[itRef->second];
+    return islands_[islandId].area;
+  }
+
+  //! Island of ref, NO_ISLAND if ref isn't on the navmesh
+  inline uint32_t islandId(dtPolyRef ref) const { return islandOf(ref); }
+
+  inline int islandPolyCount(dtPolyRef ref) const {
+    const uint32_t islandId = islandOf(ref);
+    if (islandId == NO_ISLAND)
+      return 0;
+
+    return islands_[islandId].polys.size();
+  }
+
+  // Adds the islands the polygons of tile are on to islands.  Call this for
+  // every tile that is about to be removed from the navmesh.
+  void collectIslands(const dtMeshTile* tile,
+                      std::unordered_set<uint32_t>& islands) const {
+    const dtPolyRef base = navMesh_->getPolyRefBase(tile);
+    for (int jPoly = 0; jPoly < tile->header->polyCount; ++jPoly) {
+      const uint32_t islandId = islandOf(base | jPoly);
+      if (islandId != NO_ISLAND)
+        islands.insert(islandId);
+    }
+  }
+
+  // Updates the islands after tiles of the navmesh were replaced.
+  // dirtyIslands are the islands of the removed tiles (see collectIslands)
+  // and addedTiles the tiles that replaced them.  Only those islands and the
+  // ones the added tiles link to are flood filled again; all others are kept
+  // as is.
+  void updateTiles(std::unordered_set<uint32_t> dirtyIslands,
+                   const std::vector<const dtMeshTile*>& addedTiles) {
+    for (const dtMeshTile* tile : addedTiles) {
+      initTile(tile);
+    }
+
+    // The new polygons may join islands that never touched the old tiles
+    for (const dtMeshTile* tile : addedTiles) {
+      for (int jPoly = 0; jPoly < tile->header->polyCount; ++jPoly) {
+        const dtPoly* poly = &tile->polys[jPoly];
+        for (unsigned int iLink = poly->firstLink; iLink != DT_NULL_LINK;
+             iLink = tile->links[iLink].next) {
+          const uint32_t islandId = islandOf(tile->links[iLink].ref);
+          if (islandId != NO_ISLAND)
+            dirtyIslands.insert(islandId);
+        }
+      }
+    }
+
+    // Polygons of removed tiles are no longer valid, the rest of the dirty
+    // islands is flood filled again along with the new tiles
+    std::vector<dtPolyRef> seeds;
+    for (const uint32_t islandId : dirtyIslands) {
+      for (const dtPolyRef ref : islands_[islandId].polys) {
+        if (islandOf(ref) == islandId) {
+          setIsland(ref, NO_ISLAND);
+          if (navMesh_->isValidPolyRef(ref))
+            seeds.push_back(ref);
+        }
+      }
+      islands_[islandId] = Island();
+      freeIslandIds_.push_back(islandId);
+    }
+    for (const dtPolyRef ref : seeds) {
+      if (islandOf(ref) == NO_ISLAND)
+        addIsland(ref);
+    }
+    for (const dtMeshTile* tile : addedTiles) {
+      addTileIslands(tile);
+    }
   }
 
  private:
-  std::unordered_map<dtPolyRef, uint32_t> polyToIsland_;
-  std::vector<float> islandRadius_;
+  struct Island {
+    float radius = 0.0;
+    //! Surface area of the island's polygons
+    float area = 0.0;
+    std::vector<dtPolyRef> polys;
+  };
+
+  const dtNavMesh* navMesh_;
+  const dtQueryFilter* filter_;
+  //! Island of every polygon, indexed by tile and then polygon index
+  std::vector<std::vector<uint32_t>> tileIslands_;
+  //! Salt of the tile the islands in tileIslands_ were computed for, refs
+  //! with any other salt belong to removed tiles
+  std::vector<unsigned int> tileSalts_;
+  std::vector<Island> islands_;
+  //! Ids of islands that were removed and can be reused
+  std::vector<uint32_t> freeIslandIds_;
+  std::vector<vec3f> islandVerts_;
+
+  inline uint32_t islandOf(dtPolyRef ref) const {
+    unsigned int salt, iTile, iPoly;
+    navMesh_->decodePolyId(ref, salt, iTile, iPoly);
+    if (iTile >= tileIslands_.size() || tileSalts_[iTile] != salt)
+      return NO_ISLAND;
+    const std::vector<uint32_t>& polyIslands = tileIslands_[iTile];
+    return iPoly < polyIslands.size() ? polyIslands[iPoly] : NO_ISLAND;
+  }
+
+  inline void setIsland(dtPolyRef ref, uint32_t islandId) {
+    unsigned int salt, iTile, iPoly;
+    navMesh_->decodePolyId(ref, salt, iTile, iPoly);
+    tileIslands_[iTile][iPoly] = islandId;
+  }
+
+  void initTile(const dtMeshTile* tile) {
+    const unsigned int iTile = navMesh_->decodePolyIdTile(
+        navMesh_->getPolyRefBase(tile));
+    tileIslands_[iTile].assign(tile->header->polyCount, NO_ISLAND);
+    tileSalts_[iTile] = tile->salt;
+  }
+
+  void addTileIslands(const dtMeshTile* tile) {
+    const dtPolyRef base = navMesh_->getPolyRefBase(tile);
+
+    // Iterate over all polygons in a tile
+    for (int jPoly = 0; jPoly < tile->header->polyCount; ++jPoly) {
+      // Get the polygon reference from the tile and polygon id
+      dtPolyRef startRef = base | jPoly;
+
+      // If we haven't seen the polygon yet, start connected component
+      // analysis from it
+      if (islandOf(startRef) == NO_ISLAND) {
+        addIsland(startRef);
+      }
+    }
+  }
+
+  void addIsland(const dtPolyRef& startRef) {
+    uint32_t newIslandId;
+    if (freeIslandIds_.empty()) {
+      newIslandId = islands_.size();
+      islands_.emplace_back();
+    } else {
+      newIslandId = freeIslandIds_.back();
+      freeIslandIds_.pop_back();
+    }
+    expandFrom(newIslandId, startRef);
+    Island& island = islands_[newIslandId];
+
+    // The radius is calculated as the max deviation from the mean for all
+    // points in the island
+    vec3f centroid = vec3f::Zero();
+    for (auto& v : islandVerts_) {
+      centroid += v;
+    }
+    centroid /= islandVerts_.size();
+
+    float maxRadius = 0.0;
+    for (auto& v : islandVerts_) {
+      maxRadius = std::max(maxRadius, (v - centroid).norm());
+    }
 
-  void expandFrom(const dtNavMesh* navMesh,
-                  const dtQueryFilter* filter,
-                  const uint32_t newIslandId,
-                  const dtPolyRef& startRef,
-                  std::vector<vec3f>& islandVerts) {
-    polyToIsland_.emplace(startRef, newIslandId);
-    islandVerts.clear();
+    island.radius = maxRadius;
+  }
+
+  void expandFrom(const uint32_t newIslandId, const dtPolyRef& startRef) {
+    Island& island = islands_[newIslandId];
+    setIsland(startRef, newIslandId);
+    island.polys.push_back(startRef);
+    islandVerts_.clear();
 
     // Force std::stack to be implemented via an std::vector as linked
     // lists are gross
@@ -137,43 +381,176 @@ class IslandSystem {
 
       const dtMeshTile* tile = 0;
       const dtPoly* poly = 0;
-      navMesh->getTileAndPolyByRefUnsafe(ref, &tile, &poly);
+      navMesh_->getTileAndPolyByRefUnsafe(ref, &tile, &poly);
 
+      const int firstVert = islandVerts_.size();
       for (int iVert = 0; iVert < poly->vertCount; ++iVert) {
-        islandVerts.emplace_back(
+        islandVerts_.emplace_back(
             Eigen::Map<vec3f>(&tile->verts[poly->verts[iVert] * 3]));
       }
+      // Polygons are convex, so a triangle fan covers them
+      const vec3f& v0 = islandVerts_[firstVert];
+      for (int iVert = firstVert + 2; iVert < islandVerts_.size(); ++iVert) {
+        const vec3f e1 = islandVerts_[iVert - 1] - v0;
+        const vec3f e2 = islandVerts_[iVert] - v0;
+        island.area += 0.5f * e1.cross(e2).norm();
+      }
 
       // Iterate over all neighbours
       for (unsigned int iLink = poly->firstLink; iLink != DT_NULL_LINK;
            iLink = tile->links[iLink].next) {
         dtPolyRef neighbourRef = tile->links[iLink].ref;
         // If we've already visited this poly, skip it!
-        if (polyToIsland_.find(neighbourRef) != polyToIsland_.end())
+        if (islandOf(neighbourRef) != NO_ISLAND)
           continue;
 
         const dtMeshTile* neighbourTile = 0;
         const dtPoly* neighbourPoly = 0;
-        navMesh->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile,
-                                           &neighbourPoly);
+        navMesh_->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile,
+                                            &neighbourPoly);
 
         // If a neighbour isn't walkable, don't add it
-        if (!filter->passFilter(neighbourRef, neighbourTile, neighbourPoly))
+        if (!filter_->passFilter(neighbourRef, neighbourTile, neighbourPoly))
           continue;
 
-        polyToIsland_.emplace(neighbourRef, newIslandId);
+        setIsland(neighbourRef, newIslandId);
+        island.polys.push_back(neighbourRef);
         stack.push(neighbourRef);
       }
     }
   }
 };
+
+// Hands out dtNavMeshQuery objects so that one PathFinder can serve queries
+// from many threads at once.  A dtNavMeshQuery keeps its search state in its
+// node pools, so two threads can never use the same one at the same time.
+//
+// Slots are claimed with an atomic flag, so acquiring a query never takes a
+// lock.  Each thread remembers the slot it used last and tries that one
+// first, which means a thread generally keeps using the same query object and
+// the same random stream.  If every slot is busy, a temporary query is
+// allocated for the duration of the lease.
+class NavQueryPool {
+ public:
+  struct Slot {
+    std::atomic<bool> busy{false};
+    dtNavMeshQuery* navQuery = nullptr;
+    core::Random random{0};
+  };
+
+  class Lease {
+   public:
+    Lease(Slot* slot, dtNavMeshQuery* navQuery, core::Random* random)
+        : slot_{slot}, navQuery_{navQuery}, random_{random} {}
+    Lease(Lease&& other)
+        : slot_{other.slot_},
+          navQuery_{other.navQuery_},
+          random_{other.random_} {
+      other.slot_ = nullptr;
+      other.navQuery_ = nullptr;
+      other.random_ = nullptr;
+    }
+    Lease(const Lease&) = delete;
+    Lease& operator=(const Lease&) = delete;
+    ~Lease() {
+      if (slot_) {
+        slot_->busy.store(false, std::memory_order_release);
+      } else {
+        // Overflow query, we own it
+        dtFreeNavMeshQuery(navQuery_);
+        delete random_;
+      }
+    }
+
+    dtNavMeshQuery* navQuery() const { return navQuery_; }
+    core::Random& random() const { return *random_; }
+
+   private:
+    Slot* slot_;
+    dtNavMeshQuery* navQuery_;
+    core::Random* random_;
+  };
+
+  NavQueryPool(const dtNavMesh* navMesh,
+               const int maxNodes,
+               const uint32_t seed)
+      : navMesh_{navMesh},
+        maxNodes_{maxNodes},
+        numSlots_{std::max(
+            16, 2 * static_cast<int>(std::thread::hardware_concurrency()))},
+        slots_{new Slot[numSlots_]} {
+    this->seed(seed);
+  }
+
+  ~NavQueryPool() {
+    for (int i = 0; i < numSlots_; ++i) {
+      dtFreeNavMeshQuery(slots_[i].navQuery);
+    }
+  }
+
+  Lease acquire() {
+    static thread_local int lastSlot = 0;
+
+    for (int i = 0; i < numSlots_; ++i) {
+      const int iSlot = (lastSlot + i) % numSlots_;
+      Slot& slot = slots_[iSlot];
+      if (slot.busy.exchange(true, std::memory_order_acquire))
+        continue;
+
+      // Slot queries are created lazily so that single-threaded users only
+      // ever pay for one
+      if (!slot.navQuery)
+        slot.navQuery = createQuery();
+
+      lastSlot = iSlot;
+      return Lease(&slot, slot.navQuery, &slot.random);
+    }
+
+    return Lease(nullptr, createQuery(),
+                 new core::Random(streamSeed(numSlots_ + overflowCount_++)));
+  }
+
+  // Reseeds the random stream of every slot.  Each slot gets an independent
+  // stream derived from the seed and its index
+  void seed(uint32_t newSeed) {
+    seed_ = newSeed;
+    overflowCount_ = 0;
+    for (int i = 0; i < numSlots_; ++i) {
+      slots_[i].random.seed(streamSeed(i));
+    }
+  }
+
+ private:
+  const dtNavMesh* navMesh_;
+  const int maxNodes_;
+  const int numSlots_;
+  std::unique_ptr<Slot[]> slots_;
+  uint32_t seed_ = 0;
+  std::atomic<uint32_t> overflowCount_{0};
+
+  dtNavMeshQuery* createQuery() const {
+    dtNavMeshQuery* navQuery = dtAllocNavMeshQuery();
+    if (!navQuery || dtStatusFailed(navQuery->init(navMesh_, maxNodes_))) {
+      LOG(ERROR) << "Could not init Detour navmesh query";
+      dtFreeNavMeshQuery(navQuery);
+      return nullptr;
+    }
+    return navQuery;
+  }
+
+  uint32_t streamSeed(uint32_t stream) const {
+    std::seed_seq seq{seed_, stream};
+    uint32_t streamSeed;
+    seq.generate(&streamSeed, &streamSeed + 1);
+    return streamSeed;
+  }
+};
 }  // namespace impl
 }  // namespace nav
 }  // namespace esp
 
 struct Workspace {
   rcHeightfield* solid = 0;
-  unsigned char* triareas = 0;
   rcCompactHeightfield* chf = 0;
   rcContourSet* cset = 0;
   rcPolyMesh* pmesh = 0;
@@ -181,7 +558,6 @@ struct Workspace {
 
   ~Workspace() {
     rcFreeHeightField(solid);
-    delete[] triareas;
     rcFreeCompactHeightfield(chf);
     rcFreeContourSet(cset);
     rcFreePolyMesh(pmesh);
@@ -198,72 +574,324 @@ enum PolyFlags {
   POLYFLAGS_ALL = 0xffff      // all abilities
 };
 
-esp::nav::PathFinder::PathFinder() : navMesh_(0), navQuery_(0), filter_(0) {
-  filter_ = new dtQueryFilter();
-  filter_->setIncludeFlags(POLYFLAGS_WALK);
-  filter_->setExcludeFlags(0);
-}
+namespace esp {
+namespace nav {
+namespace impl {
 
-void esp::nav::PathFinder::free() {
-  if (navMesh_) {
-    dtFreeNavMesh(navMesh_);
-    navMesh_ = 0;
+// A navmesh and its islands.  Navmeshes loaded from a file are never modified
+// afterwards, so the NavMeshCache shares them between all PathFinders that
+// load the same file, each with its own query objects.  Built navmeshes
+// belong to the PathFinder that built them, which may rebuild their tiles
+struct NavMeshData {
+  explicit NavMeshData(dtNavMesh* navMesh,
+                       void* mappedFile = nullptr,
+                       size_t mappedFileSize = 0)
+      : navMesh{navMesh},
+        mappedFile{mappedFile},
+        mappedFileSize{mappedFileSize} {
+    filter.setIncludeFlags(POLYFLAGS_WALK);
+    filter.setExcludeFlags(0);
+  }
+
+  ~NavMeshData() {
+    delete islandSystem;
+    dtFreeNavMesh(navMesh);
+    if (mappedFile)
+      munmap(mappedFile, mappedFileSize);
   }
-  if (navQuery_) {
-    dtFreeNavMeshQuery(navQuery_);
-    navQuery_ = 0;
+
+  //! Bytes of the tiles and islands, approximately
+  size_t bytes() const {
+    size_t bytes = 0;
+    const dtNavMesh* mesh = navMesh;
+    for (int i = 0; i < mesh->getMaxTiles(); ++i) {
+      const dtMeshTile* tile = mesh->getTile(i);
+      if (!tile || !tile->header)
+        continue;
+      // Every polygon is listed in its island and has its island id stored
+      bytes += tile->dataSize +
+               tile->header->polyCount * (sizeof(dtPolyRef) + sizeof(uint32_t));
+    }
+    return bytes;
   }
-  if (filter_) {
-    delete filter_;
+
+  dtNavMesh* const navMesh;
+  //! Same as PathFinder's, the islands are computed with it
+  dtQueryFilter filter;
+  IslandSystem* islandSystem = nullptr;
+  //! Version 2 navmesh file the tiles of navMesh live in, if any
+  void* const mappedFile;
+  const size_t mappedFileSize;
+};
+
+// Process-wide cache of the navmeshes loaded from files, so that the many
+// PathFinders of environments that load the same scene share one copy.
+//
+// Every loaded navmesh that some PathFinder still uses is found by later
+// loads of the same file.  The most recently used navmeshes also stay loaded
+// after their last PathFinder is gone, as long as they fit into the capacity,
+// so switching back and forth between scenes doesn't reload them.
+class NavMeshCache {
+ public:
+  static NavMeshCache& instance() {
+    static NavMeshCache cache;
+    return cache;
+  }
+
+  //! Returns the navmesh loaded for key, null if there is none
+  std::shared_ptr<NavMeshData> find(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = loaded_.find(key);
+    if (it == loaded_.end())
+      return nullptr;
+    std::shared_ptr<NavMeshData> navMeshData = it->second.lock();
+    if (!navMeshData) {
+      loaded_.erase(it);
+      return nullptr;
+    }
+    touch(key, navMeshData);
+    return navMeshData;
+  }
+
+  //! Adds navMeshData for key and returns it, or the navmesh another thread
+  //! loaded for key in the meantime
+  std::shared_ptr<NavMeshData> insert(
+      const std::string& key,
+      std::shared_ptr<NavMeshData> navMeshData) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::weak_ptr<NavMeshData>& loaded = loaded_[key];
+    if (auto other = loaded.lock())
+      navMeshData = other;
+    loaded = navMeshData;
+    touch(key, navMeshData);
+
+    // Forget about navmeshes that are gone
+    for (auto it = loaded_.begin(); it != loaded_.end();) {
+      if (it->second.expired())
+        it = loaded_.erase(it);
+      else
+        ++it;
+    }
+    return navMeshData;
   }
 
-  if (islandSystem_) {
-    delete islandSystem_;
+  void setCapacity(size_t capacity) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    capacity_ = capacity;
+    evict();
   }
+
+  size_t capacity() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return capacity_;
+  }
+
+  size_t size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return size_;
+  }
+
+ private:
+  // Moves key to the front of recent_
+  void touch(const std::string& key,
+             const std::shared_ptr<NavMeshData>& navMeshData) {
+    auto it = std::find_if(recent_.begin(), recent_.end(),
+                           [&key](const RecentEntry& entry) {
+                             return entry.key == key;
+                           });
+    if (it != recent_.end()) {
+      recent_.splice(recent_.begin(), recent_, it);
+      return;
+    }
+    const size_t bytes = navMeshData->bytes();
+    recent_.push_front({key, navMeshData, bytes});
+    size_ += bytes;
+    evict();
+  }
+
+  void evict() {
+    while (size_ > capacity_ && !recent_.empty()) {
+      size_ -= recent_.back().bytes;
+      recent_.pop_back();
+    }
+  }
+
+  struct RecentEntry {
+    std::string key;
+    std::shared_ptr<NavMeshData> navMeshData;
+    size_t bytes;
+  };
+
+  std::mutex mutex_;
+  //! Every navmesh loaded by key that is still alive
+  std::unordered_map<std::string, std::weak_ptr<NavMeshData>> loaded_;
+  //! Most recently used first, kept alive up to capacity_ bytes
+  std::list<RecentEntry> recent_;
+  size_t size_ = 0;
+  size_t capacity_ = size_t(512) << 20;
+};
+
+}  // namespace impl
+}  // namespace nav
+}  // namespace esp
+
+namespace {
+// Bytes Recast has allocated on this thread and their peak since the innermost
+// running stage of a BuildStatsContext started.  A build allocates and frees
+// its Recast memory on the same thread
+thread_local int64_t recastBytes = 0;
+thread_local int64_t recastPeakBytes = 0;
+
+// Every Recast allocation is prefixed with its size and a tag, which keeps
+// the alignment of malloc
+struct RecastAllocHeader {
+  size_t size;
+  uint64_t tag;
+};
+static_assert(sizeof(RecastAllocHeader) == 16,
+              "RecastAllocHeader has to keep the alignment of malloc");
+const uint64_t RECAST_ALLOC_TAG = 0x7261636b52435354ull;
+
+void* trackedRecastAlloc(size_t size, rcAllocHint /*hint*/) {
+  auto* header = static_cast<RecastAllocHeader*>(
+      std::malloc(size + sizeof(RecastAllocHeader)));
+  if (!header)
+    return nullptr;
+  header->size = size;
+  header->tag = RECAST_ALLOC_TAG;
+  recastBytes += size;
+  recastPeakBytes = std::max(recastPeakBytes, recastBytes);
+  return header + 1;
 }
 
-bool esp::nav::PathFinder::build(const NavMeshSettings& bs,
-                                 const float* verts,
-                                 const int nverts,
-                                 const int* tris,
-                                 const int ntris,
-                                 const float* bmin,
-                                 const float* bmax) {
-  Workspace ws;
-  rcContext ctx;
+void trackedRecastFree(void* ptr) {
+  if (!ptr)
+    return;
+  auto* header = static_cast<RecastAllocHeader*>(ptr) - 1;
+  if (header->tag != RECAST_ALLOC_TAG) {
+    // Allocated before the tracking allocator was installed, by Recast's
+    // default one
+    std::free(ptr);
+    return;
+  }
+  header->tag = 0;
+  recastBytes -= header->size;
+  std::free(header);
+}
 
-  //
-  // Step 1. Initialize build config.
-  //
+// Installs the tracking allocator before the first build rather than during
+// static initialization, blocks Recast allocated before that are freed as
+// they were allocated
+void installTrackedRecastAlloc() {
+  static std::once_flag installed;
+  std::call_once(installed, [] {
+    rcAllocSetCustom(trackedRecastAlloc, trackedRecastFree);
+  });
+}
 
-  // Init build configuration from GUI
-  rcConfig cfg;
-  memset(&cfg, 0, sizeof(cfg));
-  cfg.cs = bs.cellSize;
-  cfg.ch = bs.cellHeight;
-  cfg.walkableSlopeAngle = bs.agentMaxSlope;
-  cfg.walkableHeight = (int)ceilf(bs.agentHeight / cfg.ch);
-  cfg.walkableClimb = (int)floorf(bs.agentMaxClimb / cfg.ch);
-  cfg.walkableRadius = (int)ceilf(bs.agentRadius / cfg.cs);
-  cfg.maxEdgeLen = (int)(bs.edgeMaxLen / bs.cellSize);
-  cfg.maxSimplificationError = bs.edgeMaxError;
-  cfg.minRegionArea = (int)rcSqr(bs.regionMinSize);  // Note: area = size*size
-  cfg.mergeRegionArea =
-      (int)rcSqr(bs.regionMergeSize);  // Note: area = size*size
-  cfg.maxVertsPerPoly = (int)bs.vertsPerPoly;
-  cfg.detailSampleDist =
-      bs.detailSampleDist < 0.9f ? 0 : bs.cellSize * bs.detailSampleDist;
-  cfg.detailSampleMaxError = bs.cellHeight * bs.detailSampleMaxError;
+// The stages of the Recast pipeline reported in NavMeshBuildStats, in the
+// order they run.  RC_TIMER_TEMP times the creation of the Detour data
+const std::pair<rcTimerLabel, const char*> BUILD_STAGES[] = {
+    {RC_TIMER_RASTERIZE_TRIANGLES, "rasterize triangles"},
+    {RC_TIMER_FILTER_LOW_OBSTACLES, "filter low obstacles"},
+    {RC_TIMER_FILTER_BORDER, "filter ledge spans"},
+    {RC_TIMER_FILTER_WALKABLE, "filter low height spans"},
+    {RC_TIMER_BUILD_COMPACTHEIGHTFIELD, "compact heightfield"},
+    {RC_TIMER_ERODE_AREA, "erode walkable area"},
+    {RC_TIMER_BUILD_DISTANCEFIELD, "distance field"},
+    {RC_TIMER_BUILD_REGIONS, "regions"},
+    {RC_TIMER_BUILD_CONTOURS, "contours"},
+    {RC_TIMER_BUILD_POLYMESH, "polygon mesh"},
+    {RC_TIMER_BUILD_POLYMESHDETAIL, "detail mesh"},
+    {RC_TIMER_TEMP, "Detour data"},
+};
 
-  // Set the area where the navigation will be build.
-  // Here the bounds of the input mesh are used, but the
-  // area could be specified by an user defined box, etc.
-  rcVcopy(cfg.bmin, bmin);
-  rcVcopy(cfg.bmax, bmax);
-  rcCalcGridSize(cfg.bmin, cfg.bmax, cfg.cs, &cfg.width, &cfg.height);
-  LOG(INFO) << "Building navmesh with " << cfg.width << "x" << cfg.height
-            << " cells";
+// Records the wall time and peak Recast allocation of every stage, and
+// forwards Recast's warnings and errors to the log
+class BuildStatsContext : public rcContext {
+ public:
+  BuildStatsContext() : rcContext(true) {
+    installTrackedRecastAlloc();
+    doResetTimers();
+  }
+
+  // Adds the stages of a context that built other tiles
+  void merge(const BuildStatsContext& other) {
+    for (int i = 0; i < RC_MAX_TIMERS; ++i) {
+      seconds_[i] += other.seconds_[i];
+      peakBytes_[i] = std::max(peakBytes_[i], other.peakBytes_[i]);
+    }
+    numTiles_ += other.numTiles_;
+  }
+
+  void addTile() { ++numTiles_; }
 
+  esp::nav::NavMeshBuildStats stats(double totalSeconds) const {
+    esp::nav::NavMeshBuildStats stats;
+    for (const auto& stage : BUILD_STAGES) {
+      const size_t peakBytes =
+          std::max<int64_t>(peakBytes_[stage.first], 0);
+      stats.stages.push_back({stage.second, seconds_[stage.first], peakBytes});
+      stats.peakBytes = std::max(stats.peakBytes, peakBytes);
+    }
+    stats.totalSeconds = totalSeconds;
+    stats.numTiles = numTiles_;
+    return stats;
+  }
+
+ protected:
+  void doLog(const rcLogCategory category,
+             const char* msg,
+             const int len) override {
+    if (category == RC_LOG_ERROR)
+      LOG(ERROR) << "Recast: " << std::string(msg, len);
+    else if (category == RC_LOG_WARNING)
+      LOG(WARNING) << "Recast: " << std::string(msg, len);
+  }
+
+  void doResetTimers() override {
+    seconds_.fill(0);
+    peakBytes_.fill(0);
+  }
+
+  // Stages nest, e.g. contours run their trace and simplify stages, so every
+  // stage restores the peak of its parent when it stops
+  void doStartTimer(const rcTimerLabel label) override {
+    start_[label] = std::chrono::steady_clock::now();
+    parentPeakBytes_[label] = recastPeakBytes;
+    recastPeakBytes = recastBytes;
+  }
+
+  void doStopTimer(const rcTimerLabel label) override {
+    seconds_[label] += std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start_[label])
+                           .count();
+    peakBytes_[label] = std::max(peakBytes_[label], recastPeakBytes);
+    recastPeakBytes = std::max(parentPeakBytes_[label], recastPeakBytes);
+  }
+
+  //! In microseconds, like Recast's own contexts
+  int doGetAccumulatedTime(const rcTimerLabel label) const override {
+    return static_cast<int>(seconds_[label] * 1e6);
+  }
+
+ private:
+  std::array<std::chrono::steady_clock::time_point, RC_MAX_TIMERS> start_;
+  std::array<double, RC_MAX_TIMERS> seconds_;
+  std::array<int64_t, RC_MAX_TIMERS> peakBytes_;
+  std::array<int64_t, RC_MAX_TIMERS> parentPeakBytes_;
+  int numTiles_ = 0;
+};
+
+// Rasterizes the input polygon soup over the area of cfg into ws.solid
+bool rasterizeTriangles(rcContext& ctx,
+                        const rcConfig& cfg,
+                        const float* verts,
+                        const int nverts,
+                        const int* tris,
+                        const unsigned char* triareas,
+                        const int ntris,
+                        Workspace& ws) {
   //
   // Step 2. Rasterize input polygon soup.
   //
@@ -280,27 +908,21 @@ bool esp::nav::PathFinder::build(const NavMeshSettings& bs,
     return false;
   }
 
-  // Allocate array that can hold triangle area types.
-  // If you have multiple meshes you need to process, allocate
-  // and array which can hold the max number of triangles you need to process.
-  ws.triareas = new unsigned char[ntris];
-  if (!ws.triareas) {
-    LOG(ERROR) << "Out of memory for triareas" << ntris;
-    return false;
-  }
-
-  // Find triangles which are walkable based on their slope and rasterize them.
-  // If your input data is multiple meshes, you can transform them here,
-  // calculate the are type for each of the meshes and rasterize them.
-  memset(ws.triareas, 0, ntris * sizeof(unsigned char));
-  rcMarkWalkableTriangles(&ctx, cfg.walkableSlopeAngle, verts, nverts, tris,
-                          ntris, ws.triareas);
-  if (!rcRasterizeTriangles(&ctx, verts, nverts, tris, ws.triareas, ntris,
+  if (!rcRasterizeTriangles(&ctx, verts, nverts, tris, triareas, ntris,
                             *ws.solid, cfg.walkableClimb)) {
     LOG(ERROR) << "Could not rasterize triangles.";
     return false;
   }
+  return true;
+}
 
+// Filters the spans of solid the agent of cfg can't stand on and compacts the
+// rest into ws.chf.  The filters only ever change the area of spans
+bool buildCompactHeightfield(rcContext& ctx,
+                             const rcConfig& cfg,
+                             const esp::nav::NavMeshSettings& bs,
+                             rcHeightfield& solid,
+                             Workspace& ws) {
   //
   // Step 3. Filter walkables surfaces.
   //
@@ -309,11 +931,11 @@ bool esp::nav::PathFinder::build(const NavMeshSettings& bs,
   // remove unwanted overhangs caused by the conservative rasterization
   // as well as filter spans where the character cannot possibly stand.
   if (bs.filterLowHangingObstacles)
-    rcFilterLowHangingWalkableObstacles(&ctx, cfg.walkableClimb, *ws.solid);
+    rcFilterLowHangingWalkableObstacles(&ctx, cfg.walkableClimb, solid);
   if (bs.filterLedgeSpans)
-    rcFilterLedgeSpans(&ctx, cfg.walkableHeight, cfg.walkableClimb, *ws.solid);
+    rcFilterLedgeSpans(&ctx, cfg.walkableHeight, cfg.walkableClimb, solid);
   if (bs.filterWalkableLowHeightSpans)
-    rcFilterWalkableLowHeightSpans(&ctx, cfg.walkableHeight, *ws.solid);
+    rcFilterWalkableLowHeightSpans(&ctx, cfg.walkableHeight, solid);
 
   //
   // Step 4. Partition walkable surface to simple regions.
@@ -328,10 +950,26 @@ bool esp::nav::PathFinder::build(const NavMeshSettings& bs,
     return false;
   }
   if (!rcBuildCompactHeightfield(&ctx, cfg.walkableHeight, cfg.walkableClimb,
-                                 *ws.solid, *ws.chf)) {
+                                 solid, *ws.chf)) {
     LOG(ERROR) << "Could not build compact heightfield";
     return false;
   }
+  return true;
+}
+
+// Runs the rest of the Recast pipeline on ws.chf and creates the Detour data
+// of the resulting tile.  navData is left null if the area has nothing
+// walkable.
+bool buildTileDataFromCompactHeightfield(rcContext& ctx,
+                                         const rcConfig& cfg,
+                                         const esp::nav::NavMeshSettings& bs,
+                                         Workspace& ws,
+                                         const int tileX,
+                                         const int tileY,
+                                         unsigned char** navData,
+                                         int* navDataSize) {
+  *navData = 0;
+  *navDataSize = 0;
 
   // Erode the walkable area by agent radius.
   if (!rcErodeWalkableArea(&ctx, cfg.walkableRadius, *ws.chf)) {
@@ -386,7 +1024,7 @@ bool esp::nav::PathFinder::build(const NavMeshSettings& bs,
     return false;
   }
   // Partition the walkable surface into simple regions without holes.
-  if (!rcBuildRegions(&ctx, *ws.chf, 0, cfg.minRegionArea,
+  if (!rcBuildRegions(&ctx, *ws.chf, cfg.borderSize, cfg.minRegionArea,
                       cfg.mergeRegionArea)) {
     LOG(ERROR) << "Could not build watershed regions";
     return false;
@@ -449,111 +1087,847 @@ bool esp::nav::PathFinder::build(const NavMeshSettings& bs,
   // At this point the navigation mesh data is ready, you can access it from
   // ws.pmesh. See duDebugDrawPolyMesh or dtCreateNavMeshData as examples how to
   // access the data.
+  if (ws.pmesh->nverts == 0) {
+    return true;
+  }
 
   //
-  // (Optional) Step 8. Create Detour data from Recast poly mesh.
+  // Step 8. Create Detour data from Recast poly mesh.
   //
 
-  // The GUI may allow more max points per polygon than Detour can handle.
-  // Only build the detour navmesh if we do not exceed the limit.
-  if (cfg.maxVertsPerPoly <= DT_VERTS_PER_POLYGON) {
-    unsigned char* navData = 0;
-    int navDataSize = 0;
-
-    // Update poly flags from areas.
-    for (int i = 0; i < ws.pmesh->npolys; ++i) {
-      if (ws.pmesh->areas[i] == RC_WALKABLE_AREA) {
-        ws.pmesh->areas[i] = POLYAREA_GROUND;
-      }
-      if (ws.pmesh->areas[i] == POLYAREA_GROUND) {
-        ws.pmesh->flags[i] = POLYFLAGS_WALK;
-      } else if (ws.pmesh->areas[i] == POLYAREA_DOOR) {
-        ws.pmesh->flags[i] = POLYFLAGS_WALK | POLYFLAGS_DOOR;
-      }
-    }
-
-    dtNavMeshCreateParams params;
-    memset(&params, 0, sizeof(params));
-    params.verts = ws.pmesh->verts;
-    params.vertCount = ws.pmesh->nverts;
-    params.polys = ws.pmesh->polys;
-    params.polyAreas = ws.pmesh->areas;
-    params.polyFlags = ws.pmesh->flags;
-    params.polyCount = ws.pmesh->npolys;
-    params.nvp = ws.pmesh->nvp;
-    params.detailMeshes = ws.dmesh->meshes;
-    params.detailVerts = ws.dmesh->verts;
-    params.detailVertsCount = ws.dmesh->nverts;
-    params.detailTris = ws.dmesh->tris;
-    params.detailTriCount = ws.dmesh->ntris;
-    // params.offMeshConVerts = geom->getOffMeshConnectionVerts();
-    // params.offMeshConRad = geom->getOffMeshConnectionRads();
-    // params.offMeshConDir = geom->getOffMeshConnectionDirs();
-    // params.offMeshConAreas = geom->getOffMeshConnectionAreas();
-    // params.offMeshConFlags = geom->getOffMeshConnectionFlags();
-    // params.offMeshConUserID = geom->getOffMeshConnectionId();
-    // params.offMeshConCount = geom->getOffMeshConnectionCount();
-    params.walkableHeight = bs.agentHeight;
-    params.walkableRadius = bs.agentRadius;
-    params.walkableClimb = bs.agentMaxClimb;
-    rcVcopy(params.bmin, ws.pmesh->bmin);
-    rcVcopy(params.bmax, ws.pmesh->bmax);
-    params.cs = cfg.cs;
-    params.ch = cfg.ch;
-    params.buildBvTree = true;
-
-    if (!dtCreateNavMeshData(&params, &navData, &navDataSize)) {
-      LOG(ERROR) << "Could not build Detour navmesh";
-      return false;
-    }
-
-    navMesh_ = 0;
-    navMesh_ = dtAllocNavMesh();
-    if (!navMesh_) {
-      dtFree(navData);
-      LOG(ERROR) << "Could not allocate Detour navmesh";
-      return false;
-    }
-
-    dtStatus status;
-    status = navMesh_->init(navData, navDataSize, DT_TILE_FREE_DATA);
-    if (dtStatusFailed(status)) {
-      dtFree(navData);
-      LOG(ERROR) << "Could not init Detour navmesh";
-      return false;
+  // Update poly flags from areas.
+  for (int i = 0; i < ws.pmesh->npolys; ++i) {
+    if (ws.pmesh->areas[i] == RC_WALKABLE_AREA) {
+      ws.pmesh->areas[i] = POLYAREA_GROUND;
     }
-    if (!initNavQuery()) {
-      return false;
+    if (ws.pmesh->areas[i] == POLYAREA_GROUND) {
+      ws.pmesh->flags[i] = POLYFLAGS_WALK;
+    } else if (ws.pmesh->areas[i] == POLYAREA_DOOR) {
+      ws.pmesh->flags[i] = POLYFLAGS_WALK | POLYFLAGS_DOOR;
     }
   }
 
-  LOG(INFO) << "Created navmesh with " << ws.pmesh->nverts << " vertices "
-            << ws.pmesh->npolys << " polygons";
+  dtNavMeshCreateParams params;
+  memset(&params, 0, sizeof(params));
+  params.verts = ws.pmesh->verts;
+  params.vertCount = ws.pmesh->nverts;
+  params.polys = ws.pmesh->polys;
+  params.polyAreas = ws.pmesh->areas;
+  params.polyFlags = ws.pmesh->flags;
+  params.polyCount = ws.pmesh->npolys;
+  params.nvp = ws.pmesh->nvp;
+  params.detailMeshes = ws.dmesh->meshes;
+  params.detailVerts = ws.dmesh->verts;
+  params.detailVertsCount = ws.dmesh->nverts;
+  params.detailTris = ws.dmesh->tris;
+  params.detailTriCount = ws.dmesh->ntris;
+  // params.offMeshConVerts = geom->getOffMeshConnectionVerts();
+  // params.offMeshConRad = geom->getOffMeshConnectionRads();
+  // params.offMeshConDir = geom->getOffMeshConnectionDirs();
+  // params.offMeshConAreas = geom->getOffMeshConnectionAreas();
+  // params.offMeshConFlags = geom->getOffMeshConnectionFlags();
+  // params.offMeshConUserID = geom->getOffMeshConnectionId();
+  // params.offMeshConCount = geom->getOffMeshConnectionCount();
+  params.walkableHeight = bs.agentHeight;
+  params.walkableRadius = bs.agentRadius;
+  params.walkableClimb = bs.agentMaxClimb;
+  params.tileX = tileX;
+  params.tileY = tileY;
+  rcVcopy(params.bmin, ws.pmesh->bmin);
+  rcVcopy(params.bmax, ws.pmesh->bmax);
+  params.cs = cfg.cs;
+  params.ch = cfg.ch;
+  params.buildBvTree = true;
+
+  rcScopedTimer timer(&ctx, RC_TIMER_TEMP);
+  if (!dtCreateNavMeshData(&params, navData, navDataSize)) {
+    LOG(ERROR) << "Could not build Detour navmesh";
+    return false;
+  }
 
   return true;
 }
 
-bool esp::nav::PathFinder::initNavQuery() {
-  navQuery_ = dtAllocNavMeshQuery();
-  dtStatus status = navQuery_->init(navMesh_, 2048);
-  if (dtStatusFailed(status)) {
-    LOG(ERROR) << "Could not init Detour navmesh query";
-    return false;
+// Areas of all spans of hf, to undo the filters of buildCompactHeightfield
+// when the heightfield is filtered for another agent
+std::vector<unsigned char> getSpanAreas(const rcHeightfield& hf) {
+  std::vector<unsigned char> areas;
+  for (int i = 0; i < hf.width * hf.height; ++i) {
+    for (const rcSpan* s = hf.spans[i]; s; s = s->next)
+      areas.push_back(s->area);
   }
+  return areas;
+}
 
-  islandSystem_ = new impl::IslandSystem(navMesh_, filter_);
+void setSpanAreas(const std::vector<unsigned char>& areas, rcHeightfield& hf) {
+  auto area = areas.begin();
+  for (int i = 0; i < hf.width * hf.height; ++i) {
+    for (rcSpan* s = hf.spans[i]; s; s = s->next)
+      s->area = *area++;
+  }
+}
 
+// Copies the part of src that cfg covers into dst, which is what rasterizing
+// the same triangles over the area of cfg gives.  cfg has to be centered in
+// src and may only differ from it in its border
+bool cropHeightfield(rcContext& ctx,
+                     const rcHeightfield& src,
+                     const rcConfig& cfg,
+                     rcHeightfield& dst) {
+  if (!rcCreateHeightfield(&ctx, dst, cfg.width, cfg.height, cfg.bmin,
+                           cfg.bmax, cfg.cs, cfg.ch)) {
+    LOG(ERROR) << "Could not create solid heightfield";
+    return false;
+  }
+  const int offset = (src.width - cfg.width) / 2;
+  for (int y = 0; y < cfg.height; ++y) {
+    for (int x = 0; x < cfg.width; ++x) {
+      // Rasterization merges touching spans, so adding them again in order
+      // doesn't merge anything
+      for (const rcSpan* s = src.spans[x + offset + (y + offset) * src.width];
+           s; s = s->next) {
+        if (!rcAddSpan(&ctx, dst, x, y, s->smin, s->smax, s->area, 0))
+          return false;
+      }
+    }
+  }
   return true;
 }
 
-bool esp::nav::PathFinder::build(const NavMeshSettings& bs,
-                                 const esp::assets::MeshData& mesh) {
-  const int numVerts = mesh.vbo.size();
-  const int numIndices = mesh.ibo.size();
-  const float mf = std::numeric_limits<float>::max();
-  vec3f bmin(mf, mf, mf);
-  vec3f bmax(-mf, -mf, -mf);
-
+rcConfig makeConfig(const esp::nav::NavMeshSettings& bs,
+                    const float* bmin,
+                    const float* bmax) {
+  //
+  // Step 1. Initialize build config.
+  //
+
+  // Init build configuration from GUI
+  rcConfig cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.cs = bs.cellSize;
+  cfg.ch = bs.cellHeight;
+  cfg.walkableSlopeAngle = bs.agentMaxSlope;
+  cfg.walkableHeight = (int)ceilf(bs.agentHeight / cfg.ch);
+  cfg.walkableClimb = (int)floorf(bs.agentMaxClimb / cfg.ch);
+  cfg.walkableRadius = (int)ceilf(bs.agentRadius / cfg.cs);
+  cfg.maxEdgeLen = (int)(bs.edgeMaxLen / bs.cellSize);
+  cfg.maxSimplificationError = bs.edgeMaxError;
+  cfg.minRegionArea = (int)rcSqr(bs.regionMinSize);  // Note: area = size*size
+  cfg.mergeRegionArea =
+      (int)rcSqr(bs.regionMergeSize);  // Note: area = size*size
+  cfg.maxVertsPerPoly = (int)bs.vertsPerPoly;
+  cfg.detailSampleDist =
+      bs.detailSampleDist < 0.9f ? 0 : bs.cellSize * bs.detailSampleDist;
+  cfg.detailSampleMaxError = bs.cellHeight * bs.detailSampleMaxError;
+
+  // Set the area where the navigation will be build.
+  // Here the bounds of the input mesh are used, but the
+  // area could be specified by an user defined box, etc.
+  rcVcopy(cfg.bmin, bmin);
+  rcVcopy(cfg.bmax, bmax);
+  rcCalcGridSize(cfg.bmin, cfg.bmax, cfg.cs, &cfg.width, &cfg.height);
+
+  return cfg;
+}
+
+// Climb to rasterize with when the heightfield is shared by all agents of
+// settings.  Rasterization only uses the climb to decide whether overlapping
+// triangles are the same walkable surface, the smallest climb merges least
+int sharedWalkableClimb(const std::vector<esp::nav::NavMeshSettings>& settings,
+                        const rcConfig& cfg) {
+  int walkableClimb = cfg.walkableClimb;
+  for (const auto& bs : settings)
+    walkableClimb = std::min(
+        walkableClimb, makeConfig(bs, cfg.bmin, cfg.bmax).walkableClimb);
+  return walkableClimb;
+}
+
+// The square tiles of bs.tileSize cells a tiled build splits the area of cfg
+// into
+struct TileGrid {
+  TileGrid(const rcConfig& cfg, const int tileSize) : cfg(cfg) {
+    tilesX = (cfg.width + tileSize - 1) / tileSize;
+    tilesY = (cfg.height + tileSize - 1) / tileSize;
+    tileWorldSize = tileSize * cfg.cs;
+
+    // Tiles are rasterized with a border of extra cells on every side so
+    // that erosion and region partitioning see the geometry of their
+    // neighbours
+    tileCfg = cfg;
+    tileCfg.tileSize = tileSize;
+    tileCfg.borderSize = cfg.walkableRadius + 3;
+    tileCfg.width = tileSize + 2 * tileCfg.borderSize;
+    tileCfg.height = tileSize + 2 * tileCfg.borderSize;
+    border = tileCfg.borderSize * cfg.cs;
+  }
+
+  int numTiles() const { return tilesX * tilesY; }
+
+  // Range of tiles whose area including the border overlaps [min, max]
+  void tileRange(const float* min,
+                 const float* max,
+                 int* x0,
+                 int* y0,
+                 int* x1,
+                 int* y1) const {
+    *x0 = std::max(
+        (int)floorf((min[0] - border - cfg.bmin[0]) / tileWorldSize), 0);
+    *x1 = std::min(
+        (int)floorf((max[0] + border - cfg.bmin[0]) / tileWorldSize),
+        tilesX - 1);
+    *y0 = std::max(
+        (int)floorf((min[2] - border - cfg.bmin[2]) / tileWorldSize), 0);
+    *y1 = std::min(
+        (int)floorf((max[2] + border - cfg.bmin[2]) / tileWorldSize),
+        tilesY - 1);
+  }
+
+  // Build config of tile (x, y), including the border
+  rcConfig tileConfig(const int x, const int y) const {
+    rcConfig c = tileCfg;
+    c.bmin[0] = cfg.bmin[0] + x * tileWorldSize - border;
+    c.bmin[2] = cfg.bmin[2] + y * tileWorldSize - border;
+    c.bmax[0] = cfg.bmin[0] + (x + 1) * tileWorldSize + border;
+    c.bmax[2] = cfg.bmin[2] + (y + 1) * tileWorldSize + border;
+    return c;
+  }
+
+  rcConfig cfg;
+  rcConfig tileCfg;
+  int tilesX, tilesY;
+  float tileWorldSize;
+  float border;
+};
+
+// Builds the Detour data of the given tiles in parallel, for every agent of
+// settings.  Each tile is rasterized once and then filtered and eroded for
+// every agent.  tileData gets one entry per agent and tile, null for tiles
+// with nothing walkable.  On failure all built data is freed.  The stages of
+// all tiles are added to stats
+bool buildTilesData(
+    const TileGrid& grid,
+    const std::vector<esp::nav::NavMeshSettings>& settings,
+    const float* verts,
+    const int nverts,
+    const int* tris,
+    const int ntris,
+    const std::vector<int>& tiles,
+    std::vector<std::vector<std::pair<unsigned char*, int>>>& tileData,
+    BuildStatsContext& stats) {
+  std::vector<int> tileSlot(grid.numTiles(), -1);
+  for (int i = 0; i < tiles.size(); ++i) {
+    tileSlot[tiles[i]] = i;
+  }
+
+  // Bin the triangles into every requested tile (plus border) their bounds
+  // overlap
+  std::vector<std::vector<int>> tileTris(tiles.size());
+  for (int i = 0; i < ntris; ++i) {
+    float triMin[3], triMax[3];
+    rcVcopy(triMin, &verts[tris[3 * i] * 3]);
+    rcVcopy(triMax, triMin);
+    for (int j = 1; j < 3; ++j) {
+      rcVmin(triMin, &verts[tris[3 * i + j] * 3]);
+      rcVmax(triMax, &verts[tris[3 * i + j] * 3]);
+    }
+    int x0, y0, x1, y1;
+    grid.tileRange(triMin, triMax, &x0, &y0, &x1, &y1);
+    for (int y = y0; y <= y1; ++y) {
+      for (int x = x0; x <= x1; ++x) {
+        const int slot = tileSlot[y * grid.tilesX + x];
+        if (slot >= 0)
+          tileTris[slot].push_back(i);
+      }
+    }
+  }
+
+  const esp::nav::NavMeshSettings& bs = settings[0];
+  const int numThreads =
+      bs.numBuildThreads > 0
+          ? bs.numBuildThreads
+          : std::max(1u, std::thread::hardware_concurrency());
+  LOG(INFO) << "Building " << tiles.size() << " of " << grid.tilesX << "x"
+            << grid.tilesY << " navmesh tiles for " << settings.size()
+            << " agents on " << numThreads << " threads";
+
+  // Every agent gets the tiles a separate build of it would have
+  std::vector<TileGrid> agentGrids;
+  for (const auto& agent : settings) {
+    agentGrids.emplace_back(makeConfig(agent, grid.cfg.bmin, grid.cfg.bmax),
+                            grid.tileCfg.tileSize);
+  }
+
+  tileData.assign(settings.size(),
+                  std::vector<std::pair<unsigned char*, int>>(
+                      tiles.size(), std::make_pair(nullptr, 0)));
+  std::atomic<bool> success{true};
+  std::mutex statsMutex;
+#pragma omp parallel for schedule(dynamic, 1) num_threads(numThreads)
+  for (int i = 0; i < tiles.size(); ++i) {
+    if (tileTris[i].empty() || !success)
+      continue;
+    const int x = tiles[i] % grid.tilesX;
+    const int y = tiles[i] / grid.tilesX;
+
+    std::vector<int> subTris;
+    subTris.reserve(3 * tileTris[i].size());
+    for (int iTri : tileTris[i]) {
+      subTris.insert(subTris.end(), &tris[3 * iTri], &tris[3 * iTri + 3]);
+    }
+    const int numSubTris = tileTris[i].size();
+
+    BuildStatsContext ctx;
+    std::vector<unsigned char> subAreas(numSubTris, 0);
+    rcMarkWalkableTriangles(&ctx, grid.cfg.walkableSlopeAngle, verts, nverts,
+                            subTris.data(), numSubTris, subAreas.data());
+    rcConfig tileCfg = grid.tileConfig(x, y);
+    tileCfg.walkableClimb = sharedWalkableClimb(settings, tileCfg);
+    Workspace ws;
+    bool tileSuccess = rasterizeTriangles(ctx, tileCfg, verts, nverts,
+                                          subTris.data(), subAreas.data(),
+                                          numSubTris, ws);
+    std::vector<unsigned char> spanAreas;
+    if (tileSuccess && settings.size() > 1)
+      spanAreas = getSpanAreas(*ws.solid);
+    bool isFiltered = false;
+    for (int j = 0; j < settings.size() && tileSuccess; ++j) {
+      const rcConfig cfg = agentGrids[j].tileConfig(x, y);
+      Workspace agentWs;
+      rcHeightfield* solid = ws.solid;
+      // Agents filter the shared heightfield in place, the next one starts
+      // from the areas of the rasterization again, also when cropping
+      if (isFiltered)
+        setSpanAreas(spanAreas, *ws.solid);
+      if (cfg.borderSize < tileCfg.borderSize) {
+        // Agents with a narrower border than the widest one get a copy of
+        // their part of the heightfield, same as rasterizing just that part
+        agentWs.solid = rcAllocHeightfield();
+        solid = agentWs.solid;
+        tileSuccess =
+            solid && cropHeightfield(ctx, *ws.solid, cfg, *agentWs.solid);
+      }
+      isFiltered = isFiltered || solid == ws.solid;
+      tileSuccess =
+          tileSuccess &&
+          buildCompactHeightfield(ctx, cfg, settings[j], *solid, agentWs) &&
+          buildTileDataFromCompactHeightfield(
+              ctx, cfg, settings[j], agentWs, x, y, &tileData[j][i].first,
+              &tileData[j][i].second);
+    }
+    if (!tileSuccess) {
+      LOG(ERROR) << "Could not build tile " << x << "," << y;
+      success = false;
+    }
+    ctx.addTile();
+    std::lock_guard<std::mutex> lock(statsMutex);
+    stats.merge(ctx);
+  }
+
+  if (!success) {
+    for (auto& agentData : tileData) {
+      for (auto& data : agentData) {
+        dtFree(data.first);
+      }
+    }
+    tileData.clear();
+  }
+  return success;
+}
+
+// Builds all tiles of grid for every agent of settings and adds them to the
+// navmesh of that agent in navMeshes
+bool buildTiles(const TileGrid& grid,
+                const std::vector<esp::nav::NavMeshSettings>& settings,
+                const float* verts,
+                const int nverts,
+                const int* tris,
+                const int ntris,
+                const std::vector<dtNavMesh*>& navMeshes,
+                BuildStatsContext& stats) {
+  // 32 bit poly refs leave 22 bits for the tile and polygon ids
+  const int tileBits = dtIlog2(dtNextPow2(grid.numTiles()));
+  if (tileBits > 14) {
+    LOG(ERROR) << "Too many tiles (" << grid.numTiles()
+               << "), increase tileSize";
+    return false;
+  }
+  dtNavMeshParams params;
+  memset(&params, 0, sizeof(params));
+  rcVcopy(params.orig, grid.cfg.bmin);
+  params.tileWidth = grid.tileWorldSize;
+  params.tileHeight = grid.tileWorldSize;
+  params.maxTiles = 1 << tileBits;
+  params.maxPolys = 1 << (22 - tileBits);
+  for (dtNavMesh* navMesh : navMeshes) {
+    if (dtStatusFailed(navMesh->init(&params))) {
+      LOG(ERROR) << "Could not init Detour navmesh";
+      return false;
+    }
+  }
+
+  std::vector<int> tiles(grid.numTiles());
+  std::iota(tiles.begin(), tiles.end(), 0);
+  std::vector<std::vector<std::pair<unsigned char*, int>>> tileData;
+  if (!buildTilesData(grid, settings, verts, nverts, tris, ntris, tiles,
+                      tileData, stats)) {
+    return false;
+  }
+
+  // dtNavMesh::addTile isn't thread safe, so the tiles are only added once
+  // they are all built
+  bool success = true;
+  for (int j = 0; j < navMeshes.size(); ++j) {
+    for (auto& data : tileData[j]) {
+      if (!data.first)
+        continue;
+      if (!success ||
+          dtStatusFailed(navMeshes[j]->addTile(data.first, data.second,
+                                               DT_TILE_FREE_DATA, 0, 0))) {
+        dtFree(data.first);
+        success = false;
+      }
+    }
+  }
+
+  return success;
+}
+
+// Builds the navmesh of every agent of settings as a single tile over the
+// area of cfg.  The agents share one heightfield, so they are filtered one
+// after the other and only the rest of their pipelines run in parallel
+bool buildSingleTile(const rcConfig& cfg,
+                     const std::vector<esp::nav::NavMeshSettings>& settings,
+                     const float* verts,
+                     const int nverts,
+                     const int* tris,
+                     const int ntris,
+                     const std::vector<dtNavMesh*>& navMeshes,
+                     BuildStatsContext& stats) {
+  // Find triangles which are walkable based on their slope.
+  // If your input data is multiple meshes, you can transform them here,
+  // calculate the are type for each of the meshes and rasterize them.
+  std::vector<unsigned char> triareas(ntris, 0);
+  rcMarkWalkableTriangles(&stats, cfg.walkableSlopeAngle, verts, nverts, tris,
+                          ntris, triareas.data());
+
+  rcConfig areaCfg = cfg;
+  areaCfg.walkableClimb = sharedWalkableClimb(settings, cfg);
+  std::vector<rcConfig> agentCfgs;
+  for (const auto& agent : settings)
+    agentCfgs.push_back(makeConfig(agent, cfg.bmin, cfg.bmax));
+  std::vector<Workspace> agentWs(settings.size());
+  {
+    Workspace ws;
+    if (!rasterizeTriangles(stats, areaCfg, verts, nverts, tris,
+                            triareas.data(), ntris, ws)) {
+      return false;
+    }
+    std::vector<unsigned char> spanAreas;
+    if (settings.size() > 1)
+      spanAreas = getSpanAreas(*ws.solid);
+    for (int j = 0; j < settings.size(); ++j) {
+      if (j > 0)
+        setSpanAreas(spanAreas, *ws.solid);
+      if (!buildCompactHeightfield(stats, agentCfgs[j], settings[j],
+                                   *ws.solid, agentWs[j])) {
+        return false;
+      }
+    }
+  }
+  stats.addTile();
+
+  const esp::nav::NavMeshSettings& bs = settings[0];
+  const int numThreads =
+      bs.numBuildThreads > 0
+          ? bs.numBuildThreads
+          : std::max(1u, std::thread::hardware_concurrency());
+  std::vector<std::pair<unsigned char*, int>> navData(
+      settings.size(), std::make_pair(nullptr, 0));
+  std::atomic<bool> success{true};
+  std::mutex statsMutex;
+#pragma omp parallel for schedule(dynamic, 1) num_threads(numThreads)
+  for (int j = 0; j < settings.size(); ++j) {
+    // The compact heightfield stays with agentWs, Recast memory has to be
+    // freed on the thread that allocated it for the stats to add up
+    BuildStatsContext ctx;
+    Workspace ws;
+    std::swap(ws.chf, agentWs[j].chf);
+    if (!buildTileDataFromCompactHeightfield(ctx, agentCfgs[j], settings[j],
+                                             ws, 0, 0, &navData[j].first,
+                                             &navData[j].second)) {
+      success = false;
+    } else if (!navData[j].first) {
+      LOG(ERROR) << "Could not build Detour navmesh, nothing is walkable";
+      success = false;
+    }
+    std::swap(ws.chf, agentWs[j].chf);
+    std::lock_guard<std::mutex> lock(statsMutex);
+    stats.merge(ctx);
+  }
+
+  for (int j = 0; j < settings.size(); ++j) {
+    if (!navData[j].first)
+      continue;
+    if (!success || dtStatusFailed(navMeshes[j]->init(
+                        navData[j].first, navData[j].second,
+                        DT_TILE_FREE_DATA))) {
+      if (success)
+        LOG(ERROR) << "Could not init Detour navmesh";
+      dtFree(navData[j].first);
+      success = false;
+    }
+  }
+  return success;
+}
+
+// Builds one navmesh for every agent of settings from a single rasterization
+// of the input, see PathFinder::buildMultiple.  On failure navMeshes is left
+// empty
+bool buildNavMeshes(const std::vector<esp::nav::NavMeshSettings>& settings,
+                    const float* verts,
+                    const int nverts,
+                    const int* tris,
+                    const int ntris,
+                    const float* bmin,
+                    const float* bmax,
+                    std::vector<dtNavMesh*>& navMeshes,
+                    BuildStatsContext& stats) {
+  navMeshes.clear();
+  if (settings.empty()) {
+    LOG(ERROR) << "No navmesh settings to build";
+    return false;
+  }
+  const esp::nav::NavMeshSettings& bs = settings[0];
+  // The tiles need the widest border any of the agents needs
+  rcConfig cfg = makeConfig(bs, bmin, bmax);
+  for (const auto& agent : settings) {
+    if (agent.cellSize != bs.cellSize || agent.cellHeight != bs.cellHeight ||
+        agent.agentMaxSlope != bs.agentMaxSlope ||
+        agent.tileSize != bs.tileSize) {
+      LOG(ERROR) << "Navmeshes built together must have the same cellSize, "
+                    "cellHeight, agentMaxSlope and tileSize";
+      return false;
+    }
+    const rcConfig agentCfg = makeConfig(agent, bmin, bmax);
+    // Detour can't handle more points per polygon than DT_VERTS_PER_POLYGON
+    if (agentCfg.maxVertsPerPoly > DT_VERTS_PER_POLYGON) {
+      LOG(ERROR) << "vertsPerPoly can be at most " << DT_VERTS_PER_POLYGON;
+      return false;
+    }
+    if (agentCfg.walkableRadius > cfg.walkableRadius)
+      cfg = agentCfg;
+  }
+
+  bool success = true;
+  for (int j = 0; j < settings.size() && success; ++j) {
+    dtNavMesh* navMesh = dtAllocNavMesh();
+    if (!navMesh) {
+      LOG(ERROR) << "Could not allocate Detour navmesh";
+      success = false;
+    } else {
+      navMeshes.push_back(navMesh);
+    }
+  }
+
+  if (success && bs.tileSize > 0) {
+    LOG(INFO) << "Building navmesh with " << cfg.width << "x" << cfg.height
+              << " cells in tiles of " << bs.tileSize << "x" << bs.tileSize;
+    success = buildTiles(TileGrid(cfg, bs.tileSize), settings, verts, nverts,
+                         tris, ntris, navMeshes, stats);
+  } else if (success) {
+    LOG(INFO) << "Building navmesh with " << cfg.width << "x" << cfg.height
+              << " cells";
+    success = buildSingleTile(cfg, settings, verts, nverts, tris, ntris,
+                              navMeshes, stats);
+  }
+
+  if (!success) {
+    for (dtNavMesh* navMesh : navMeshes)
+      dtFreeNavMesh(navMesh);
+    navMeshes.clear();
+  }
+  return success;
+}
+}  // namespace
+
+std::string esp::nav::NavMeshBuildStats::report() const {
+  const double MiB = 1 << 20;
+  double stagesSeconds = 0;
+  for (const Stage& stage : stages)
+    stagesSeconds += stage.seconds;
+
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(3) << "Built " << numTiles
+      << " tiles in " << totalSeconds << "s, peak Recast memory "
+      << std::setprecision(1) << peakBytes / MiB << " MiB\n";
+  for (const Stage& stage : stages) {
+    out << "  " << std::left << std::setw(24) << stage.name << std::right
+        << std::setprecision(3) << std::setw(9) << stage.seconds << "s"
+        << std::setprecision(1) << std::setw(7)
+        << (stagesSeconds > 0 ? 100 * stage.seconds / stagesSeconds : 0)
+        << "%" << std::setw(9) << stage.peakBytes / MiB << " MiB\n";
+  }
+  return out.str();
+}
+
+esp::nav::PathFinder::PathFinder() : navMesh_(0), filter_(0) {
+  filter_ = new dtQueryFilter();
+  filter_->setIncludeFlags(POLYFLAGS_WALK);
+  filter_->setExcludeFlags(0);
+}
+
+void esp::nav::PathFinder::freeNavMesh() {
+  navMeshData_.reset();
+  navMesh_ = 0;
+  islandSystem_ = nullptr;
+}
+
+void esp::nav::PathFinder::free() {
+  freeNavMesh();
+  if (queryPool_) {
+    delete queryPool_;
+    queryPool_ = nullptr;
+  }
+  if (filter_) {
+    delete filter_;
+    filter_ = nullptr;
+  }
+  if (obstacleDistanceGrid_) {
+    delete obstacleDistanceGrid_;
+    obstacleDistanceGrid_ = nullptr;
+  }
+  if (polyGridIndex_) {
+    delete polyGridIndex_;
+    polyGridIndex_ = nullptr;
+  }
+  if (clusterGraph_) {
+    delete clusterGraph_;
+    clusterGraph_ = nullptr;
+  }
+  if (sampler_) {
+    delete sampler_;
+    sampler_ = nullptr;
+  }
+  if (pathCache_) {
+    delete pathCache_;
+    pathCache_ = nullptr;
+  }
+
+  clearDistanceFieldCache();
+  tiledBuildSettings_.tileSize = 0;
+}
+
+bool esp::nav::PathFinder::build(const NavMeshSettings& bs,
+                                 const float* verts,
+                                 const int nverts,
+                                 const int* tris,
+                                 const int ntris,
+                                 const float* bmin,
+                                 const float* bmax) {
+  const auto start = std::chrono::steady_clock::now();
+  BuildStatsContext ctx;
+  std::vector<dtNavMesh*> navMeshes;
+  if (!buildNavMeshes({bs}, verts, nverts, tris, ntris, bmin, bmax, navMeshes,
+                      ctx) ||
+      !initBuiltNavMesh(navMeshes[0], bs, bmin, bmax)) {
+    return false;
+  }
+
+  buildStats_ = ctx.stats(std::chrono::duration<double>(
+                              std::chrono::steady_clock::now() - start)
+                              .count());
+  return true;
+}
+
+std::vector<esp::nav::PathFinder::ptr> esp::nav::PathFinder::buildMultiple(
+    const std::vector<NavMeshSettings>& settings,
+    const float* verts,
+    const int nverts,
+    const int* tris,
+    const int ntris,
+    const float* bmin,
+    const float* bmax) {
+  const auto start = std::chrono::steady_clock::now();
+  BuildStatsContext ctx;
+  std::vector<dtNavMesh*> navMeshes;
+  if (!buildNavMeshes(settings, verts, nverts, tris, ntris, bmin, bmax,
+                      navMeshes, ctx)) {
+    return {};
+  }
+
+  std::vector<PathFinder::ptr> pathFinders;
+  for (int i = 0; i < settings.size(); ++i) {
+    auto pf = PathFinder::create();
+    if (!pf->initBuiltNavMesh(navMeshes[i], settings[i], bmin, bmax)) {
+      for (int j = i + 1; j < navMeshes.size(); ++j)
+        dtFreeNavMesh(navMeshes[j]);
+      return {};
+    }
+    pathFinders.push_back(pf);
+  }
+
+  const NavMeshBuildStats stats = ctx.stats(
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count());
+  for (auto& pf : pathFinders)
+    pf->buildStats_ = stats;
+  return pathFinders;
+}
+
+bool esp::nav::PathFinder::initBuiltNavMesh(dtNavMesh* navMesh,
+                                            const NavMeshSettings& bs,
+                                            const float* bmin,
+                                            const float* bmax) {
+  auto navMeshData = std::make_shared<impl::NavMeshData>(navMesh);
+  navMeshData->islandSystem =
+      new impl::IslandSystem(navMesh, &navMeshData->filter);
+  if (!initNavQuery(std::move(navMeshData))) {
+    return false;
+  }
+  tiledBuildSettings_ = bs;
+  tiledBuildBounds_ = box3f(Eigen::Map<const vec3f>(bmin),
+                            Eigen::Map<const vec3f>(bmax));
+
+  int numVerts = 0, numPolys = 0;
+  for (int i = 0; i < navMesh->getMaxTiles(); ++i) {
+    const dtMeshTile* tile = ((const dtNavMesh*)navMesh)->getTile(i);
+    if (!tile || !tile->header)
+      continue;
+    numVerts += tile->header->vertCount;
+    numPolys += tile->header->polyCount;
+  }
+  LOG(INFO) << "Created navmesh with " << numVerts << " vertices " << numPolys
+            << " polygons";
+  return true;
+}
+
+bool esp::nav::PathFinder::initNavQuery(
+    std::shared_ptr<impl::NavMeshData> navMeshData) {
+  // The query pool refers to the old navmesh
+  delete queryPool_;
+  queryPool_ = nullptr;
+  freeNavMesh();
+  navMeshData_ = std::move(navMeshData);
+  navMesh_ = navMeshData_->navMesh;
+  islandSystem_ = navMeshData_->islandSystem;
+  ++navMeshGeneration_;
+  queryPool_ = new impl::NavQueryPool(navMesh_, MAX_NODES, seed_);
+  if (!queryPool_->acquire().navQuery()) {
+    return false;
+  }
+
+  clearDistanceFieldCache();
+  buildPolyGridIndex();
+  buildObstacleDistanceGrid();
+  buildClusterGraph();
+  buildSampler();
+  buildPathCache();
+
+  return true;
+}
+
+void esp::nav::PathFinder::buildPolyGridIndex() {
+  delete polyGridIndex_;
+  polyGridIndex_ = nullptr;
+  if (!navMesh_ || polyGridIndexCellSize_ <= 0)
+    return;
+
+  polyGridIndex_ = new impl::PolyGridIndex(navMesh_, polyGridIndexCellSize_);
+}
+
+void esp::nav::PathFinder::setPolyGridIndexCellSize(float cellSize) {
+  polyGridIndexCellSize_ = std::max(cellSize, 0.0f);
+  buildPolyGridIndex();
+}
+
+void esp::nav::PathFinder::buildClusterGraph() {
+  delete clusterGraph_;
+  clusterGraph_ = nullptr;
+  if (!navMesh_ || clusterGraphCellSize_ <= 0)
+    return;
+
+  clusterGraph_ =
+      new impl::ClusterGraph(navMesh_, filter_, clusterGraphCellSize_);
+}
+
+void esp::nav::PathFinder::buildSampler() {
+  delete sampler_;
+  sampler_ = nullptr;
+  if (!navMesh_)
+    return;
+
+  std::vector<float> islandRadii;
+  for (const auto& record : islandSystem_->islandRecords())
+    islandRadii.push_back(record.radius);
+  const impl::IslandSystem* islandSystem = islandSystem_;
+  sampler_ = new impl::NavMeshSampler(
+      navMesh_, filter_,
+      [islandSystem](dtPolyRef ref) { return islandSystem->islandId(ref); },
+      islandRadii);
+}
+
+void esp::nav::PathFinder::setClusterGraphCellSize(float cellSize) {
+  clusterGraphCellSize_ = std::max(cellSize, 0.0f);
+  buildClusterGraph();
+}
+
+void esp::nav::PathFinder::setPathCacheBudget(
+    size_t maxBytes,
+    float quantization /*= 0.01*/) {
+  pathCacheMaxBytes_ = maxBytes;
+  pathCacheQuantization_ = std::max(quantization, 0.0f);
+  buildPathCache();
+}
+
+esp::nav::PathCacheStats esp::nav::PathFinder::getPathCacheStats() const {
+  PathCacheStats stats{};
+  if (pathCache_) {
+    stats.hits = pathCache_->hits();
+    stats.misses = pathCache_->misses();
+    stats.numEntries = pathCache_->size();
+    stats.numBytes = pathCache_->bytes();
+  }
+  return stats;
+}
+
+void esp::nav::PathFinder::buildPathCache() {
+  delete pathCache_;
+  pathCache_ = nullptr;
+  if (!navMesh_ || pathCacheMaxBytes_ == 0)
+    return;
+
+  pathCache_ = new impl::PathCache(pathCacheMaxBytes_, pathCacheQuantization_);
+}
+
+void esp::nav::PathFinder::buildObstacleDistanceGrid() {
+  delete obstacleDistanceGrid_;
+  obstacleDistanceGrid_ = nullptr;
+  if (!navMesh_ || obstacleDistanceGridCellSize_ <= 0)
+    return;
+
+  obstacleDistanceGrid_ = new impl::ObstacleDistanceGrid(
+      navMesh_, filter_, obstacleDistanceGridCellSize_,
+      obstacleDistanceGridRadius_);
+  VLOG(1) << "Built obstacle distance grid with "
+          << obstacleDistanceGrid_->numSamples() << " samples";
+}
+
+void esp::nav::PathFinder::setObstacleDistanceGridCellSize(
+    float cellSize,
+    float maxSearchRadius /*= 2.0*/) {
+  obstacleDistanceGridCellSize_ = std::max(cellSize, 0.0f);
+  obstacleDistanceGridRadius_ = maxSearchRadius;
+  buildObstacleDistanceGrid();
+}
+
+bool esp::nav::PathFinder::build(const NavMeshSettings& bs,
+                                 const esp::assets::MeshData& mesh) {
+  const int numVerts = mesh.vbo.size();
+  const int numIndices = mesh.ibo.size();
+  const float mf = std::numeric_limits<float>::max();
+  vec3f bmin(mf, mf, mf);
+  vec3f bmax(-mf, -mf, -mf);
+
   for (int i = 0; i < numVerts; i++) {
     const vec3f& p = mesh.vbo[i];
     bmin = bmin.cwiseMin(p);
@@ -571,9 +1945,153 @@ bool esp::nav::PathFinder::build(const NavMeshSettings& bs,
   return success;
 }
 
+std::vector<esp::nav::PathFinder::ptr> esp::nav::PathFinder::buildMultiple(
+    const std::vector<NavMeshSettings>& settings,
+    const esp::assets::MeshData& mesh) {
+  const float mf = std::numeric_limits<float>::max();
+  vec3f bmin(mf, mf, mf);
+  vec3f bmax(-mf, -mf, -mf);
+  for (const vec3f& p : mesh.vbo) {
+    bmin = bmin.cwiseMin(p);
+    bmax = bmax.cwiseMax(p);
+  }
+  std::vector<int> indices(mesh.ibo.begin(), mesh.ibo.end());
+  return buildMultiple(settings, mesh.vbo[0].data(), mesh.vbo.size(),
+                       indices.data(), indices.size() / 3, bmin.data(),
+                       bmax.data());
+}
+
+bool esp::nav::PathFinder::rebuildTiles(const float* verts,
+                                        const int nverts,
+                                        const int* tris,
+                                        const int ntris,
+                                        const std::vector<box3f>& dirtyBoxes) {
+  if (!navMesh_ || tiledBuildSettings_.tileSize <= 0) {
+    LOG(ERROR) << "Only navmeshes built with tileSize > 0 can be rebuilt";
+    return false;
+  }
+  const NavMeshSettings& bs = tiledBuildSettings_;
+  const TileGrid grid(makeConfig(bs, tiledBuildBounds_.min().data(),
+                                 tiledBuildBounds_.max().data()),
+                      bs.tileSize);
+
+  std::vector<char> isDirty(grid.numTiles(), 0);
+  for (const box3f& box : dirtyBoxes) {
+    int x0, y0, x1, y1;
+    grid.tileRange(box.min().data(), box.max().data(), &x0, &y0, &x1, &y1);
+    for (int y = y0; y <= y1; ++y) {
+      for (int x = x0; x <= x1; ++x) {
+        isDirty[y * grid.tilesX + x] = 1;
+      }
+    }
+  }
+  std::vector<int> tiles;
+  for (int iTile = 0; iTile < grid.numTiles(); ++iTile) {
+    if (isDirty[iTile])
+      tiles.push_back(iTile);
+  }
+  if (tiles.empty())
+    return true;
+
+  const auto start = std::chrono::steady_clock::now();
+  BuildStatsContext ctx;
+  std::vector<std::vector<std::pair<unsigned char*, int>>> agentTileData;
+  if (!buildTilesData(grid, {bs}, verts, nverts, tris, ntris, tiles,
+                      agentTileData, ctx)) {
+    return false;
+  }
+  auto& tileData = agentTileData[0];
+
+  // Swap in the new tiles, remembering which islands the old ones were on.
+  // A new tile takes the place of the old ones, so these have to go first,
+  // but copies of them are kept to put back if the new tile can't be added
+  bool success = true;
+  std::unordered_set<uint32_t> dirtyIslands;
+  std::vector<const dtMeshTile*> addedTiles;
+  const dtNavMesh* navMesh = navMesh_;
+  for (int i = 0; i < tiles.size(); ++i) {
+    const int x = tiles[i] % grid.tilesX;
+    const int y = tiles[i] / grid.tilesX;
+
+    static const int MAX_LAYERS = 32;
+    const dtMeshTile* oldTiles[MAX_LAYERS];
+    const int numOldTiles = navMesh->getTilesAt(x, y, oldTiles, MAX_LAYERS);
+    std::vector<std::tuple<dtTileRef, unsigned char*, int>> oldTileData;
+    for (int j = 0; j < numOldTiles; ++j) {
+      islandSystem_->collectIslands(oldTiles[j], dirtyIslands);
+      auto* data = static_cast<unsigned char*>(
+          dtAlloc(oldTiles[j]->dataSize, DT_ALLOC_PERM));
+      if (data)
+        std::memcpy(data, oldTiles[j]->data, oldTiles[j]->dataSize);
+      oldTileData.emplace_back(navMesh->getTileRef(oldTiles[j]), data,
+                               oldTiles[j]->dataSize);
+    }
+    for (const auto& old : oldTileData)
+      navMesh_->removeTile(std::get<0>(old), 0, 0);
+
+    dtTileRef tileRef = 0;
+    bool added = true;
+    if (tileData[i].first &&
+        dtStatusFailed(navMesh_->addTile(tileData[i].first,
+                                         tileData[i].second,
+                                         DT_TILE_FREE_DATA, 0, &tileRef))) {
+      LOG(ERROR) << "Could not add tile " << x << "," << y
+                 << ", keeping the old one";
+      dtFree(tileData[i].first);
+      success = false;
+      added = false;
+    } else if (tileData[i].first) {
+      addedTiles.push_back(navMesh_->getTileByRef(tileRef));
+    }
+
+    for (const auto& old : oldTileData) {
+      unsigned char* data = std::get<1>(old);
+      if (added || !data) {
+        dtFree(data);
+        continue;
+      }
+      // Same ref as before, so that polygon refs held elsewhere stay valid
+      if (dtStatusFailed(navMesh_->addTile(data, std::get<2>(old),
+                                           DT_TILE_FREE_DATA, std::get<0>(old),
+                                           &tileRef))) {
+        LOG(ERROR) << "Could not restore tile " << x << "," << y;
+        dtFree(data);
+        continue;
+      }
+      addedTiles.push_back(navMesh_->getTileByRef(tileRef));
+    }
+  }
+
+  ++navMeshGeneration_;
+  islandSystem_->updateTiles(dirtyIslands, addedTiles);
+  clearDistanceFieldCache();
+  buildPolyGridIndex();
+  buildObstacleDistanceGrid();
+  buildClusterGraph();
+  buildSampler();
+  buildPathCache();
+
+  buildStats_ = ctx.stats(std::chrono::duration<double>(
+                              std::chrono::steady_clock::now() - start)
+                              .count());
+  return success;
+}
+
+bool esp::nav::PathFinder::rebuildTiles(const esp::assets::MeshData& mesh,
+                                        const std::vector<box3f>& dirtyBoxes) {
+  std::vector<int> indices(mesh.ibo.begin(), mesh.ibo.end());
+  return rebuildTiles(mesh.vbo[0].data(), mesh.vbo.size(), indices.data(),
+                      indices.size() / 3, dirtyBoxes);
+}
+
 static const int NAVMESHSET_MAGIC =
     'M' << 24 | 'S' << 16 | 'E' << 8 | 'T';  //'MSET';
-static const int NAVMESHSET_VERSION = 1;
+// Version 1 files store the tiles back to back.  Version 2 files also store
+// the islands and start every tile on a page boundary, so that the file can
+// be memory mapped and the tiles used in place.
+static const int NAVMESHSET_VERSION_1 = 1;
+static const int NAVMESHSET_VERSION = 2;
+static const size_t NAVMESHSET_ALIGNMENT = 4096;
 
 struct NavMeshSetHeader {
   int magic;
@@ -587,46 +2105,66 @@ struct NavMeshTileHeader {
   int dataSize;
 };
 
-bool esp::nav::PathFinder::loadNavMesh(const std::string& path) {
-  FILE* fp = fopen(path.c_str(), "rb");
-  if (!fp)
-    return false;
+// Follows NavMeshSetHeader in version 2 files
+struct NavMeshSetHeaderV2 {
+  uint64_t fileSize;
+  //! FNV-1a hash of the tile headers, island records and island ids, that is
+  //! everything between the headers and the first tile.  The tiles aren't
+  //! hashed so that loading doesn't have to touch every page of the file,
+  //! Detour checks their headers when they're added
+  uint64_t checksum;
+  uint32_t numIslands;
+  uint32_t reserved;
+};
 
-  // Read header.
-  NavMeshSetHeader header;
-  size_t readLen = fread(&header, sizeof(NavMeshSetHeader), 1, fp);
-  if (readLen != 1) {
-    fclose(fp);
-    return false;
-  }
-  if (header.magic != NAVMESHSET_MAGIC) {
-    fclose(fp);
-    return false;
+// Version 2 files have numTiles of these after the headers, followed by
+// numIslands IslandRecords, the island of every polygon and the tiles
+struct NavMeshTileHeaderV2 {
+  dtTileRef tileRef;
+  int dataSize;
+  int polyCount;
+  //! Offset of the tile data in the file, a multiple of NAVMESHSET_ALIGNMENT
+  uint64_t dataOffset;
+  //! Offset of polyCount island ids in the file
+  uint64_t islandsOffset;
+};
+
+namespace {
+// FNV-1a over 64 bit words rather than bytes, which is 8x faster
+uint64_t fnv1a(const unsigned char* data, size_t size) {
+  uint64_t hash = 14695981039346656037ull;
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, data + i, sizeof(word));
+    hash ^= word;
+    hash *= 1099511628211ull;
   }
-  if (header.version != NAVMESHSET_VERSION) {
-    fclose(fp);
-    return false;
+  for (; i < size; ++i) {
+    hash ^= data[i];
+    hash *= 1099511628211ull;
   }
+  return hash;
+}
 
+// Reads the tiles of a version 1 file after its header and computes the
+// islands
+std::shared_ptr<nav::impl::NavMeshData> readNavMesh(FILE* fp,
+                                               const NavMeshSetHeader& header) {
   dtNavMesh* mesh = dtAllocNavMesh();
-  if (!mesh) {
-    fclose(fp);
-    return false;
-  }
+  if (!mesh)
+    return nullptr;
+  auto navMeshData = std::make_shared<nav::impl::NavMeshData>(mesh);
   dtStatus status = mesh->init(&header.params);
-  if (dtStatusFailed(status)) {
-    fclose(fp);
-    return false;
-  }
+  if (dtStatusFailed(status))
+    return nullptr;
 
   // Read tiles.
   for (int i = 0; i < header.numTiles; ++i) {
     NavMeshTileHeader tileHeader;
-    readLen = fread(&tileHeader, sizeof(tileHeader), 1, fp);
-    if (readLen != 1) {
-      fclose(fp);
-      return false;
-    }
+    size_t readLen = fread(&tileHeader, sizeof(tileHeader), 1, fp);
+    if (readLen != 1)
+      return nullptr;
 
     if (!tileHeader.tileRef || !tileHeader.dataSize)
       break;
@@ -639,88 +2177,394 @@ bool esp::nav::PathFinder::loadNavMesh(const std::string& path) {
     readLen = fread(data, tileHeader.dataSize, 1, fp);
     if (readLen != 1) {
       dtFree(data);
-      fclose(fp);
-      return false;
+      return nullptr;
     }
 
     mesh->addTile(data, tileHeader.dataSize, DT_TILE_FREE_DATA,
                   tileHeader.tileRef, 0);
   }
 
+  navMeshData->islandSystem =
+      new nav::impl::IslandSystem(mesh, &navMeshData->filter);
+  return navMeshData;
+}
+
+// Maps a version 2 file and uses its tiles and islands in place
+std::shared_ptr<nav::impl::NavMeshData> mapNavMesh(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return nullptr;
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) != 0) {
+    close(fd);
+    return nullptr;
+  }
+  const size_t fileSize = fileStat.st_size;
+
+  // Detour writes the links between polygons into the tile data, so the
+  // mapping is private: those pages are copied on write while the rest stays
+  // shared with every other process that maps the file
+  void* mapped =
+      mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    LOG(ERROR) << "Could not map navmesh " << path;
+    return nullptr;
+  }
+  const unsigned char* data = static_cast<unsigned char*>(mapped);
+  auto fail =
+      [&](const char* message) -> std::shared_ptr<nav::impl::NavMeshData> {
+    LOG(ERROR) << "Could not load navmesh " << path << ": " << message;
+    munmap(mapped, fileSize);
+    return nullptr;
+  };
+
+  NavMeshSetHeader header;
+  NavMeshSetHeaderV2 headerV2;
+  const size_t headersSize = sizeof(header) + sizeof(headerV2);
+  if (fileSize < headersSize)
+    return fail("file is truncated");
+  memcpy(&header, data, sizeof(header));
+  memcpy(&headerV2, data + sizeof(header), sizeof(headerV2));
+  if (headerV2.fileSize != fileSize)
+    return fail("file is truncated");
+
+  const size_t tableSize =
+      header.numTiles * sizeof(NavMeshTileHeaderV2) +
+      headerV2.numIslands * sizeof(nav::impl::IslandSystem::IslandRecord);
+  if (header.numTiles < 0 || headersSize + tableSize > fileSize)
+    return fail("file is truncated");
+  size_t checksumEnd = fileSize;
+  if (header.numTiles > 0) {
+    NavMeshTileHeaderV2 firstTileHeader;
+    memcpy(&firstTileHeader, data + headersSize, sizeof(firstTileHeader));
+    if (firstTileHeader.dataOffset < headersSize + tableSize ||
+        firstTileHeader.dataOffset > fileSize)
+      return fail("tile is out of bounds");
+    checksumEnd = firstTileHeader.dataOffset;
+  }
+  if (fnv1a(data + headersSize, checksumEnd - headersSize) !=
+      headerV2.checksum)
+    return fail("checksum mismatch");
+  std::vector<nav::impl::IslandSystem::IslandRecord> islandRecords(
+      headerV2.numIslands);
+  memcpy(islandRecords.data(),
+         data + headersSize + header.numTiles * sizeof(NavMeshTileHeaderV2),
+         islandRecords.size() * sizeof(islandRecords[0]));
+
+  dtNavMesh* mesh = dtAllocNavMesh();
+  if (!mesh || dtStatusFailed(mesh->init(&header.params))) {
+    dtFreeNavMesh(mesh);
+    return fail("could not init Detour navmesh");
+  }
+
+  // The tiles are used in place, so they aren't freed with the navmesh
+  std::vector<std::vector<uint32_t>> tileIslands(mesh->getMaxTiles());
+  for (int i = 0; i < header.numTiles; ++i) {
+    NavMeshTileHeaderV2 tileHeader;
+    memcpy(&tileHeader,
+           data + headersSize + i * sizeof(NavMeshTileHeaderV2),
+           sizeof(tileHeader));
+    if (tileHeader.dataOffset % NAVMESHSET_ALIGNMENT != 0 ||
+        tileHeader.dataOffset + tileHeader.dataSize > fileSize ||
+        tileHeader.islandsOffset + tileHeader.polyCount * sizeof(uint32_t) >
+            fileSize) {
+      dtFreeNavMesh(mesh);
+      return fail("tile is out of bounds");
+    }
+
+    dtTileRef tileRef = 0;
+    unsigned char* tileData =
+        static_cast<unsigned char*>(mapped) + tileHeader.dataOffset;
+    if (dtStatusFailed(mesh->addTile(tileData, tileHeader.dataSize, 0,
+                                     tileHeader.tileRef, &tileRef))) {
+      dtFreeNavMesh(mesh);
+      return fail("could not add tile");
+    }
+
+    const dtMeshTile* tile = mesh->getTileByRef(tileRef);
+    if (tile->header->polyCount != tileHeader.polyCount) {
+      dtFreeNavMesh(mesh);
+      return fail("tile doesn't match its header");
+    }
+    std::vector<uint32_t>& islands =
+        tileIslands[mesh->decodePolyIdTile(mesh->getPolyRefBase(tile))];
+    islands.resize(tileHeader.polyCount);
+    memcpy(islands.data(), data + tileHeader.islandsOffset,
+           islands.size() * sizeof(uint32_t));
+    for (uint32_t island : islands) {
+      if (island >= headerV2.numIslands &&
+          island != nav::NO_ISLAND) {
+        dtFreeNavMesh(mesh);
+        return fail("island id out of range");
+      }
+    }
+  }
+
+  auto navMeshData =
+      std::make_shared<nav::impl::NavMeshData>(mesh, mapped, fileSize);
+  navMeshData->islandSystem =
+      new nav::impl::IslandSystem(mesh, &navMeshData->filter, islandRecords,
+                                  std::move(tileIslands));
+  return navMeshData;
+}
+
+// Reads a navmesh file of either version
+std::shared_ptr<nav::impl::NavMeshData> readNavMesh(const std::string& path) {
+  FILE* fp = fopen(path.c_str(), "rb");
+  if (!fp)
+    return nullptr;
+
+  // Read header.
+  NavMeshSetHeader header;
+  size_t readLen = fread(&header, sizeof(NavMeshSetHeader), 1, fp);
+  if (readLen != 1 || header.magic != NAVMESHSET_MAGIC) {
+    fclose(fp);
+    return nullptr;
+  }
+  std::shared_ptr<nav::impl::NavMeshData> navMeshData;
+  if (header.version == NAVMESHSET_VERSION_1)
+    navMeshData = readNavMesh(fp, header);
   fclose(fp);
+  if (header.version == NAVMESHSET_VERSION)
+    navMeshData = mapNavMesh(path);
+  return navMeshData;
+}
+}  // namespace
+
+bool esp::nav::PathFinder::loadNavMesh(const std::string& path) {
+  // The same file as long as it isn't modified, however it is named
+  struct stat fileStat;
+  if (stat(path.c_str(), &fileStat) != 0)
+    return false;
+#ifdef __APPLE__
+  const struct timespec& mtime = fileStat.st_mtimespec;
+#else
+  const struct timespec& mtime = fileStat.st_mtim;
+#endif
+  const std::string key =
+      std::to_string(fileStat.st_dev) + ":" + std::to_string(fileStat.st_ino) +
+      ":" + std::to_string(fileStat.st_size) + ":" +
+      std::to_string(mtime.tv_sec) + "." + std::to_string(mtime.tv_nsec);
+
+  impl::NavMeshCache& cache = impl::NavMeshCache::instance();
+  std::shared_ptr<impl::NavMeshData> navMeshData = cache.find(key);
+  if (!navMeshData) {
+    navMeshData = readNavMesh(path);
+    if (!navMeshData)
+      return false;
+    navMeshData = cache.insert(key, std::move(navMeshData));
+  }
+
+  tiledBuildSettings_.tileSize = 0;
+  return initNavQuery(std::move(navMeshData));
+}
+
+void esp::nav::PathFinder::setNavMeshCacheCapacity(size_t capacity) {
+  impl::NavMeshCache::instance().setCapacity(capacity);
+}
+
+size_t esp::nav::PathFinder::getNavMeshCacheCapacity() {
+  return impl::NavMeshCache::instance().capacity();
+}
 
-  navMesh_ = mesh;
-  return initNavQuery();
+size_t esp::nav::PathFinder::getNavMeshCacheSize() {
+  return impl::NavMeshCache::instance().size();
 }
 
-bool esp::nav::PathFinder::saveNavMesh(const std::string& path) {
+bool esp::nav::PathFinder::saveNavMesh(const std::string& path,
+                                      int version) {
   if (!navMesh_)
     return false;
-
-  FILE* fp = fopen(path.c_str(), "wb");
-  if (!fp)
+  if (version != NAVMESHSET_VERSION_1 && version != NAVMESHSET_VERSION) {
+    LOG(ERROR) << "Unknown navmesh version " << version;
     return false;
+  }
 
-  // Store header.
-  NavMeshSetHeader header;
-  header.magic = NAVMESHSET_MAGIC;
-  header.version = NAVMESHSET_VERSION;
-  header.numTiles = 0;
-  for (int i = 0; i < navMesh_->getMaxTiles(); ++i) {
-    const dtMeshTile* tile = ((const dtNavMesh*)navMesh_)->getTile(i);
+  const dtNavMesh* navMesh = navMesh_;
+  std::vector<const dtMeshTile*> tiles;
+  for (int i = 0; i < navMesh->getMaxTiles(); ++i) {
+    const dtMeshTile* tile = navMesh->getTile(i);
     if (!tile || !tile->header || !tile->dataSize)
       continue;
-    header.numTiles++;
+    tiles.push_back(tile);
   }
-  memcpy(&header.params, navMesh_->getParams(), sizeof(dtNavMeshParams));
-  fwrite(&header, sizeof(NavMeshSetHeader), 1, fp);
 
-  // Store tiles.
-  for (int i = 0; i < navMesh_->getMaxTiles(); ++i) {
-    const dtMeshTile* tile = ((const dtNavMesh*)navMesh_)->getTile(i);
-    if (!tile || !tile->header || !tile->dataSize)
-      continue;
+  NavMeshSetHeader header;
+  header.magic = NAVMESHSET_MAGIC;
+  header.version = version;
+  header.numTiles = tiles.size();
+  memcpy(&header.params, navMesh->getParams(), sizeof(dtNavMeshParams));
 
-    NavMeshTileHeader tileHeader;
-    tileHeader.tileRef = navMesh_->getTileRef(tile);
-    tileHeader.dataSize = tile->dataSize;
-    fwrite(&tileHeader, sizeof(tileHeader), 1, fp);
+  if (version == NAVMESHSET_VERSION_1) {
+    FILE* fp = fopen(path.c_str(), "wb");
+    if (!fp)
+      return false;
+    bool success = fwrite(&header, sizeof(NavMeshSetHeader), 1, fp) == 1;
+    for (const dtMeshTile* tile : tiles) {
+      NavMeshTileHeader tileHeader;
+      tileHeader.tileRef = navMesh->getTileRef(tile);
+      tileHeader.dataSize = tile->dataSize;
+      success = success &&
+                fwrite(&tileHeader, sizeof(tileHeader), 1, fp) == 1 &&
+                fwrite(tile->data, tile->dataSize, 1, fp) == 1;
+    }
+    fclose(fp);
+    return success;
+  }
 
-    fwrite(tile->data, tile->dataSize, 1, fp);
+  const std::vector<impl::IslandSystem::IslandRecord> islandRecords =
+      islandSystem_->islandRecords();
+  NavMeshSetHeaderV2 headerV2;
+  memset(&headerV2, 0, sizeof(headerV2));
+  headerV2.numIslands = islandRecords.size();
+
+  // Lay out the file, see NavMeshTileHeaderV2
+  const size_t headersSize = sizeof(header) + sizeof(headerV2);
+  size_t offset = headersSize + tiles.size() * sizeof(NavMeshTileHeaderV2) +
+                  islandRecords.size() * sizeof(islandRecords[0]);
+  std::vector<NavMeshTileHeaderV2> tileHeaders(tiles.size());
+  for (int i = 0; i < tiles.size(); ++i) {
+    memset(&tileHeaders[i], 0, sizeof(tileHeaders[i]));
+    tileHeaders[i].tileRef = navMesh->getTileRef(tiles[i]);
+    tileHeaders[i].dataSize = tiles[i]->dataSize;
+    tileHeaders[i].polyCount = tiles[i]->header->polyCount;
+    tileHeaders[i].islandsOffset = offset;
+    offset += tileHeaders[i].polyCount * sizeof(uint32_t);
+  }
+  for (auto& tileHeader : tileHeaders) {
+    offset = (offset + NAVMESHSET_ALIGNMENT - 1) / NAVMESHSET_ALIGNMENT *
+             NAVMESHSET_ALIGNMENT;
+    tileHeader.dataOffset = offset;
+    offset += tileHeader.dataSize;
   }
+  headerV2.fileSize = offset;
+
+  std::vector<unsigned char> buffer(headerV2.fileSize, 0);
+  unsigned char* data = buffer.data();
+  memcpy(data + headersSize, tileHeaders.data(),
+         tileHeaders.size() * sizeof(NavMeshTileHeaderV2));
+  memcpy(data + headersSize + tileHeaders.size() * sizeof(NavMeshTileHeaderV2),
+         islandRecords.data(), islandRecords.size() * sizeof(islandRecords[0]));
+  for (int i = 0; i < tiles.size(); ++i) {
+    const std::vector<uint32_t>& islands =
+        islandSystem_->tileIslands(tiles[i]);
+    memcpy(data + tileHeaders[i].islandsOffset, islands.data(),
+           islands.size() * sizeof(uint32_t));
+    memcpy(data + tileHeaders[i].dataOffset, tiles[i]->data,
+           tiles[i]->dataSize);
+  }
+  const size_t checksumEnd =
+      tileHeaders.empty() ? headerV2.fileSize : tileHeaders[0].dataOffset;
+  headerV2.checksum = fnv1a(data + headersSize, checksumEnd - headersSize);
+  memcpy(data, &header, sizeof(header));
+  memcpy(data + sizeof(header), &headerV2, sizeof(headerV2));
 
+  FILE* fp = fopen(path.c_str(), "wb");
+  if (!fp)
+    return false;
+  const bool success = fwrite(data, buffer.size(), 1, fp) == 1;
   fclose(fp);
 
-  return true;
+  return success;
 }
 
 void esp::nav::PathFinder::seed(uint32_t newSeed) {
-  // TODO: this should be using core::Random instead, but passing function
-  // to navQuery_->findRandomPoint needs to be figured out first
-  srand(newSeed);
+  seed_ = newSeed;
+  if (queryPool_)
+    queryPool_->seed(newSeed);
 }
 
-// Returns a random number [0..1]
-static float frand() {
-  return (float)rand() / (float)RAND_MAX;
+namespace {
+// findRandomPoint only takes a plain function pointer, so the random stream
+// of the query doing the sampling is passed through a thread local
+thread_local esp::core::Random* currentRandom = nullptr;
+
+// Returns a random number [0..1)
+float frand() {
+  return currentRandom->uniform_float_01();
 }
+}  // namespace
 
 vec3f esp::nav::PathFinder::getRandomNavigablePoint() {
+  auto query = queryPool_->acquire();
+  currentRandom = &query.random();
+
   dtPolyRef ref;
   vec3f pt;
-  dtStatus status = navQuery_->findRandomPoint(filter_, frand, &ref, pt.data());
+  dtStatus status =
+      query.navQuery()->findRandomPoint(filter_, frand, &ref, pt.data());
   if (!dtStatusSucceed(status)) {
     LOG(ERROR) << "Failed to getRandomNavigablePoint";
   }
   return pt;
 }
 
+bool esp::nav::PathFinder::getRandomNavigablePoints(
+    int numPoints,
+    core::Random& random,
+    std::vector<vec3f>& points,
+    float minIslandRadius,
+    bool largestIslandOnly) const {
+  if (!sampler_) {
+    LOG(ERROR) << "getRandomNavigablePoints: no navmesh loaded";
+    return false;
+  }
+  if (!sampler_->sample(numPoints, random, queryPool_->acquire().navQuery(),
+                        minIslandRadius, largestIslandOnly, &points)) {
+    LOG(ERROR) << "getRandomNavigablePoints: no island with a radius of at "
+                  "least "
+               << minIslandRadius;
+    return false;
+  }
+  return true;
+}
+
 bool esp::nav::PathFinder::findPath(ShortestPath& path) {
+  return findPath(path, queryPool_->acquire().navQuery());
+}
+
+bool esp::nav::PathFinder::findPath(MultiGoalShortestPath& path) {
+  return findPath(path, queryPool_->acquire().navQuery());
+}
+
+void esp::nav::PathFinder::findPaths(std::vector<ShortestPath>& paths) {
+  if (!navMesh_) {
+    LOG(ERROR) << "findPaths called without a loaded navmesh";
+    for (auto& path : paths) {
+      path.points.clear();
+      path.geodesicDistance = std::numeric_limits<float>::infinity();
+    }
+    return;
+  }
+
+  const int numPaths = paths.size();
+  const int numWorkers = std::max(
+      1, std::min<int>(numPaths, std::thread::hardware_concurrency()));
+
+  // Workers pull paths off of a shared counter so that a few long queries
+  // don't leave the other workers idle
+  std::atomic<int> nextPath{0};
+#pragma omp parallel for schedule(static, 1)
+  for (int iWorker = 0; iWorker < numWorkers; ++iWorker) {
+    if (nextPath.load() >= numPaths)
+      continue;
+
+    // Every worker holds on to its own query object for the whole batch
+    auto query = queryPool_->acquire();
+    for (int iPath = nextPath++; iPath < numPaths; iPath = nextPath++) {
+      findPath(paths[iPath], query.navQuery());
+    }
+  }
+}
+
+bool esp::nav::PathFinder::findPath(ShortestPath& path,
+                                    dtNavMeshQuery* navQuery) {
   MultiGoalShortestPath tmp;
   tmp.requestedStart = path.requestedStart;
   tmp.requestedEnds.assign({path.requestedEnd});
 
-  bool status = findPath(tmp);
+  bool status = findPath(tmp, navQuery);
 
   path.points.assign(tmp.points.begin(), tmp.points.end());
   path.geodesicDistance = tmp.geodesicDistance;
@@ -728,20 +2572,62 @@ bool esp::nav::PathFinder::findPath(ShortestPath& path) {
   return status;
 }
 
-bool esp::nav::PathFinder::findPath(MultiGoalShortestPath& path) {
-  // initialize
-  static const int MAX_POLYS = 256;
-  dtPolyRef polys[MAX_POLYS];
+bool esp::nav::PathFinder::findPath(MultiGoalShortestPath& path,
+                                    dtNavMeshQuery* navQuery) {
   path.geodesicDistance = std::numeric_limits<float>::infinity();
-  dtPolyRef startRef;
+  path.points.clear();
 
-  // find nearest polys and path
-  vec3f pathStart;
+  impl::PolyPath polyPath;
+  if (!findPolyPath(path.requestedStart, path.requestedEnds, navQuery,
+                    &polyPath)) {
+    return false;
+  }
+  const std::vector<dtPolyRef>& polys = polyPath.polys;
+
+  // trivial path (start is same as end)
+  const vec3f& closestRequestedEnd = path.requestedEnds[polyPath.goalIdx];
+  if (closestRequestedEnd.isApprox(path.requestedStart)) {
+    path.geodesicDistance = 0;
+    return true;
+  }
+
+  // Corners of the straight path are polygon vertices, and every portal of
+  // the corridor has at most one on it
   int numPoints = 0;
-  int numPolys = 0;
+  path.points.resize(polys.size() + 2);
+  dtStatus status = navQuery->findStraightPath(
+      path.requestedStart.data(), closestRequestedEnd.data(), polys.data(),
+      polys.size(), path.points[0].data(), 0, 0, &numPoints,
+      path.points.size());
+  if (status != DT_SUCCESS || numPoints == 0) {
+    path.points.clear();
+    return false;
+  }
+
+  // resize down to number of waypoints and compute distance
+  path.points.resize(numPoints);
+  path.geodesicDistance = 0;
+  for (int i = 1; i < numPoints; i++) {
+    path.geodesicDistance += (path.points[i] - path.points[i - 1]).norm();
+  }
+  return true;
+}
+
+bool esp::nav::PathFinder::findPolyPath(const vec3f& start,
+                                        const std::vector<vec3f>& ends,
+                                        dtNavMeshQuery* navQuery,
+                                        impl::PolyPath* path) {
+  static const int MAX_POLYS = 256;
+  std::vector<dtPolyRef>* polys = &path->polys;
+  int* goalFoundIdx = &path->goalIdx;
+  polys->clear();
+
+  // find nearest polys
+  dtPolyRef startRef;
+  vec3f pathStart;
   dtStatus status;
   std::tie(status, startRef, pathStart) =
-      projectToPoly(path.requestedStart, navQuery_, filter_);
+      projectToPoly(start, navQuery, filter_, polyGridIndex_);
 
   if (status != DT_SUCCESS || startRef == 0) {
     return false;
@@ -750,11 +2636,11 @@ bool esp::nav::PathFinder::findPath(MultiGoalShortestPath& path) {
   std::vector<vec3f> pathEnds;
   std::vector<float> pathEndsCoords;
   std::vector<dtPolyRef> endRefs;
-  for (const auto& rqEnd : path.requestedEnds) {
+  for (const auto& rqEnd : ends) {
     pathEnds.emplace_back();
     endRefs.emplace_back();
     std::tie(status, endRefs.back(), pathEnds.back()) =
-        projectToPoly(rqEnd, navQuery_, filter_);
+        projectToPoly(rqEnd, navQuery, filter_, polyGridIndex_);
 
     pathEndsCoords.emplace_back(pathEnds.back()[0]);
     pathEndsCoords.emplace_back(pathEnds.back()[1]);
@@ -764,13 +2650,17 @@ bool esp::nav::PathFinder::findPath(MultiGoalShortestPath& path) {
       return false;
     }
   }
+  path->start = pathStart;
 
   // check if trivial path (start is same as end) and early return
-  if (std::find_if(path.requestedEnds.begin(), path.requestedEnds.end(),
-                   [&path](const vec3f& rqEnd) -> bool {
-                     return rqEnd.isApprox(path.requestedStart);
-                   }) != path.requestedEnds.end()) {
-    path.geodesicDistance = 0;
+  auto trivialEnd = std::find_if(ends.begin(), ends.end(),
+                                 [&start](const vec3f& rqEnd) -> bool {
+                                   return rqEnd.isApprox(start);
+                                 });
+  if (trivialEnd != ends.end()) {
+    *goalFoundIdx = trivialEnd - ends.begin();
+    path->end = pathStart;
+    polys->assign({startRef});
     return true;
   }
 
@@ -782,62 +2672,112 @@ bool esp::nav::PathFinder::findPath(MultiGoalShortestPath& path) {
     return false;
   }
 
-  int goalFoundIdx;
-  status = navQuery_->findBidirPathToAny(
-      endRefs.size(), startRef, endRefs.data(), path.requestedStart.data(),
-      pathEndsCoords.data(), filter_, polys, &numPolys, MAX_POLYS,
-      &goalFoundIdx);
-  if (status != DT_SUCCESS) {
+  // A cached corridor is still string pulled with the exact endpoints
+  const bool useCache = pathCache_ && endRefs.size() == 1;
+  impl::PathCache::Key cacheKey;
+  if (useCache)
+    cacheKey =
+        pathCache_->makeKey(startRef, pathStart, endRefs[0], pathEnds[0]);
+  const bool cached = useCache && pathCache_->find(cacheKey, polys);
+  if (cached) {
+    *goalFoundIdx = 0;
+  } else if (clusterGraph_) {
+    if (!clusterGraph_->findPath(startRef, pathStart, endRefs, pathEnds,
+                                 polys, goalFoundIdx)) {
+      return false;
+    }
+  } else {
+    // Long paths can take more polygons than the corridor holds or more
+    // nodes than the query has, grow whichever ran out and search again
+    polys->resize(MAX_POLYS);
+    int numPolys = 0;
+    dtNavMeshQuery* searchQuery = navQuery;
+    dtNavMeshQuery* largeQuery = nullptr;
+    int maxNodes = MAX_NODES;
+    while (true) {
+      status = searchQuery->findBidirPathToAny(
+          endRefs.size(), startRef, endRefs.data(), start.data(),
+          pathEndsCoords.data(), filter_, polys->data(), &numPolys,
+          polys->size(), goalFoundIdx);
+      if (status == (DT_SUCCESS | DT_BUFFER_TOO_SMALL)) {
+        polys->resize(4 * polys->size());
+      } else if ((status & DT_OUT_OF_NODES) && maxNodes < DT_NULL_IDX) {
+        maxNodes = std::min<int>(4 * maxNodes, DT_NULL_IDX);
+        if (!largeQuery)
+          largeQuery = dtAllocNavMeshQuery();
+        if (!largeQuery ||
+            dtStatusFailed(largeQuery->init(navMesh_, maxNodes))) {
+          break;
+        }
+        searchQuery = largeQuery;
+      } else {
+        break;
+      }
+    }
+    dtFreeNavMeshQuery(largeQuery);
+    if (status != DT_SUCCESS) {
+      return false;
+    }
+    polys->resize(numPolys);
+  }
+  if (polys->empty()) {
     return false;
   }
+  if (useCache && !cached)
+    pathCache_->insert(cacheKey, polys->data(), polys->size());
 
-  if (numPolys) {
-    const vec3f& closestRequestedEnd = path.requestedEnds[goalFoundIdx];
+  path->end = pathEnds[*goalFoundIdx];
+  return true;
+}
 
-    path.points.resize(MAX_POLYS);
-    status = navQuery_->findStraightPath(
-        path.requestedStart.data(), closestRequestedEnd.data(), polys, numPolys,
-        path.points[0].data(), 0, 0, &numPoints, MAX_POLYS);
+vec3f esp::nav::PathFinder::tryStep(const Eigen::Ref<const vec3f> start,
+                                    const Eigen::Ref<const vec3f> end) {
+  return tryStep(start, end, queryPool_->acquire().navQuery());
+}
 
-    if (status != DT_SUCCESS) {
-      return false;
-    }
+void esp::nav::PathFinder::trySteps(const std::vector<vec3f>& starts,
+                                    const std::vector<vec3f>& ends,
+                                    std::vector<vec3f>& results) {
+  const int numSteps = std::min(starts.size(), ends.size());
+  results.resize(numSteps);
+  if (!navMesh_) {
+    LOG(ERROR) << "trySteps called without a loaded navmesh";
+    std::copy(ends.begin(), ends.begin() + numSteps, results.begin());
+    return;
   }
 
-  // resize down to number of waypoints and compute distance
-  if (numPoints > 0) {
-    path.points.resize(numPoints);
-    path.geodesicDistance = 0;
-    if (numPoints > 1) {
-      vec3f previousPoint = path.points[0];
-      for (int i = 1; i < path.points.size(); i++) {
-        const vec3f& currentPoint = path.points[i];
-        path.geodesicDistance += (currentPoint - previousPoint).norm();
-        previousPoint = currentPoint;
-      }
+  const int numWorkers = std::max(
+      1, std::min<int>(numSteps, std::thread::hardware_concurrency()));
+
+  // Steps are all about as expensive, so every worker takes a contiguous
+  // block of them and holds on to its own query object for the whole block
+#pragma omp parallel for schedule(static, 1)
+  for (int iWorker = 0; iWorker < numWorkers; ++iWorker) {
+    auto query = queryPool_->acquire();
+    const int blockEnd = (iWorker + 1) * numSteps / numWorkers;
+    for (int iStep = iWorker * numSteps / numWorkers; iStep < blockEnd;
+         ++iStep) {
+      results[iStep] = tryStep(starts[iStep], ends[iStep], query.navQuery());
     }
-    return true;
   }
-
-  return false;
 }
 
-vec3f esp::nav::PathFinder::tryStep(const Eigen::Ref<const vec3f> start,
-                                    const Eigen::Ref<const vec3f> end) {
-  static const int MAX_POLYS = 256;
-  dtPolyRef polys[MAX_POLYS];
+vec3f esp::nav::PathFinder::tryStep(const vec3f& start,
+                                    const vec3f& end,
+                                    dtNavMeshQuery* navQuery) {
+  dtPolyRef polys[MAX_STEP_POLYS];
 
   dtPolyRef startRef, endRef;
   vec3f pathStart, pathEnd;
   std::tie(std::ignore, startRef, pathStart) =
-      projectToPoly(start, navQuery_, filter_);
+      projectToPoly(start, navQuery, filter_, polyGridIndex_);
   std::tie(std::ignore, endRef, pathEnd) =
-      projectToPoly(end, navQuery_, filter_);
+      projectToPoly(end, navQuery, filter_, polyGridIndex_);
   vec3f endPoint;
   int numPolys;
-  navQuery_->moveAlongSurface(startRef, pathStart.data(), pathEnd.data(),
-                              filter_, endPoint.data(), polys, &numPolys,
-                              MAX_POLYS);
+  navQuery->moveAlongSurface(startRef, pathStart.data(), pathEnd.data(),
+                             filter_, endPoint.data(), polys, &numPolys,
+                             MAX_STEP_POLYS);
 
   // Hack to deal with infinitely thin walls in recast allowing you to
   // transition between two different connected components
@@ -845,7 +2785,7 @@ vec3f esp::nav::PathFinder::tryStep(const Eigen::Ref<const vec3f> start,
   // is in the same connected component as the startRef according to
   // findNearestPoly
   std::tie(std::ignore, endRef, std::ignore) =
-      projectToPoly(endPoint, navQuery_, filter_);
+      projectToPoly(endPoint, navQuery, filter_, polyGridIndex_);
   if (!this->islandSystem_->hasConnection(startRef, endRef)) {
     // There isn't a connection!  This happens when endPoint is on an edge
     // shared between two different connected components (aka infinitely thin
@@ -872,10 +2812,95 @@ vec3f esp::nav::PathFinder::tryStep(const Eigen::Ref<const vec3f> start,
   return endPoint;
 }
 
+esp::nav::RaycastHit esp::nav::PathFinder::raycast(const vec3f& start,
+                                                   const vec3f& end) {
+  if (!navMesh_) {
+    LOG(ERROR) << "raycast called without a loaded navmesh";
+    return {start, vec3f::Zero(), 0, false};
+  }
+  return raycast(start, end, queryPool_->acquire().navQuery());
+}
+
+void esp::nav::PathFinder::raycasts(const std::vector<vec3f>& starts,
+                                    const std::vector<vec3f>& ends,
+                                    std::vector<RaycastHit>& results) {
+  const int numRays = std::min(starts.size(), ends.size());
+  results.resize(numRays);
+  if (!navMesh_) {
+    LOG(ERROR) << "raycasts called without a loaded navmesh";
+    for (int i = 0; i < numRays; ++i)
+      results[i] = {starts[i], vec3f::Zero(), 0, false};
+    return;
+  }
+
+  const int numWorkers = std::max(
+      1, std::min<int>(numRays, std::thread::hardware_concurrency()));
+#pragma omp parallel for schedule(static, 1)
+  for (int iWorker = 0; iWorker < numWorkers; ++iWorker) {
+    auto query = queryPool_->acquire();
+    const int blockEnd = (iWorker + 1) * numRays / numWorkers;
+    for (int iRay = iWorker * numRays / numWorkers; iRay < blockEnd; ++iRay) {
+      results[iRay] = raycast(starts[iRay], ends[iRay], query.navQuery());
+    }
+  }
+}
+
+esp::nav::RaycastHit esp::nav::PathFinder::raycast(const vec3f& start,
+                                                   const vec3f& end,
+                                                   dtNavMeshQuery* navQuery) {
+  dtStatus status;
+  dtPolyRef startRef, endRef;
+  vec3f rayStart, rayEnd;
+  std::tie(status, startRef, rayStart) =
+      projectToPoly(start, navQuery, filter_, polyGridIndex_);
+  if (status != DT_SUCCESS || startRef == 0)
+    return {start, vec3f::Zero(), 0, false};
+  std::tie(std::ignore, endRef, rayEnd) =
+      projectToPoly(end, navQuery, filter_, polyGridIndex_);
+  // An end off the navmesh is still a direction to cast the ray in
+  if (endRef == 0)
+    rayEnd = end;
+
+  // The polygons the ray crosses, the last one tells which floor it ends on
+  std::vector<dtPolyRef> polys(MAX_STEP_POLYS);
+  float t;
+  RaycastHit hit;
+  int numPolys;
+  for (;;) {
+    status = navQuery->raycast(startRef, rayStart.data(), rayEnd.data(),
+                               filter_, &t, hit.hitNormal.data(), polys.data(),
+                               &numPolys, polys.size());
+    if (!dtStatusDetail(status, DT_BUFFER_TOO_SMALL))
+      break;
+    polys.resize(4 * polys.size());
+  }
+  if (dtStatusFailed(status) || numPolys == 0)
+    return {rayStart, vec3f::Zero(), 0, false};
+
+  // Detour raycasts in 2D, the height comes from the polygon the ray ended on
+  const dtPolyRef lastRef = polys[numPolys - 1];
+  hit.reached = t == std::numeric_limits<float>::max() && lastRef == endRef;
+  if (hit.reached) {
+    hit.hitPos = rayEnd;
+  } else {
+    const vec3f hitPos = rayStart + std::min(t, 1.0f) * (rayEnd - rayStart);
+    navQuery->closestPointOnPoly(lastRef, hitPos.data(), hit.hitPos.data(),
+                                 nullptr);
+  }
+  if (t == std::numeric_limits<float>::max())
+    hit.hitNormal = vec3f::Zero();
+  hit.hitDist = (hit.hitPos - rayStart).norm();
+  return hit;
+}
+
 float esp::nav::PathFinder::islandRadius(const vec3f& pt) const {
+  auto query = queryPool_->acquire();
+  dtNavMeshQuery* navQuery = query.navQuery();
+
   dtPolyRef ptRef;
   dtStatus status;
-  std::tie(status, ptRef, std::ignore) = projectToPoly(pt, navQuery_, filter_);
+  std::tie(status, ptRef, std::ignore) =
+      projectToPoly(pt, navQuery, filter_, polyGridIndex_);
   if (status != DT_SUCCESS || ptRef == 0) {
     return 0.0;
   } else {
@@ -883,6 +2908,19 @@ float esp::nav::PathFinder::islandRadius(const vec3f& pt) const {
   }
 }
 
+float esp::nav::PathFinder::islandArea(const vec3f& pt) const {
+  dtPolyRef ptRef;
+  dtStatus status;
+  std::tie(status, ptRef, std::ignore) =
+      projectToPoly(pt, queryPool_->acquire().navQuery(), filter_,
+                    polyGridIndex_);
+  if (status != DT_SUCCESS || ptRef == 0) {
+    return 0.0;
+  } else {
+    return islandSystem_->islandArea(ptRef);
+  }
+}
+
 float esp::nav::PathFinder::distanceToClosestObstacle(
     const vec3f& pt,
     const float maxSearchRadius /*= 2.0*/) const {
@@ -892,29 +2930,46 @@ float esp::nav::PathFinder::distanceToClosestObstacle(
 esp::nav::HitRecord esp::nav::PathFinder::closestObstacleSurfacePoint(
     const vec3f& pt,
     const float maxSearchRadius /*= 2.0*/) const {
+  HitRecord hit;
+  if (obstacleDistanceGrid_ &&
+      obstacleDistanceGrid_->closestObstacleSurfacePoint(pt, maxSearchRadius,
+                                                         &hit))
+    return hit;
+
+  auto query = queryPool_->acquire();
+  dtNavMeshQuery* navQuery = query.navQuery();
+
   dtPolyRef ptRef;
   dtStatus status;
   vec3f polyPt;
-  std::tie(status, ptRef, polyPt) = projectToPoly(pt, navQuery_, filter_);
+  std::tie(status, ptRef, polyPt) =
+      projectToPoly(pt, navQuery, filter_, polyGridIndex_);
   if (status != DT_SUCCESS || ptRef == 0) {
     return {vec3f(0, 0, 0), vec3f(0, 0, 0),
             std::numeric_limits<float>::infinity()};
   } else {
     vec3f hitPos, hitNormal;
     float hitDist;
-    navQuery_->findDistanceToWall(ptRef, polyPt.data(), maxSearchRadius,
-                                  filter_, &hitDist, hitPos.data(),
-                                  hitNormal.data());
+    navQuery->findDistanceToWall(ptRef, polyPt.data(), maxSearchRadius,
+                                 filter_, &hitDist, hitPos.data(),
+                                 hitNormal.data());
+    // Detour leaves hitPos uninitialized if there is no wall within reach
+    if (hitDist >= maxSearchRadius)
+      return {polyPt, vec3f(0, 0, 0), hitDist};
     return {hitPos, hitNormal, hitDist};
   }
 }
 
 bool esp::nav::PathFinder::isNavigable(const vec3f& pt,
                                        const float maxYDelta /*= 0.5*/) const {
+  auto query = queryPool_->acquire();
+  dtNavMeshQuery* navQuery = query.navQuery();
+
   dtPolyRef ptRef;
   dtStatus status;
   vec3f polyPt;
-  std::tie(status, ptRef, polyPt) = projectToPoly(pt, navQuery_, filter_);
+  std::tie(status, ptRef, polyPt) =
+      projectToPoly(pt, navQuery, filter_, polyGridIndex_);
 
   if (status != DT_SUCCESS || ptRef == 0)
     return false;
@@ -926,3 +2981,587 @@ bool esp::nav::PathFinder::isNavigable(const vec3f& pt,
 
   return true;
 }
+
+box3f esp::nav::PathFinder::getNavMeshBounds() const {
+  box3f bounds;
+  if (!navMesh_)
+    return bounds;
+  const dtNavMesh* navMesh = navMesh_;
+  for (int iTile = 0; iTile < navMesh->getMaxTiles(); ++iTile) {
+    const dtMeshTile* tile = navMesh->getTile(iTile);
+    if (!tile->header)
+      continue;
+    bounds.extend(Eigen::Map<const vec3f>(tile->header->bmin));
+    bounds.extend(Eigen::Map<const vec3f>(tile->header->bmax));
+  }
+  return bounds;
+}
+
+namespace {
+// Sets the pixels of view whose centers lie in the x-z projection of the
+// triangle (a, b, c) and whose height on it is within maxYDelta of height.
+// Pixels on an edge are set by both of its triangles, so there are no gaps
+// between them
+void rasterizeTriangle(const vec3f& a,
+                       const vec3f& b,
+                       const vec3f& c,
+                       const vec3f& origin,
+                       float metersPerPixel,
+                       float height,
+                       float maxYDelta,
+                       esp::nav::TopDownView* view) {
+  if (std::min({a[1], b[1], c[1]}) > height + maxYDelta ||
+      std::max({a[1], b[1], c[1]}) < height - maxYDelta)
+    return;
+  const float area =
+      (b[0] - a[0]) * (c[2] - a[2]) - (c[0] - a[0]) * (b[2] - a[2]);
+  if (area == 0)
+    return;
+
+  // Pixel centers are at origin + (i + 0.5) * metersPerPixel.  Centers on a
+  // triangle edge count as inside, navmesh vertices often lie on the pixel
+  // grid, so the tests allow for rounding
+  constexpr float kEps = 1e-4f;
+  auto firstPixel = [&](float coord, int axis) {
+    return std::max<int>(
+        std::ceil((coord - origin[axis]) / metersPerPixel - 0.5f - kEps), 0);
+  };
+  auto lastPixel = [&](float coord, int axis, int size) {
+    return std::min<int>(
+        std::floor((coord - origin[axis]) / metersPerPixel - 0.5f + kEps),
+        size - 1);
+  };
+  const int col0 = firstPixel(std::min({a[0], b[0], c[0]}), 0);
+  const int col1 = lastPixel(std::max({a[0], b[0], c[0]}), 0, view->cols());
+  const int row0 = firstPixel(std::min({a[2], b[2], c[2]}), 2);
+  const int row1 = lastPixel(std::max({a[2], b[2], c[2]}), 2, view->rows());
+  for (int row = row0; row <= row1; ++row) {
+    const float z = origin[2] + (row + 0.5f) * metersPerPixel;
+    for (int col = col0; col <= col1; ++col) {
+      const float x = origin[0] + (col + 0.5f) * metersPerPixel;
+      // Barycentric coordinates of the pixel center
+      const float u =
+          ((c[0] - b[0]) * (z - b[2]) - (x - b[0]) * (c[2] - b[2])) / area;
+      const float v =
+          ((a[0] - c[0]) * (z - c[2]) - (x - c[0]) * (a[2] - c[2])) / area;
+      const float w = 1 - u - v;
+      if (u < -kEps || v < -kEps || w < -kEps)
+        continue;
+      if (std::abs(u * a[1] + v * b[1] + w * c[1] - height) <= maxYDelta)
+        (*view)(row, col) = 1;
+    }
+  }
+}
+}  // namespace
+
+esp::nav::TopDownView esp::nav::PathFinder::getTopDownView(
+    float metersPerPixel,
+    float height,
+    float maxYDelta /*= 0.5*/) const {
+  return getTopDownViews(metersPerPixel, {height}, maxYDelta)[0];
+}
+
+std::vector<esp::nav::TopDownView> esp::nav::PathFinder::getTopDownViews(
+    float metersPerPixel,
+    const std::vector<float>& heights,
+    float maxYDelta /*= 0.5*/) const {
+  const box3f bounds = getNavMeshBounds();
+  if (bounds.isEmpty() || metersPerPixel <= 0) {
+    LOG(ERROR) << "getTopDownViews needs a navmesh and metersPerPixel > 0";
+    return std::vector<TopDownView>(heights.size());
+  }
+  const vec3f origin = bounds.min();
+  const int numRows = std::ceil((bounds.max()[2] - origin[2]) / metersPerPixel);
+  const int numCols = std::ceil((bounds.max()[0] - origin[0]) / metersPerPixel);
+
+  const dtNavMesh* navMesh = navMesh_;
+  const int numViews = heights.size();
+  std::vector<TopDownView> views(numViews);
+#pragma omp parallel for schedule(dynamic, 1)
+  for (int iView = 0; iView < numViews; ++iView) {
+    TopDownView& view = views[iView];
+    view.setZero(numRows, numCols);
+    for (int iTile = 0; iTile < navMesh->getMaxTiles(); ++iTile) {
+      const dtMeshTile* tile = navMesh->getTile(iTile);
+      if (!tile->header)
+        continue;
+
+      const dtPolyRef base = navMesh->getPolyRefBase(tile);
+      for (int jPoly = 0; jPoly < tile->header->polyCount; ++jPoly) {
+        const dtPoly* poly = &tile->polys[jPoly];
+        if (poly->getType() != DT_POLYTYPE_GROUND ||
+            !filter_->passFilter(base | jPoly, tile, poly))
+          continue;
+
+        // The detail mesh has the heights isNavigable snaps to
+        const dtPolyDetail& detail = tile->detailMeshes[jPoly];
+        auto vert = [&](unsigned char k) {
+          return Eigen::Map<const vec3f>(
+              k < poly->vertCount
+                  ? &tile->verts[poly->verts[k] * 3]
+                  : &tile->detailVerts[(detail.vertBase + k -
+                                        poly->vertCount) *
+                                       3]);
+        };
+        for (int k = 0; k < detail.triCount; ++k) {
+          const unsigned char* tri =
+              &tile->detailTris[(detail.triBase + k) * 4];
+          rasterizeTriangle(vert(tri[0]), vert(tri[1]), vert(tri[2]), origin,
+                            metersPerPixel, heights[iView], maxYDelta,
+                            &view);
+        }
+      }
+    }
+  }
+  return views;
+}
+
+vec3f esp::nav::PathFinder::snapPoint(const vec3f& pt) const {
+  dtPolyRef ptRef;
+  dtStatus status;
+  vec3f polyPt;
+  std::tie(status, ptRef, polyPt) =
+      projectToPoly(pt, queryPool_->acquire().navQuery(), filter_,
+                    polyGridIndex_);
+  if (status != DT_SUCCESS || ptRef == 0)
+    return vec3f::Constant(std::numeric_limits<float>::quiet_NaN());
+
+  return polyPt;
+}
+
+void esp::nav::PathFinder::snapPoints(const std::vector<vec3f>& points,
+                                      std::vector<vec3f>& results) const {
+  results.assign(points.size(),
+                 vec3f::Constant(std::numeric_limits<float>::quiet_NaN()));
+  if (!navMesh_) {
+    LOG(ERROR) << "snapPoints called without a loaded navmesh";
+    return;
+  }
+
+  const int numPoints = points.size();
+  const int numWorkers = std::max(
+      1, std::min<int>(numPoints, std::thread::hardware_concurrency()));
+#pragma omp parallel for schedule(static, 1)
+  for (int iWorker = 0; iWorker < numWorkers; ++iWorker) {
+    auto query = queryPool_->acquire();
+    const int blockEnd = (iWorker + 1) * numPoints / numWorkers;
+    for (int i = iWorker * numPoints / numWorkers; i < blockEnd; ++i) {
+      dtPolyRef ptRef;
+      dtStatus status;
+      vec3f polyPt;
+      std::tie(status, ptRef, polyPt) =
+          projectToPoly(points[i], query.navQuery(), filter_, polyGridIndex_);
+      if (status == DT_SUCCESS && ptRef != 0)
+        results[i] = polyPt;
+    }
+  }
+}
+
+std::shared_ptr<const esp::nav::impl::GeodesicDistanceField>
+esp::nav::PathFinder::getDistanceField(const std::vector<vec3f>& goals) {
+  {
+    std::lock_guard<std::mutex> lock(distanceFieldCacheMutex_);
+    auto it = std::find_if(
+        distanceFieldCache_.begin(), distanceFieldCache_.end(),
+        [&goals](const DistanceFieldCacheEntry& entry) -> bool {
+          return entry.first == goals;
+        });
+    if (it != distanceFieldCache_.end()) {
+      distanceFieldCache_.splice(distanceFieldCache_.begin(),
+                                 distanceFieldCache_, it);
+      return it->second;
+    }
+  }
+
+  // Build outside of the lock so lookups into other fields aren't blocked
+  std::vector<impl::GeodesicDistanceField::PolyPoint> snappedGoals;
+  {
+    auto query = queryPool_->acquire();
+    for (const vec3f& goal : goals) {
+      dtStatus status;
+      dtPolyRef goalRef;
+      vec3f goalPt;
+      std::tie(status, goalRef, goalPt) =
+          projectToPoly(goal, query.navQuery(), filter_, polyGridIndex_);
+      if (status == DT_SUCCESS && goalRef != 0)
+        snappedGoals.emplace_back(goalRef, goalPt);
+    }
+  }
+  auto field = std::make_shared<const impl::GeodesicDistanceField>(
+      navMesh_, filter_, snappedGoals);
+
+  std::lock_guard<std::mutex> lock(distanceFieldCacheMutex_);
+  distanceFieldCache_.emplace_front(goals, field);
+  while (distanceFieldCache_.size() > distanceFieldCacheSize_)
+    distanceFieldCache_.pop_back();
+
+  return field;
+}
+
+void esp::nav::PathFinder::clearDistanceFieldCache() {
+  std::lock_guard<std::mutex> lock(distanceFieldCacheMutex_);
+  distanceFieldCache_.clear();
+  // Object goals outlive the navmesh, their fields are rebuilt on next use
+  for (auto& entry : objectGoals_) {
+    auto goals = std::make_shared<ObjectGoals>(*entry.second);
+    goals->field = nullptr;
+    entry.second = goals;
+  }
+}
+
+void esp::nav::PathFinder::setDistanceFieldCacheSize(int cacheSize) {
+  std::lock_guard<std::mutex> lock(distanceFieldCacheMutex_);
+  distanceFieldCacheSize_ = std::max(cacheSize, 0);
+  while (distanceFieldCache_.size() > distanceFieldCacheSize_)
+    distanceFieldCache_.pop_back();
+}
+
+float esp::nav::PathFinder::geodesicDistanceToGoals(
+    const vec3f& pt,
+    const std::vector<vec3f>& goals) {
+  auto field = getDistanceField(goals);
+
+  dtPolyRef ptRef;
+  dtStatus status;
+  vec3f polyPt;
+  std::tie(status, ptRef, polyPt) =
+      projectToPoly(pt, queryPool_->acquire().navQuery(), filter_,
+                    polyGridIndex_);
+  if (status != DT_SUCCESS || ptRef == 0)
+    return std::numeric_limits<float>::infinity();
+
+  return field->distance(ptRef, polyPt);
+}
+
+namespace {
+// The navmesh can lie a little above the floor an object stands on
+constexpr float kObjectGoalHeightSlack = 0.5;
+// Spacing of the points sampled on the polygons near an object
+constexpr float kObjectGoalSpacing = 0.25;
+
+// Whether the navigable point pt is within radius of the footprint of obb
+// and not too far below or above it
+bool reachesObject(const esp::geo::OBB& obb,
+                   const box3f& aabb,
+                   const vec3f& pt,
+                   float radius,
+                   float maxYDelta) {
+  if (pt[1] < aabb.min()[1] - maxYDelta ||
+      pt[1] > aabb.max()[1] + kObjectGoalHeightSlack)
+    return false;
+  // Level with the box, the distance to it is the one to its footprint
+  vec3f level = pt;
+  level[1] = std::min(std::max(pt[1], aabb.min()[1]), aabb.max()[1]);
+  return obb.distance(level) <= radius;
+}
+
+// Appends the navigable points that reach obb on the polygons under it to
+// goalPoints: the closest point of each polygon to the center of obb and the
+// points of a grid over its surroundings
+void findObjectGoalPoints(
+    const dtNavMeshQuery* navQuery,
+    const dtQueryFilter* filter,
+    const esp::geo::OBB& obb,
+    float radius,
+    float maxYDelta,
+    std::vector<nav::impl::GeodesicDistanceField::PolyPoint>* goalPoints) {
+  const box3f aabb = obb.toAABB();
+  const float minY = aabb.min()[1] - maxYDelta;
+  const float maxY = aabb.max()[1] + kObjectGoalHeightSlack;
+  vec3f center = aabb.center();
+  center[1] = 0.5f * (minY + maxY);
+  const vec3f halfExtents(0.5f * aabb.sizes()[0] + radius, 0.5f * (maxY - minY),
+                          0.5f * aabb.sizes()[2] + radius);
+
+  constexpr int kMaxPolys = 512;
+  dtPolyRef polys[kMaxPolys];
+  int numPolys = 0;
+  navQuery->queryPolygons(center.data(), halfExtents.data(), filter, polys,
+                          &numPolys, kMaxPolys);
+
+  const int numSteps =
+      std::ceil(2 * std::max(halfExtents[0], halfExtents[2]) /
+                kObjectGoalSpacing);
+  for (int iPoly = 0; iPoly < numPolys; ++iPoly) {
+    vec3f pt;
+    if (dtStatusSucceed(navQuery->closestPointOnPoly(
+            polys[iPoly], obb.center().data(), pt.data(), nullptr)) &&
+        reachesObject(obb, aabb, pt, radius, maxYDelta))
+      goalPoints->emplace_back(polys[iPoly], pt);
+
+    for (int i = 0; i <= numSteps; ++i) {
+      for (int j = 0; j <= numSteps; ++j) {
+        const vec3f gridPt =
+            center - halfExtents +
+            vec3f(2 * halfExtents[0] * i / numSteps, halfExtents[1],
+                  2 * halfExtents[2] * j / numSteps);
+        bool posOverPoly = false;
+        if (dtStatusSucceed(navQuery->closestPointOnPoly(
+                polys[iPoly], gridPt.data(), pt.data(), &posOverPoly)) &&
+            posOverPoly && reachesObject(obb, aabb, pt, radius, maxYDelta))
+          goalPoints->emplace_back(polys[iPoly], pt);
+      }
+    }
+  }
+}
+}  // namespace
+
+bool esp::nav::PathFinder::setObjectGoals(const std::string& name,
+                                          const std::vector<geo::OBB>& objects,
+                                          float radius /*= 1.0*/,
+                                          float maxYDelta /*= 1.5*/) {
+  if (!navMesh_) {
+    LOG(ERROR) << "setObjectGoals called without a loaded navmesh";
+    return false;
+  }
+
+  std::vector<impl::GeodesicDistanceField::PolyPoint> goalPoints;
+  {
+    auto query = queryPool_->acquire();
+    for (const geo::OBB& obb : objects)
+      findObjectGoalPoints(query.navQuery(), filter_, obb, radius, maxYDelta,
+                           &goalPoints);
+  }
+  if (goalPoints.empty()) {
+    LOG(WARNING) << "setObjectGoals: no navigable point reaches any of the "
+                 << objects.size() << " objects of " << name;
+    return false;
+  }
+
+  auto goals = std::make_shared<ObjectGoals>();
+  goals->objects = objects;
+  goals->radius = radius;
+  goals->maxYDelta = maxYDelta;
+  goals->field = std::make_shared<const impl::GeodesicDistanceField>(
+      navMesh_, filter_, goalPoints);
+
+  std::lock_guard<std::mutex> lock(distanceFieldCacheMutex_);
+  objectGoals_[name] = goals;
+  return true;
+}
+
+bool esp::nav::PathFinder::setCategoryGoals(
+    const scene::SemanticScene& semanticScene,
+    const std::string& category,
+    float radius /*= 1.0*/,
+    float maxYDelta /*= 1.5*/) {
+  std::vector<geo::OBB> objects;
+  for (const auto& object : semanticScene.objects()) {
+    if (object && object->category() &&
+        object->category()->name() == category)
+      objects.push_back(object->obb());
+  }
+  return setObjectGoals(category, objects, radius, maxYDelta);
+}
+
+float esp::nav::PathFinder::geodesicDistanceToObjects(
+    const vec3f& pt,
+    const std::string& name) {
+  std::shared_ptr<const ObjectGoals> goals;
+  {
+    std::lock_guard<std::mutex> lock(distanceFieldCacheMutex_);
+    auto it = objectGoals_.find(name);
+    if (it != objectGoals_.end())
+      goals = it->second;
+  }
+  if (!goals || !navMesh_)
+    return std::numeric_limits<float>::infinity();
+
+  auto query = queryPool_->acquire();
+  if (!goals->field) {
+    // The navmesh changed since the goals were set
+    std::vector<impl::GeodesicDistanceField::PolyPoint> goalPoints;
+    for (const geo::OBB& obb : goals->objects)
+      findObjectGoalPoints(query.navQuery(), filter_, obb, goals->radius,
+                           goals->maxYDelta, &goalPoints);
+    auto rebuilt = std::make_shared<ObjectGoals>(*goals);
+    rebuilt->field = std::make_shared<const impl::GeodesicDistanceField>(
+        navMesh_, filter_, goalPoints);
+
+    std::lock_guard<std::mutex> lock(distanceFieldCacheMutex_);
+    auto it = objectGoals_.find(name);
+    if (it != objectGoals_.end() && it->second == goals)
+      it->second = rebuilt;
+    goals = rebuilt;
+  }
+
+  dtPolyRef ptRef;
+  dtStatus status;
+  vec3f polyPt;
+  std::tie(status, ptRef, polyPt) =
+      projectToPoly(pt, query.navQuery(), filter_, polyGridIndex_);
+  if (status != DT_SUCCESS || ptRef == 0)
+    return std::numeric_limits<float>::infinity();
+
+  for (const geo::OBB& obb : goals->objects) {
+    if (reachesObject(obb, obb.toAABB(), polyPt, goals->radius,
+                      goals->maxYDelta))
+      return 0;
+  }
+  return goals->field->distance(ptRef, polyPt);
+}
+
+Eigen::MatrixXf esp::nav::PathFinder::geodesicDistanceMatrix(
+    const std::vector<vec3f>& points,
+    bool refine) {
+  const int numPoints = points.size();
+  Eigen::MatrixXf distances = Eigen::MatrixXf::Constant(
+      numPoints, numPoints, std::numeric_limits<float>::infinity());
+  if (!navMesh_) {
+    LOG(ERROR) << "geodesicDistanceMatrix called without a loaded navmesh";
+    return distances;
+  }
+
+  std::vector<impl::GeodesicDistanceField::PolyPoint> snapped(numPoints);
+  {
+    auto query = queryPool_->acquire();
+    for (int i = 0; i < numPoints; ++i) {
+      dtStatus status;
+      std::tie(status, snapped[i].first, snapped[i].second) = projectToPoly(
+          points[i], query.navQuery(), filter_, polyGridIndex_);
+      if (status != DT_SUCCESS)
+        snapped[i].first = 0;
+    }
+  }
+
+  // The nodes in line of sight of every point and their distance to it: the
+  // vertices of its polygon and the border vertices a ray gets to
+  const impl::NavMeshGraph graph(navMesh_, filter_);
+  std::vector<std::vector<std::pair<int, float>>> visible(numPoints);
+#pragma omp parallel for schedule(dynamic, 1)
+  for (int i = 0; i < numPoints; ++i) {
+    if (snapped[i].first == 0)
+      continue;
+    const vec3f& pt = snapped[i].second;
+    const dtMeshTile* tile = 0;
+    const dtPoly* poly = 0;
+    navMesh_->getTileAndPolyByRefUnsafe(snapped[i].first, &tile, &poly);
+    const unsigned int iTile = navMesh_->decodePolyIdTile(snapped[i].first);
+    for (int iVert = 0; iVert < poly->vertCount; ++iVert) {
+      const int node = graph.nodeIndex(iTile, poly->verts[iVert]);
+      visible[i].emplace_back(node, (graph.nodePos(node) - pt).norm());
+    }
+
+    auto query = queryPool_->acquire();
+    dtPolyRef polys[MAX_STEP_POLYS];
+    for (int node : graph.borderNodes()) {
+      const vec3f& nodePos = graph.nodePos(node);
+      float t;
+      vec3f hitNormal;
+      int numPolys;
+      const dtStatus status = query.navQuery()->raycast(
+          snapped[i].first, pt.data(), nodePos.data(), filter_, &t,
+          hitNormal.data(), polys, &numPolys, MAX_STEP_POLYS);
+      if (dtStatusFailed(status) ||
+          dtStatusDetail(status, DT_BUFFER_TOO_SMALL) || numPolys == 0)
+        continue;
+      // The vertex is on the border, so the ray may stop right before it
+      const float dist = (nodePos - pt).norm();
+      if (t != std::numeric_limits<float>::max() &&
+          t * dist < dist - kVertexSightSlack)
+        continue;
+      // Detour raycasts in 2D, the ray has to end on a polygon of the vertex
+      const dtMeshTile* lastTile = 0;
+      const dtPoly* lastPoly = 0;
+      navMesh_->getTileAndPolyByRefUnsafe(polys[numPolys - 1], &lastTile,
+                                          &lastPoly);
+      const unsigned int lastTileIdx =
+          navMesh_->decodePolyIdTile(polys[numPolys - 1]);
+      for (int iVert = 0; iVert < lastPoly->vertCount; ++iVert) {
+        if (graph.nodeIndex(lastTileIdx, lastPoly->verts[iVert]) == node) {
+          visible[i].emplace_back(node, dist);
+          break;
+        }
+      }
+    }
+  }
+
+  // Column i holds the distances from point i, Eigen is column major.  The
+  // search from point i starts at the nodes in its sight and every other
+  // point is looked up through the nodes in its own sight
+#pragma omp parallel for schedule(dynamic, 1)
+  for (int i = 0; i < numPoints; ++i) {
+    if (snapped[i].first == 0)
+      continue;
+    std::vector<float> nodeDist(graph.numNodes(),
+                                std::numeric_limits<float>::infinity());
+    for (const auto& seed : visible[i])
+      nodeDist[seed.first] = std::min(nodeDist[seed.first], seed.second);
+    graph.shortestDistances(&nodeDist);
+
+    for (int j = 0; j < numPoints; ++j) {
+      if (snapped[j].first == 0)
+        continue;
+      if (snapped[j].first == snapped[i].first) {
+        // Polygons are convex
+        distances(j, i) = (snapped[i].second - snapped[j].second).norm();
+        continue;
+      }
+      for (const auto& seed : visible[j])
+        distances(j, i) =
+            std::min(distances(j, i), nodeDist[seed.first] + seed.second);
+    }
+  }
+
+  // Pairs whose distance isn't the straight line yet
+  std::vector<std::pair<int, int>> inexact;
+  for (int i = 0; i < numPoints; ++i) {
+    for (int j = i + 1; j < numPoints; ++j) {
+      const float distance = std::min(distances(i, j), distances(j, i));
+      distances(i, j) = distances(j, i) = distance;
+      const float straight = (snapped[i].second - snapped[j].second).norm();
+      if (refine && distance < std::numeric_limits<float>::infinity() &&
+          distance > straight * (1 + 1e-4f))
+        inexact.emplace_back(i, j);
+    }
+  }
+
+  const int numPairs = inexact.size();
+  const int numWorkers = std::max(
+      1, std::min<int>(numPairs, std::thread::hardware_concurrency()));
+  std::atomic<int> nextPair{0};
+#pragma omp parallel for schedule(static, 1)
+  for (int iWorker = 0; iWorker < numWorkers; ++iWorker) {
+    if (nextPair.load() >= numPairs)
+      continue;
+
+    auto query = queryPool_->acquire();
+    for (int iPair = nextPair++; iPair < numPairs; iPair = nextPair++) {
+      const int i = inexact[iPair].first, j = inexact[iPair].second;
+      float& distance = distances(i, j);
+
+      const RaycastHit hit =
+          raycast(snapped[i].second, snapped[j].second, query.navQuery());
+      if (hit.reached) {
+        distance = hit.hitDist;
+        continue;
+      }
+
+      // Out of sight of each other, the shortest path first bends at a
+      // vertex in sight of point i and last at one in sight of point j.  If
+      // no such two vertices make for a shorter path, even in a straight
+      // line between them, the distance is exact
+      float lowerBound = std::numeric_limits<float>::infinity();
+      for (const auto& first : visible[i]) {
+        const vec3f& firstPos = graph.nodePos(first.first);
+        for (const auto& last : visible[j]) {
+          lowerBound = std::min(
+              lowerBound, first.second + last.second +
+                              (graph.nodePos(last.first) - firstPos).norm());
+        }
+      }
+      if (lowerBound >= distance * (1 - 1e-4f))
+        continue;
+
+      ShortestPath path;
+      path.requestedStart = snapped[i].second;
+      path.requestedEnd = snapped[j].second;
+      if (findPath(path, query.navQuery()))
+        distance = std::min(distance, path.geodesicDistance);
+    }
+  }
+  for (const auto& pair : inexact)
+    distances(pair.second, pair.first) = distances(pair.first, pair.second);
+
+  return distances;
+}
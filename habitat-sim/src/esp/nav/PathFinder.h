@@ -4,10 +4,14 @@
 
 #pragma once
 
+#include <list>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "esp/core/esp.h"
+#include "esp/geo/OBB.h"
 
 // forward declarations
 class dtNavMesh;
@@ -20,6 +24,12 @@ namespace esp {
 namespace assets {
 class MeshData;
 }
+namespace core {
+class Random;
+}
+namespace scene {
+class SemanticScene;
+}
 namespace nav {
 
 struct HitRecord {
@@ -28,9 +38,42 @@ struct HitRecord {
   float hitDist;
 };
 
+//! Top down map of the navmesh, 1 where navigable and 0 elsewhere
+typedef Eigen::Matrix<uint8_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+    TopDownView;
+
+struct RaycastHit {
+  //! Where the ray stopped on the navmesh, the target if it got there
+  vec3f hitPos;
+  //! Normal of the navmesh border the ray hit, zero if nothing was hit
+  vec3f hitNormal;
+  //! Distance from the start of the ray to hitPos
+  float hitDist;
+  //! Whether the ray got to the target without leaving the navmesh
+  bool reached;
+};
+
+//! Counters of the findPath cache, see PathFinder::setPathCacheBudget
+struct PathCacheStats {
+  uint64_t hits;
+  uint64_t misses;
+  //! Number of cached corridors and the memory they take
+  size_t numEntries;
+  size_t numBytes;
+};
+
 namespace impl {
 struct ActionSpaceGraph;
+class GeodesicDistanceField;
+class ClusterGraph;
 class IslandSystem;
+struct NavMeshData;
+class NavMeshSampler;
+class NavQueryPool;
+class ObstacleDistanceGrid;
+class PathCache;
+struct PolyPath;
+class PolyGridIndex;
 }  // namespace impl
 
 struct ShortestPath {
@@ -85,6 +128,12 @@ struct NavMeshSettings {
   bool filterLedgeSpans;
   bool filterWalkableLowHeightSpans;
 
+  //! Tile size in voxels.  0 builds the navmesh as a single tile, otherwise
+  //! the tiles are rasterized and polygonized in parallel
+  int tileSize;
+  //! Number of threads building tiles, 0 to use all cores
+  int numBuildThreads;
+
   void setDefaults() {
     cellSize = 0.05f;
     cellHeight = 0.2f;
@@ -102,9 +151,49 @@ struct NavMeshSettings {
     filterLowHangingObstacles = true;
     filterLedgeSpans = true;
     filterWalkableLowHeightSpans = true;
+    tileSize = 0;
+    numBuildThreads = 0;
   }
 };
 
+//! Where the time and memory of a navmesh build went, to tune
+//! NavMeshSettings for build time
+struct NavMeshBuildStats {
+  struct Stage {
+    std::string name;
+    //! Wall time summed over all tiles, so it can add up to more than
+    //! totalSeconds for builds in parallel
+    double seconds;
+    //! Peak bytes Recast had allocated on the thread building a tile during
+    //! the stage, including what earlier stages kept, maximum over all tiles
+    size_t peakBytes;
+  };
+  //! The stages of the Recast pipeline in the order they run, the last one
+  //! creates the Detour data
+  std::vector<Stage> stages;
+  //! Wall time of the whole build, including island computation
+  double totalSeconds = 0;
+  int numTiles = 0;
+  //! Peak bytes Recast had allocated on the thread building a tile
+  size_t peakBytes = 0;
+
+  //! Formats the stages as a table
+  std::string report() const;
+};
+
+/**
+ * Loads or builds a navmesh and answers navigation queries on it.
+ *
+ * The query methods (findPath, findPaths, tryStep, trySteps, raycast,
+ * raycasts, getRandomNavigablePoint, getRandomNavigablePoints, islandRadius,
+ * islandArea, distanceToClosestObstacle, closestObstacleSurfacePoint,
+ * isNavigable, snapPoint, snapPoints, geodesicDistanceToGoals and
+ * geodesicDistanceMatrix) may be called concurrently from any number of
+ * threads.  Each call borrows a Detour query object from a lock-free pool,
+ * and every pooled query carries its own random stream for
+ * getRandomNavigablePoint.  Building, rebuilding, loading, freeing and
+ * seeding are not thread safe.
+ **/
 class PathFinder : public std::enable_shared_from_this<PathFinder> {
  public:
   PathFinder();
@@ -122,44 +211,451 @@ class PathFinder : public std::enable_shared_from_this<PathFinder> {
              const float* bmax);
   bool build(const NavMeshSettings& bs, const esp::assets::MeshData& mesh);
 
+  /**
+   * Builds one navmesh for every agent in @p settings, e.g. for several body
+   * radii and heights, while rasterizing the scene only once.  The
+   * heightfield is then filtered, eroded and polygonized for every agent,
+   * in parallel where the agents or tiles allow.  All settings must have the
+   * same cellSize, cellHeight, agentMaxSlope and tileSize.  The heightfield
+   * is rasterized with the smallest agentMaxClimb, which can make a navmesh
+   * differ slightly from a separate build of an agent with a larger one.
+   * Tiles are rasterized with the border of the widest agent and cropped
+   * for the others, which can change their edges slightly as well.
+   *
+   * @return One PathFinder per element of @p settings, or none if the build
+   * failed.  All of them report the stats of the whole build
+   **/
+  static std::vector<std::shared_ptr<PathFinder>> buildMultiple(
+      const std::vector<NavMeshSettings>& settings,
+      const float* verts,
+      const int nverts,
+      const int* tris,
+      const int ntris,
+      const float* bmin,
+      const float* bmax);
+  static std::vector<std::shared_ptr<PathFinder>> buildMultiple(
+      const std::vector<NavMeshSettings>& settings,
+      const esp::assets::MeshData& mesh);
+
+  //! Returns the stats of the last successful build or rebuildTiles
+  const NavMeshBuildStats& getBuildStats() const { return buildStats_; }
+
+  /**
+   * Rebuilds the tiles of the navmesh that overlap any of @p dirtyBoxes from
+   * the updated scene geometry, e.g. after obstacles were added or moved.
+   * Only works after a build with NavMeshSettings::tileSize > 0 and uses the
+   * settings and bounds of that build.  The other tiles are kept as they are
+   * and islands are only recomputed where the rebuilt tiles touch them.
+   * Returns false if a new tile can't be added, the old tile stays in its
+   * place then.
+   **/
+  bool rebuildTiles(const float* verts,
+                    const int nverts,
+                    const int* tris,
+                    const int ntris,
+                    const std::vector<box3f>& dirtyBoxes);
+  bool rebuildTiles(const esp::assets::MeshData& mesh,
+                    const std::vector<box3f>& dirtyBoxes);
+
   vec3f getRandomNavigablePoint();
 
+  /**
+   * Appends @p numPoints navigable points to @p points, drawn uniformly by
+   * surface area from @p random.  Points are only drawn on islands with a
+   * radius of at least @p minIslandRadius, and only on the island with the
+   * largest area if @p largestIslandOnly, so none need to be rejected.  The
+   * same stream always gives the same points, from any thread.  Unlike
+   * getRandomNavigablePoint, which visits every polygon for each point, the
+   * points come from a table of the navmesh's triangles by cumulative area
+   * that is built with the navmesh.
+   *
+   * @return false, without drawing any points, if no island qualifies
+   **/
+  bool getRandomNavigablePoints(int numPoints,
+                                core::Random& random,
+                                std::vector<vec3f>& points,
+                                float minIslandRadius = 0.0,
+                                bool largestIslandOnly = false) const;
+
   bool findPath(ShortestPath& path);
   bool findPath(MultiGoalShortestPath& path);
 
+  /**
+   * Finds the shortest path for every element of @p paths.  The queries are
+   * spread over all cores, each worker using its own Detour query object over
+   * the shared navmesh.  The result for each path is identical to calling
+   * findPath on it; paths that can't be found have an infinite
+   * geodesicDistance and no points.
+   **/
+  void findPaths(std::vector<ShortestPath>& paths);
+
   vec3f tryStep(const Eigen::Ref<const vec3f> start,
                 const Eigen::Ref<const vec3f> end);
 
+  /**
+   * Calls tryStep for every pair of @p starts and @p ends and writes the
+   * filtered end positions to @p results, e.g. to step many agents sharing
+   * the navmesh at once.  The steps are spread over all cores, each worker
+   * using its own Detour query object like findPaths.
+   **/
+  void trySteps(const std::vector<vec3f>& starts,
+                const std::vector<vec3f>& ends,
+                std::vector<vec3f>& results);
+
+  /**
+   * Casts a ray along the navmesh from @p start towards @p end, both snapped
+   * to the navmesh first, like Detour's raycast.  The ray reaches @p end if
+   * the straight line between them stays on the navmesh, i.e. @p end is in
+   * line of sight and straight line reachable from @p start, in which case
+   * their geodesic distance is hitDist.  Otherwise the ray stops where it
+   * first leaves the navmesh.  The ray moves in the horizontal plane and
+   * follows the navmesh up and down, so it can't reach an @p end on another
+   * floor.
+   **/
+  RaycastHit raycast(const vec3f& start, const vec3f& end);
+
+  /**
+   * Calls raycast for every pair of @p starts and @p ends and writes the hits
+   * to @p results.  The rays are spread over all cores like trySteps.
+   **/
+  void raycasts(const std::vector<vec3f>& starts,
+                const std::vector<vec3f>& ends,
+                std::vector<RaycastHit>& results);
+
+  /**
+   * Loads a navmesh saved with saveNavMesh.  Version 2 files are memory
+   * mapped and used in place, along with the islands stored in them, so
+   * loading one is mostly a matter of page cache hits.  Version 1 files are
+   * read into memory and their islands recomputed.
+   *
+   * Loaded navmeshes are shared through a process-wide cache: loading a file
+   * that another PathFinder has loaded, or that was loaded recently enough
+   * to still be cached, reuses its navmesh and islands instead of loading
+   * them again.  Files are told apart by their inode, size and modification
+   * time.  Every PathFinder still has its own query objects.
+   **/
   bool loadNavMesh(const std::string& path);
 
-  bool saveNavMesh(const std::string& path);
+  /**
+   * Sets how many bytes of navmeshes the navmesh cache keeps loaded after
+   * their last PathFinder is gone, evicting the least recently used ones
+   * first.  Navmeshes that are in use are shared regardless.  512MiB by
+   * default, 0 only shares navmeshes that are in use.
+   **/
+  static void setNavMeshCacheCapacity(size_t capacity);
+  static size_t getNavMeshCacheCapacity();
+  //! Bytes of the navmeshes the navmesh cache keeps loaded
+  static size_t getNavMeshCacheSize();
+
+  /**
+   * Saves the navmesh.  Version 1, the default, can be read by every
+   * release.  Version 2 also stores the islands and can be memory mapped by
+   * loadNavMesh, at the cost of padding every tile to a page, which makes
+   * files of navmeshes with many small tiles larger.
+   **/
+  bool saveNavMesh(const std::string& path, int version = 1);
 
   void free();
 
-  bool isLoaded() { return navMesh_ != nullptr; }
+  bool isLoaded() const { return navMesh_ != nullptr; }
 
+  /**
+   * Seeds the random streams used by getRandomNavigablePoint.  Every pooled
+   * query object gets its own stream derived from @p newSeed, so a single
+   * thread always sees the same sequence of points for the same seed.
+   **/
   void seed(uint32_t newSeed);
 
   float islandRadius(const vec3f& pt) const;
 
+  //! Returns the navigable surface area of the island @p pt is on, 0 if @p pt
+  //! isn't on the navmesh
+  float islandArea(const vec3f& pt) const;
+
   float distanceToClosestObstacle(const vec3f& pt,
                                   const float maxSearchRadius = 2.0) const;
   HitRecord closestObstacleSurfacePoint(
       const vec3f& pt,
       const float maxSearchRadius = 2.0) const;
 
+  /**
+   * Precomputes distanceToClosestObstacle and closestObstacleSurfacePoint on
+   * a grid with @p cellSize spacing over the navmesh, up to
+   * @p maxSearchRadius, which turns them into a bilinear lookup.  The grid is
+   * rebuilt whenever the navmesh is loaded, built or rebuilt, and a
+   * @p cellSize of 0 (the default) disables it.
+   *
+   * Looked up distances are within a fraction of @p cellSize of the exact
+   * ones except next to obstacle corners, and the normals are horizontal.
+   * Queries the grid can't answer, like points far off the navmesh or a
+   * larger maxSearchRadius, still run the exact search.
+   **/
+  void setObstacleDistanceGridCellSize(float cellSize,
+                                       float maxSearchRadius = 2.0);
+  float getObstacleDistanceGridCellSize() const {
+    return obstacleDistanceGridCellSize_;
+  }
+
   bool isNavigable(const vec3f& pt, const float maxYDelta = 0.5) const;
 
+  //! Returns the bounds of the navmesh, an empty box if there is none
+  box3f getNavMeshBounds() const;
+
+  /**
+   * Rasterizes the navmesh into a top down map at @p height with
+   * @p metersPerPixel square pixels.  A pixel is 1 if the navmesh is within
+   * @p maxYDelta of @p height at its center, as isNavigable checks it but
+   * without snapping tolerance at the borders, and 0 otherwise.  Row i and
+   * column j of the map cover the pixel whose lowest corner is
+   * getNavMeshBounds().min() + (j, i) * @p metersPerPixel in x and z.
+   *
+   * The triangles of the navmesh's detail mesh are scan converted directly,
+   * so the map costs about as much as its pixels covered by the navmesh
+   * rather than an isNavigable per pixel.
+   **/
+  TopDownView getTopDownView(float metersPerPixel,
+                             float height,
+                             float maxYDelta = 0.5) const;
+
+  //! Same as getTopDownView for every one of @p heights, e.g. every floor of
+  //! a building, in parallel.  All maps cover the same area
+  std::vector<TopDownView> getTopDownViews(float metersPerPixel,
+                                           const std::vector<float>& heights,
+                                           float maxYDelta = 0.5) const;
+
+  //! Returns the closest point on the navmesh to @p pt, NaN if there is no
+  //! navmesh within 2m horizontally and 4m vertically
+  vec3f snapPoint(const vec3f& pt) const;
+
+  //! Snaps every point of @p points like snapPoint, spread over all cores
+  //! like findPaths
+  void snapPoints(const std::vector<vec3f>& points,
+                  std::vector<vec3f>& results) const;
+
+  /**
+   * Indexes the polygons of the navmesh in a grid with @p cellSize cells to
+   * speed up snapping points to the navmesh, which almost every query
+   * starts with.  Points that lie on the navmesh are snapped by looking at
+   * the few polygons of their cell instead of the BV trees of the tiles
+   * around them, other points still take the full search.  The results are
+   * the same either way.  The index is rebuilt whenever the navmesh is
+   * loaded, built or rebuilt, and a @p cellSize of 0 (the default)
+   * disables it.
+   **/
+  void setPolyGridIndexCellSize(float cellSize);
+  float getPolyGridIndexCellSize() const { return polyGridIndexCellSize_; }
+
+  /**
+   * Groups the navmesh polygons into clusters of about @p cellSize and
+   * precomputes the distances between the entrances of every cluster, after
+   * which findPath searches the clusters first and then only the polygons of
+   * the clusters on the way, HPA*-style.  Queries then take time in the
+   * number of clusters a path crosses rather than in the size of the
+   * navmesh, which pays off for long paths on large scenes.  The graph is
+   * rebuilt whenever the navmesh is loaded, built or rebuilt, and a
+   * @p cellSize of 0 (the default) disables it.
+   *
+   * The searches also move through polygon corners, so paths come out as
+   * long as without the graph on average, a little shorter in most cases
+   * and a few percent longer when the shortest path leaves the clusters of
+   * the abstract path.  Either way, findPath has no limit on the length of
+   * a path.
+   **/
+  void setClusterGraphCellSize(float cellSize);
+  float getClusterGraphCellSize() const { return clusterGraphCellSize_; }
+
+  /**
+   * Caches the polygon corridors findPath finds between a start and a single
+   * goal, for loops that ask for the same pairs over and over.  Entries are
+   * keyed on the start and end polygons and on the endpoints quantized to
+   * @p quantization, and the least recently used ones are evicted to keep
+   * the cache within @p maxBytes.  A hit skips the search but still string
+   * pulls the cached corridor with the exact endpoints, so paths always
+   * start and end at the requested points, and only differ from an uncached
+   * search when a query close to this one would have taken a different
+   * corridor.  The cache is emptied whenever the navmesh is loaded, built or
+   * rebuilt, and a @p maxBytes of 0 (the default) disables it.
+   **/
+  void setPathCacheBudget(size_t maxBytes, float quantization = 0.01);
+  size_t getPathCacheBudget() const { return pathCacheMaxBytes_; }
+  float getPathCacheQuantization() const { return pathCacheQuantization_; }
+
+  //! Hits and misses of the findPath cache since it was last emptied
+  PathCacheStats getPathCacheStats() const;
+
+  /**
+   * Returns the geodesic distance from @p pt to the closest of @p goals using
+   * a precomputed distance field.  The field of a goal set is built on first
+   * use with one Dijkstra pass over the navmesh, after which a lookup only
+   * costs snapping @p pt to the navmesh.  Fields of the most recently used
+   * goal sets are kept in an LRU cache, see setDistanceFieldCacheSize.
+   *
+   * The distance follows polygon corners, so it is tight near obstacles and
+   * a few percent long across open space.  It can come out slightly shorter
+   * than findPath as the polygon search of findPath isn't optimal either.
+   * Infinity if no goal is reachable from @p pt.
+   **/
+  float geodesicDistanceToGoals(const vec3f& pt,
+                                const std::vector<vec3f>& goals);
+
+  /**
+   * Returns the geodesic distances between all pairs of @p points as a KxK
+   * matrix, infinity for pairs that aren't connected and for points that
+   * aren't on the navmesh.
+   *
+   * Builds the graph of the navmesh vertices once, then runs one Dijkstra
+   * over it per point, spread over all cores.  The search from a point
+   * starts at the navmesh border vertices in its sight and the other points
+   * are looked up through the vertices in their own sight, taking the
+   * shorter of the two directions.  Those distances are upper bounds, exact
+   * wherever they match the straight line distance and for paths that bend
+   * around a single corner.  With @p refine, the other connected pairs get
+   * the straight line distance if a raycast over the navmesh gets from one
+   * point to the other.  Pairs out of sight keep their distance if no path
+   * through vertices in sight of either point can be shorter, and get the
+   * shorter of their distance and findPath's otherwise, so the matrix is
+   * never longer than findPath from the point with the lower index to the
+   * other one.
+   **/
+  Eigen::MatrixXf geodesicDistanceMatrix(const std::vector<vec3f>& points,
+                                         bool refine = true);
+
+  //! Sets how many distance fields are cached, evicting the least recently
+  //! used ones
+  void setDistanceFieldCacheSize(int cacheSize);
+  int getDistanceFieldCacheSize() const { return distanceFieldCacheSize_; }
+
+  /**
+   * Sets the object goals named @p name to @p objects, e.g. all instances of
+   * an ObjectNav category.  An object is reached from the navigable points
+   * within @p radius of its footprint, the projection of its box on the
+   * floor, and at most @p maxYDelta below its bottom.  Those points are found
+   * on the navmesh polygons under the objects and become the sources of one
+   * multi-source distance field, so geodesicDistanceToObjects is a lookup.
+   * Replaces earlier goals of the same name.  Returns false, without setting
+   * anything, if no navigable point reaches any of the objects.
+   **/
+  bool setObjectGoals(const std::string& name,
+                      const std::vector<geo::OBB>& objects,
+                      float radius = 1.0,
+                      float maxYDelta = 1.5);
+
+  //! setObjectGoals for the objects of @p semanticScene whose category is
+  //! named @p category, with the goals named @p category
+  bool setCategoryGoals(const scene::SemanticScene& semanticScene,
+                        const std::string& category,
+                        float radius = 1.0,
+                        float maxYDelta = 1.5);
+
+  /**
+   * Returns the geodesic distance from @p pt to the closest point that
+   * reaches one of the object goals named @p name, 0 if @p pt reaches one
+   * itself.  The distance follows polygon corners like
+   * geodesicDistanceToGoals.  Infinity if no object is reachable from @p pt
+   * or there are no goals named @p name.
+   **/
+  float geodesicDistanceToObjects(const vec3f& pt, const std::string& name);
+
   friend impl::ActionSpaceGraph;
+  friend class PathCorridor;
 
  protected:
-  bool initNavQuery();
+  //! Search nodes of the pooled queries, findPath uses a larger query for
+  //! paths that need more
+  static const int MAX_NODES = 2048;
+
+  //! Switches to @p navMeshData and creates the query pool for it
+  bool initNavQuery(std::shared_ptr<impl::NavMeshData> navMeshData);
+  //! Releases navMeshData_, freeing it if no other PathFinder shares it
+  void freeNavMesh();
+  //! Takes ownership of @p navMesh, freshly built with @p bs over
+  //! [@p bmin, @p bmax], and initializes the queries on it
+  bool initBuiltNavMesh(dtNavMesh* navMesh,
+                        const NavMeshSettings& bs,
+                        const float* bmin,
+                        const float* bmax);
+  //! Rebuilds obstacleDistanceGrid_ for the current navmesh and settings
+  void buildObstacleDistanceGrid();
+  //! Rebuilds polyGridIndex_ for the current navmesh and settings
+  void buildPolyGridIndex();
+  //! Rebuilds clusterGraph_ for the current navmesh and settings
+  void buildClusterGraph();
+  //! Rebuilds sampler_ for the current navmesh and islands
+  void buildSampler();
+  //! Creates an empty pathCache_ for the current navmesh and settings
+  void buildPathCache();
+
+  bool findPath(ShortestPath& path, dtNavMeshQuery* navQuery);
+  bool findPath(MultiGoalShortestPath& path, dtNavMeshQuery* navQuery);
+  /**
+   * The search of findPath: snaps @p start and @p ends to the navmesh and
+   * fills @p path with the polygon corridor of the shortest path from
+   * @p start to the closest of @p ends.  If @p start is one of @p ends, the
+   * corridor is just the start polygon.
+   **/
+  bool findPolyPath(const vec3f& start,
+                    const std::vector<vec3f>& ends,
+                    dtNavMeshQuery* navQuery,
+                    impl::PolyPath* path);
+  vec3f tryStep(const vec3f& start,
+                const vec3f& end,
+                dtNavMeshQuery* navQuery);
+  RaycastHit raycast(const vec3f& start,
+                     const vec3f& end,
+                     dtNavMeshQuery* navQuery);
+
+  std::shared_ptr<const impl::GeodesicDistanceField> getDistanceField(
+      const std::vector<vec3f>& goals);
+  void clearDistanceFieldCache();
   std::vector<vec3f> prevEnds;
 
+  //! Owns navMesh_ and islandSystem_, shared with other PathFinders if the
+  //! navmesh was loaded from a file
+  std::shared_ptr<impl::NavMeshData> navMeshData_;
   impl::IslandSystem* islandSystem_ = nullptr;
+  impl::NavQueryPool* queryPool_ = nullptr;
+  impl::ObstacleDistanceGrid* obstacleDistanceGrid_ = nullptr;
+  float obstacleDistanceGridCellSize_ = 0;
+  float obstacleDistanceGridRadius_ = 2.0;
+  impl::PolyGridIndex* polyGridIndex_ = nullptr;
+  float polyGridIndexCellSize_ = 0;
+  impl::ClusterGraph* clusterGraph_ = nullptr;
+  float clusterGraphCellSize_ = 0;
+  impl::NavMeshSampler* sampler_ = nullptr;
+  impl::PathCache* pathCache_ = nullptr;
+  size_t pathCacheMaxBytes_ = 0;
+  float pathCacheQuantization_ = 0.01;
+
+  //! Settings and bounds of the last build, used by rebuildTiles.
+  //! tileSize is 0 if the navmesh can't be rebuilt
+  NavMeshSettings tiledBuildSettings_{};
+  box3f tiledBuildBounds_;
+  NavMeshBuildStats buildStats_;
+  uint32_t seed_ = 0;
+  //! Bumped whenever the navmesh or its tiles change, so that PathCorridor
+  //! can tell its corridor is stale
+  uint64_t navMeshGeneration_ = 0;
+
+  typedef std::pair<std::vector<vec3f>,
+                    std::shared_ptr<const impl::GeodesicDistanceField>>
+      DistanceFieldCacheEntry;
+  //! Most recently used first
+  std::list<DistanceFieldCacheEntry> distanceFieldCache_;
+  int distanceFieldCacheSize_ = 16;
+  std::mutex distanceFieldCacheMutex_;
+
+  struct ObjectGoals {
+    std::vector<geo::OBB> objects;
+    float radius;
+    float maxYDelta;
+    //! Built on first use, reset when the navmesh changes
+    std::shared_ptr<const impl::GeodesicDistanceField> field;
+  };
+  //! Guarded by distanceFieldCacheMutex_
+  std::unordered_map<std::string, std::shared_ptr<const ObjectGoals>>
+      objectGoals_;
 
   dtNavMesh* navMesh_;
-  dtNavMeshQuery* navQuery_;
   dtQueryFilter* filter_;
   ESP_SMART_POINTERS(PathFinder)
 };
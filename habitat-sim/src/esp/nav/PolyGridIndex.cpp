@@ -0,0 +1,164 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "PolyGridIndex.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <tuple>
+
+#include "DetourNavMeshQuery.h"
+
+namespace esp {
+namespace nav {
+namespace impl {
+
+PolyGridIndex::PolyGridIndex(const dtNavMesh* navMesh, float cellSize)
+    : navMesh_{navMesh}, cellSize_{cellSize} {
+  vec3f bmin = vec3f::Constant(std::numeric_limits<float>::max());
+  vec3f bmax = vec3f::Constant(std::numeric_limits<float>::lowest());
+  for (int iTile = 0; iTile < navMesh->getMaxTiles(); ++iTile) {
+    const dtMeshTile* tile = navMesh->getTile(iTile);
+    if (!tile->header)
+      continue;
+    bmin = bmin.cwiseMin(Eigen::Map<const vec3f>(tile->header->bmin));
+    bmax = bmax.cwiseMax(Eigen::Map<const vec3f>(tile->header->bmax));
+  }
+  if ((bmin.array() > bmax.array()).any()) {
+    bmin = bmax = vec3f::Zero();
+  }
+  originX_ = bmin[0];
+  originZ_ = bmin[2];
+  sizeX_ = static_cast<int>((bmax[0] - bmin[0]) / cellSize_) + 1;
+  sizeZ_ = static_cast<int>((bmax[2] - bmin[2]) / cellSize_) + 1;
+  const int numCells = sizeX_ * sizeZ_;
+
+  // Detour visits the tiles a query overlaps by their y then x location, then
+  // in the order getTilesAt returns them, and the polygons of a tile in the
+  // order of the leaves of its BV tree
+  typedef std::tuple<int, int, int, int> VisitOrder;
+  struct Pending {
+    int cell;
+    VisitOrder order;
+    Entry entry;
+  };
+  std::vector<Pending> pending;
+  const int maxLayers = 32;
+  const dtMeshTile* layers[maxLayers];
+  std::vector<int> polyOrder;
+  for (int iTile = 0; iTile < navMesh->getMaxTiles(); ++iTile) {
+    const dtMeshTile* tile = navMesh->getTile(iTile);
+    if (!tile->header)
+      continue;
+    const dtMeshHeader* header = tile->header;
+    const int numLayers = navMesh->getTilesAt(header->x, header->y, layers,
+                                              maxLayers);
+    const int layer =
+        std::find(layers, layers + numLayers, tile) - layers;
+
+    polyOrder.resize(header->polyCount);
+    if (tile->bvTree) {
+      for (int i = 0; i < header->bvNodeCount; ++i) {
+        if (tile->bvTree[i].i >= 0)
+          polyOrder[tile->bvTree[i].i] = i;
+      }
+    } else {
+      for (int i = 0; i < header->polyCount; ++i)
+        polyOrder[i] = i;
+    }
+
+    const dtPolyRef base = navMesh->getPolyRefBase(tile);
+    for (int jPoly = 0; jPoly < header->polyCount; ++jPoly) {
+      const dtPoly* poly = &tile->polys[jPoly];
+      if (poly->getType() != DT_POLYTYPE_GROUND)
+        continue;
+
+      Entry entry{base | jPoly};
+      entry.minX = entry.minY = entry.minZ =
+          std::numeric_limits<float>::max();
+      entry.maxX = entry.maxY = entry.maxZ =
+          std::numeric_limits<float>::lowest();
+      auto addPoint = [&entry](const float* v) {
+        entry.minX = std::min(entry.minX, v[0]);
+        entry.maxX = std::max(entry.maxX, v[0]);
+        entry.minY = std::min(entry.minY, v[1]);
+        entry.maxY = std::max(entry.maxY, v[1]);
+        entry.minZ = std::min(entry.minZ, v[2]);
+        entry.maxZ = std::max(entry.maxZ, v[2]);
+      };
+      for (int k = 0; k < poly->vertCount; ++k)
+        addPoint(&tile->verts[poly->verts[k] * 3]);
+      // The height of the detail mesh can differ from the polygon's
+      const dtPolyDetail& detail = tile->detailMeshes[jPoly];
+      for (int k = 0; k < detail.vertCount; ++k)
+        addPoint(&tile->detailVerts[(detail.vertBase + k) * 3]);
+      entry.minY -= header->walkableClimb;
+      entry.maxY += header->walkableClimb;
+
+      const VisitOrder order{header->y, header->x, layer, polyOrder[jPoly]};
+      const int x0 = (entry.minX - originX_) / cellSize_;
+      const int x1 = std::min<int>((entry.maxX - originX_) / cellSize_,
+                                   sizeX_ - 1);
+      const int z0 = (entry.minZ - originZ_) / cellSize_;
+      const int z1 = std::min<int>((entry.maxZ - originZ_) / cellSize_,
+                                   sizeZ_ - 1);
+      for (int z = std::max(z0, 0); z <= z1; ++z) {
+        for (int x = std::max(x0, 0); x <= x1; ++x)
+          pending.push_back({z * sizeX_ + x, order, entry});
+      }
+    }
+  }
+
+  std::sort(pending.begin(), pending.end(),
+            [](const Pending& a, const Pending& b) {
+              return std::tie(a.cell, a.order) < std::tie(b.cell, b.order);
+            });
+  cellStart_.assign(numCells + 1, 0);
+  entries_.reserve(pending.size());
+  for (const auto& p : pending) {
+    entries_.push_back(p.entry);
+    ++cellStart_[p.cell + 1];
+  }
+  for (int i = 0; i < numCells; ++i)
+    cellStart_[i + 1] += cellStart_[i];
+}
+
+dtPolyRef PolyGridIndex::findPolyUnder(const vec3f& pt,
+                                       const dtNavMeshQuery* navQuery,
+                                       const dtQueryFilter* filter,
+                                       vec3f* polyPt) const {
+  const float fx = (pt[0] - originX_) / cellSize_;
+  const float fz = (pt[2] - originZ_) / cellSize_;
+  // Also rejects NaNs
+  if (!(fx >= 0 && fx < sizeX_ && fz >= 0 && fz < sizeZ_))
+    return 0;
+  const int cell = static_cast<int>(fz) * sizeX_ + static_cast<int>(fx);
+
+  for (int i = cellStart_[cell]; i < cellStart_[cell + 1]; ++i) {
+    const Entry& entry = entries_[i];
+    if (pt[0] < entry.minX || pt[0] > entry.maxX || pt[2] < entry.minZ ||
+        pt[2] > entry.maxZ || pt[1] < entry.minY || pt[1] > entry.maxY)
+      continue;
+
+    const dtMeshTile* tile = 0;
+    const dtPoly* poly = 0;
+    navMesh_->getTileAndPolyByRefUnsafe(entry.ref, &tile, &poly);
+    if (!filter->passFilter(entry.ref, tile, poly))
+      continue;
+
+    // Same test as findNearestPoly uses to prefer polygons under the point
+    bool posOverPoly = false;
+    navQuery->closestPointOnPoly(entry.ref, pt.data(), polyPt->data(),
+                                 &posOverPoly);
+    if (posOverPoly &&
+        std::abs(pt[1] - (*polyPt)[1]) <= tile->header->walkableClimb)
+      return entry.ref;
+  }
+  return 0;
+}
+
+}  // namespace impl
+}  // namespace nav
+}  // namespace esp
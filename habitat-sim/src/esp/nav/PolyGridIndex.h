@@ -0,0 +1,80 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <vector>
+
+#include "esp/core/esp.h"
+
+#include "DetourNavMesh.h"
+
+class dtNavMeshQuery;
+class dtQueryFilter;
+
+namespace esp {
+namespace nav {
+namespace impl {
+
+// Uniform grid over the footprints of the navmesh polygons, to snap points
+// that lie on the navmesh without a findNearestPoly.
+//
+// findNearestPoly collects every polygon in a large box around the point from
+// the BV trees of the tiles it overlaps and finds the closest point on each of
+// them.  Most queries are about points the agent stands on though, and for
+// those the answer is the first polygon in Detour's visiting order that the
+// point lies over within the walkable climb.  The grid lists, for every cell,
+// the polygons whose bounds overlap it in that same order, along with their
+// height range, so polygons on other floors of a multi-floor house are
+// rejected by their heights and only the one or two polygons under the point
+// are looked at.  Points that aren't over any polygon within the walkable
+// climb still need findNearestPoly.
+//
+// Takes O(npolys) to construct and O(polygons per cell) to query
+class PolyGridIndex {
+ public:
+  /**
+   * @param[in] navMesh The navmesh to index
+   * @param[in] cellSize Size of the grid cells, polygons are listed in every
+   *cell their bounds overlap
+   **/
+  PolyGridIndex(const dtNavMesh* navMesh, float cellSize);
+
+  /**
+   * Returns the polygon findNearestPoly would return for @p pt if @p pt lies
+   * over it within the walkable climb, and the closest point on it in
+   * @p polyPt.  Returns 0 if @p pt isn't over any polygon within the walkable
+   * climb, in which case findNearestPoly needs to be called
+   **/
+  dtPolyRef findPolyUnder(const vec3f& pt,
+                          const dtNavMeshQuery* navQuery,
+                          const dtQueryFilter* filter,
+                          vec3f* polyPt) const;
+
+  float cellSize() const { return cellSize_; }
+
+ private:
+  struct Entry {
+    dtPolyRef ref;
+    //! Bounds of the polygon, with the height range grown by the walkable
+    //! climb of its tile
+    float minX, maxX, minY, maxY, minZ, maxZ;
+  };
+
+  const dtNavMesh* navMesh_;
+  const float cellSize_;
+  //! Corner of cell (0, 0)
+  float originX_, originZ_;
+  int sizeX_, sizeZ_;
+  //! Polygons overlapping cell (x, z) are
+  //! entries_[cellStart_[z * sizeX_ + x], cellStart_[z * sizeX_ + x + 1])
+  std::vector<int> cellStart_;
+  std::vector<Entry> entries_;
+
+  ESP_SMART_POINTERS(PolyGridIndex)
+};
+
+}  // namespace impl
+}  // namespace nav
+}  // namespace esp
@@ -0,0 +1,30 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <vector>
+
+#include "esp/core/esp.h"
+
+#include "DetourNavMesh.h"
+
+namespace esp {
+namespace nav {
+namespace impl {
+
+//! Polygon corridor of a shortest path, see PathFinder::findPolyPath
+struct PolyPath {
+  //! From the start polygon to the goal polygon
+  std::vector<dtPolyRef> polys;
+  //! Index of the goal the corridor leads to
+  int goalIdx = 0;
+  //! Start and goal snapped to the navmesh
+  vec3f start;
+  vec3f end;
+};
+
+}  // namespace impl
+}  // namespace nav
+}  // namespace esp
@@ -0,0 +1,154 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "TriangleGridIndex.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace esp {
+namespace nav {
+namespace impl {
+
+TriangleGridIndex::TriangleGridIndex(const assets::MeshData& mesh,
+                                     float cellSize)
+    : cellSize_{cellSize} {
+  const int numTriangles = mesh.ibo.size() / 3;
+  triangles_.reserve(numTriangles);
+  vec3f bmin = vec3f::Constant(std::numeric_limits<float>::max());
+  vec3f bmax = vec3f::Constant(std::numeric_limits<float>::lowest());
+  for (int i = 0; i < numTriangles; ++i) {
+    Triangle triangle;
+    for (int k = 0; k < 3; ++k) {
+      triangle.verts[k] = mesh.vbo[mesh.ibo[3 * i + k]];
+      bmin = bmin.cwiseMin(triangle.verts[k]);
+      bmax = bmax.cwiseMax(triangle.verts[k]);
+    }
+    triangle.minY = std::min({triangle.verts[0][1], triangle.verts[1][1],
+                              triangle.verts[2][1]});
+    triangle.maxY = std::max({triangle.verts[0][1], triangle.verts[1][1],
+                              triangle.verts[2][1]});
+    triangles_.push_back(triangle);
+  }
+  if ((bmin.array() > bmax.array()).any()) {
+    bmin = bmax = vec3f::Zero();
+  }
+  originX_ = bmin[0];
+  originZ_ = bmin[2];
+  sizeX_ = static_cast<int>((bmax[0] - bmin[0]) / cellSize_) + 1;
+  sizeZ_ = static_cast<int>((bmax[2] - bmin[2]) / cellSize_) + 1;
+  const int numCells = sizeX_ * sizeZ_;
+
+  // Lists stored as offsets into one flat array, in two passes: count first,
+  // fill second
+  cellStart_.assign(numCells + 1, 0);
+  std::vector<int> fill;
+  for (int pass = 0; pass < 2; ++pass) {
+    if (pass == 1) {
+      for (int i = 0; i < numCells; ++i)
+        cellStart_[i + 1] += cellStart_[i];
+      cellTriangles_.resize(cellStart_[numCells]);
+      fill.assign(cellStart_.begin(), cellStart_.end() - 1);
+    }
+    for (int i = 0; i < numTriangles; ++i) {
+      const Triangle& triangle = triangles_[i];
+      const float minX = std::min({triangle.verts[0][0], triangle.verts[1][0],
+                                   triangle.verts[2][0]});
+      const float maxX = std::max({triangle.verts[0][0], triangle.verts[1][0],
+                                   triangle.verts[2][0]});
+      const float minZ = std::min({triangle.verts[0][2], triangle.verts[1][2],
+                                   triangle.verts[2][2]});
+      const float maxZ = std::max({triangle.verts[0][2], triangle.verts[1][2],
+                                   triangle.verts[2][2]});
+      const int x0 = (minX - originX_) / cellSize_;
+      const int x1 = std::min<int>((maxX - originX_) / cellSize_, sizeX_ - 1);
+      const int z0 = (minZ - originZ_) / cellSize_;
+      const int z1 = std::min<int>((maxZ - originZ_) / cellSize_, sizeZ_ - 1);
+      for (int z = std::max(z0, 0); z <= z1; ++z) {
+        for (int x = std::max(x0, 0); x <= x1; ++x) {
+          const int cell = z * sizeX_ + x;
+          if (pass == 0)
+            ++cellStart_[cell + 1];
+          else
+            cellTriangles_[fill[cell]++] = i;
+        }
+      }
+    }
+  }
+}
+
+bool TriangleGridIndex::segmentHits(
+    const vec3f& start,
+    const vec3f& end,
+    const std::function<bool(const vec3f&)>& ignoreHit) const {
+  const vec3f dir = end - start;
+  const float minY = std::min(start[1], end[1]);
+  const float maxY = std::max(start[1], end[1]);
+
+  // Cells whose square the footprint of the segment may cross, those whose
+  // center is within half a diagonal of it
+  const vec2f start2(start[0] - originX_, start[2] - originZ_);
+  const vec2f dir2(dir[0], dir[2]);
+  const float length2 = dir2.squaredNorm();
+  const float halfDiagonal = cellSize_ * float(M_SQRT1_2);
+  auto cellRange = [this](float a, float b, int size) {
+    return std::make_pair(
+        std::max(static_cast<int>(std::floor(std::min(a, b) / cellSize_)), 0),
+        std::min(static_cast<int>(std::floor(std::max(a, b) / cellSize_)),
+                 size - 1));
+  };
+  const auto xRange = cellRange(start2[0], start2[0] + dir2[0], sizeX_);
+  const auto zRange = cellRange(start2[1], start2[1] + dir2[1], sizeZ_);
+
+  for (int z = zRange.first; z <= zRange.second; ++z) {
+    for (int x = xRange.first; x <= xRange.second; ++x) {
+      const vec2f center((x + 0.5f) * cellSize_, (z + 0.5f) * cellSize_);
+      const float t =
+          length2 > 0
+              ? std::min(std::max((center - start2).dot(dir2) / length2, 0.f),
+                         1.f)
+              : 0.f;
+      if ((start2 + t * dir2 - center).norm() > halfDiagonal)
+        continue;
+
+      const int cell = z * sizeX_ + x;
+      for (int i = cellStart_[cell]; i < cellStart_[cell + 1]; ++i) {
+        const Triangle& triangle = triangles_[cellTriangles_[i]];
+        if (triangle.maxY < minY || triangle.minY > maxY)
+          continue;
+
+        // Moller-Trumbore, with the segment as the ray over t in (0, 1).
+        // Hits on the edge between two triangles may miss both by rounding,
+        // so the edges are grown a little
+        constexpr float kEps = 1e-4f;
+        const vec3f e1 = triangle.verts[1] - triangle.verts[0];
+        const vec3f e2 = triangle.verts[2] - triangle.verts[0];
+        const vec3f p = dir.cross(e2);
+        const float det = e1.dot(p);
+        if (std::abs(det) < 1e-12f)
+          continue;
+        const float invDet = 1 / det;
+        const vec3f s = start - triangle.verts[0];
+        const float u = s.dot(p) * invDet;
+        if (u < -kEps || u > 1 + kEps)
+          continue;
+        const vec3f q = s.cross(e1);
+        const float v = dir.dot(q) * invDet;
+        if (v < -kEps || u + v > 1 + kEps)
+          continue;
+        const float hitT = e2.dot(q) * invDet;
+        if (hitT <= 0 || hitT >= 1)
+          continue;
+        if (!ignoreHit(start + hitT * dir))
+          return true;
+      }
+    }
+  }
+  return false;
+}
+
+}  // namespace impl
+}  // namespace nav
+}  // namespace esp
@@ -0,0 +1,69 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "esp/assets/MeshData.h"
+#include "esp/core/esp.h"
+
+namespace esp {
+namespace nav {
+namespace impl {
+
+// Uniform grid over the footprints of the triangles of a scene mesh, to test
+// line of sight against the mesh on the CPU.
+//
+// Scenes are mostly flat, so the grid is over x and z like PolyGridIndex.  A
+// segment only tests the triangles listed in the cells its footprint passes
+// through, and skips those whose height range it doesn't overlap, which
+// rejects the floors and ceilings of other storeys.
+//
+// Takes O(ntris) to construct and O(triangles per cell * cells crossed) to
+// query
+class TriangleGridIndex {
+ public:
+  /**
+   * @param[in] mesh The mesh to index, every three indices of its ibo are a
+   * triangle
+   * @param[in] cellSize Size of the grid cells, triangles are listed in every
+   * cell their bounds overlap
+   **/
+  TriangleGridIndex(const assets::MeshData& mesh, float cellSize);
+
+  /**
+   * Returns whether the segment from @p start to @p end crosses a triangle
+   * of the mesh, except at points for which @p ignoreHit returns true
+   **/
+  bool segmentHits(const vec3f& start,
+                   const vec3f& end,
+                   const std::function<bool(const vec3f&)>& ignoreHit) const;
+
+  float cellSize() const { return cellSize_; }
+
+ private:
+  struct Triangle {
+    vec3f verts[3];
+    float minY, maxY;
+  };
+
+  const float cellSize_;
+  //! Corner of cell (0, 0)
+  float originX_, originZ_;
+  int sizeX_, sizeZ_;
+  //! Triangles overlapping cell (x, z) are
+  //! triangles_[cellTriangles_[i]] for i in
+  //! [cellStart_[z * sizeX_ + x], cellStart_[z * sizeX_ + x + 1])
+  std::vector<int> cellStart_;
+  std::vector<int> cellTriangles_;
+  std::vector<Triangle> triangles_;
+
+  ESP_SMART_POINTERS(TriangleGridIndex)
+};
+
+}  // namespace impl
+}  // namespace nav
+}  // namespace esp
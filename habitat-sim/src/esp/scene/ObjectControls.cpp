@@ -4,6 +4,9 @@
 
 #include "ObjectControls.h"
 
+#define _USE_MATH_DEFINES
+#include <cmath>
+
 #include "SceneNode.h"
 #include "esp/core/esp.h"
 
@@ -43,24 +46,30 @@ SceneNode& moveForward(SceneNode& object, float distance) {
   return moveBackward(object, -distance);
 }
 
-SceneNode& lookLeft(SceneNode& object, float angleInDegrees) {
-  // TODO pull out into proper utility
-  const float angleInRad = angleInDegrees * 0.0174533f;
-  object.rotateYLocal(angleInRad);
+namespace {
+// Rotates the same way as _rotate_local of the python controls, down to the
+// precision of the conversion to radians, so that both turn agents exactly
+// alike
+SceneNode& rotateLocal(SceneNode& object,
+                       float angleInDegrees,
+                       const vec3f& axis) {
+  const float angleInRad = angleInDegrees * (M_PI / 180.0);
+  object.rotateLocal(angleInRad, axis);
   object.setRotation(object.getRotation().normalized());
   return object;
 }
+}  // namespace
+
+SceneNode& lookLeft(SceneNode& object, float angleInDegrees) {
+  return rotateLocal(object, angleInDegrees, vec3f::UnitY());
+}
 
 SceneNode& lookRight(SceneNode& object, float angleInDegrees) {
   return lookLeft(object, -angleInDegrees);
 }
 
 SceneNode& lookUp(SceneNode& object, float angleInDegrees) {
-  // TODO pull out into proper utility
-  const float angleInRad = angleInDegrees * 0.0174533f;
-  object.rotateXLocal(angleInRad);
-  object.setRotation(object.getRotation().normalized());
-  return object;
+  return rotateLocal(object, angleInDegrees, vec3f::UnitX());
 }
 
 SceneNode& lookDown(SceneNode& object, float angleInDegrees) {
@@ -3,10 +3,20 @@
 // LICENSE file in the root directory of this source tree.
 
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <thread>
 #include "esp/agent/Agent.h"
 #include "esp/assets/SceneLoader.h"
 #include "esp/core/esp.h"
 #include "esp/core/random.h"
+#include "esp/geo/geo.h"
+#include "esp/nav/ActionSpacePathFinder.h"
+#include "esp/nav/EpisodeGenerator.h"
+#include "esp/nav/ObjectViewpoints.h"
+#include "esp/nav/PathCorridor.h"
 #include "esp/nav/PathFinder.h"
 #include "esp/scene/ObjectControls.h"
 #include "esp/scene/SceneGraph.h"
@@ -28,6 +38,9 @@ void testPathFinder(PathFinder& pf) {
     if (foundPath) {
       const float islandSize = pf.islandRadius(path.requestedStart);
       CHECK(islandSize > 0.0);
+      CHECK(pf.islandArea(path.requestedStart) > 0.0);
+      CHECK(pf.islandArea(path.requestedEnd) ==
+            pf.islandArea(path.requestedStart));
       for (int j = 0; j < path.points.size(); j++) {
         printPathPoint(i, j, path.points[j], path.geodesicDistance);
         CHECK(pf.islandRadius(path.points[j]) == islandSize);
@@ -78,6 +91,108 @@ void printRandomizedPathSet(PathFinder& pf) {
   }
 }
 
+TEST(NavTest, SaveLoadNavMeshTest) {
+  // test.navmesh is a version 1 file, save it again as version 2
+  PathFinder v1;
+  CHECK(v1.loadNavMesh("test.navmesh"));
+  CHECK(v1.saveNavMesh("test_v2.navmesh", 2));
+  CHECK(!v1.saveNavMesh("test_v3.navmesh", 3));
+  PathFinder v2;
+  CHECK(v2.loadNavMesh("test_v2.navmesh"));
+  testPathFinder(v2);
+
+  for (int i = 0; i < 1000; i++) {
+    ShortestPath path;
+    path.requestedStart = v1.getRandomNavigablePoint();
+    path.requestedEnd = v1.getRandomNavigablePoint();
+    ShortestPath v2Path = path;
+    CHECK_EQ(v1.findPath(path), v2.findPath(v2Path));
+    CHECK_EQ(path.geodesicDistance, v2Path.geodesicDistance);
+    CHECK_EQ(v1.islandRadius(path.requestedStart),
+             v2.islandRadius(path.requestedStart));
+    CHECK_EQ(v1.islandArea(path.requestedStart),
+             v2.islandArea(path.requestedStart));
+  }
+
+  // Loading the same file again reuses the cached navmesh
+  CHECK(v2.loadNavMesh("test_v2.navmesh"));
+  CHECK(v2.isLoaded());
+
+  // Version 1 stays the default
+  CHECK(v2.saveNavMesh("test_v1.navmesh"));
+  auto readVersion = [](const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    int header[2] = {0, 0};
+    in.read(reinterpret_cast<char*>(header), sizeof(header));
+    return header[1];
+  };
+  CHECK_EQ(readVersion("test_v1.navmesh"), 1);
+  CHECK_EQ(readVersion("test_v2.navmesh"), 2);
+  PathFinder resaved;
+  CHECK(resaved.loadNavMesh("test_v1.navmesh"));
+  testPathFinder(resaved);
+
+  // Corrupted tables are rejected.  The tiles start a page into the file,
+  // everything before them is checksummed
+  std::string contents;
+  {
+    std::ifstream in("test_v2.navmesh", std::ios::binary);
+    contents.assign(std::istreambuf_iterator<char>(in),
+                    std::istreambuf_iterator<char>());
+  }
+  contents[128] ^= 0x1;
+  {
+    std::ofstream out("test_corrupt.navmesh", std::ios::binary);
+    out << contents;
+  }
+  PathFinder corrupt;
+  CHECK(!corrupt.loadNavMesh("test_corrupt.navmesh"));
+  CHECK(!corrupt.isLoaded());
+}
+
+TEST(NavTest, NavMeshCacheTest) {
+  const size_t capacity = PathFinder::getNavMeshCacheCapacity();
+  {
+    PathFinder first;
+    CHECK(first.loadNavMesh("test.navmesh"));
+  }
+  // Unused navmeshes are kept until the cache is full
+  const size_t size = PathFinder::getNavMeshCacheSize();
+  CHECK_GT(size, 0);
+
+  PathFinder a, b;
+  CHECK(a.loadNavMesh("test.navmesh"));
+  CHECK(b.loadNavMesh("test.navmesh"));
+  CHECK_EQ(PathFinder::getNavMeshCacheSize(), size);
+  for (int i = 0; i < 100; i++) {
+    ShortestPath path;
+    path.requestedStart = a.getRandomNavigablePoint();
+    path.requestedEnd = a.getRandomNavigablePoint();
+    ShortestPath bPath = path;
+    CHECK_EQ(a.findPath(path), b.findPath(bPath));
+    CHECK_EQ(path.geodesicDistance, bPath.geodesicDistance);
+  }
+
+  // Navmeshes in use survive eviction
+  PathFinder::setNavMeshCacheCapacity(0);
+  CHECK_EQ(PathFinder::getNavMeshCacheSize(), 0);
+  CHECK(a.isLoaded());
+  CHECK(b.loadNavMesh("test.navmesh"));
+  CHECK(b.isNavigable(b.getRandomNavigablePoint()));
+  PathFinder::setNavMeshCacheCapacity(capacity);
+
+  // A file that changed is read again rather than served from the cache
+  CHECK(a.saveNavMesh("test_cache.navmesh", 2));
+  PathFinder changed;
+  CHECK(changed.loadNavMesh("test_cache.navmesh"));
+  {
+    std::ofstream out("test_cache.navmesh",
+                      std::ios::binary | std::ios::app);
+    out << "garbage";
+  }
+  CHECK(!changed.loadNavMesh("test_cache.navmesh"));
+}
+
 TEST(NavTest, PathFinderTestCases) {
   PathFinder pf;
   pf.loadNavMesh("test.navmesh");
@@ -111,4 +226,1132 @@ TEST(NavTest, BuildNavMeshFromMeshTest) {
   PathFinder pf;
   pf.build(bs, mesh);
   testPathFinder(pf);
+
+  const NavMeshBuildStats& stats = pf.getBuildStats();
+  LOG(INFO) << stats.report();
+  CHECK_EQ(stats.numTiles, 1);
+  CHECK_GT(stats.totalSeconds, 0);
+  CHECK_GT(stats.peakBytes, 0);
+  double stagesSeconds = 0;
+  for (const auto& stage : stats.stages) {
+    CHECK_LE(stage.peakBytes, stats.peakBytes);
+    stagesSeconds += stage.seconds;
+  }
+  CHECK_GT(stats.stages.front().seconds, 0);
+  CHECK_LE(stagesSeconds, stats.totalSeconds);
+}
+
+TEST(NavTest, BuildTiledNavMeshTest) {
+  using namespace esp::assets;
+  SceneLoader loader;
+  const AssetInfo info = AssetInfo::fromPath("test.glb");
+  const MeshData mesh = loader.load(info);
+  NavMeshSettings bs;
+  bs.setDefaults();
+  PathFinder singleTile;
+  CHECK(singleTile.build(bs, mesh));
+
+  bs.tileSize = 64;
+  PathFinder tiled;
+  CHECK(tiled.build(bs, mesh));
+  testPathFinder(tiled);
+  // Every tile only holds a part of the scene in memory
+  CHECK_GT(tiled.getBuildStats().numTiles, 1);
+  CHECK_LT(tiled.getBuildStats().peakBytes,
+           singleTile.getBuildStats().peakBytes);
+
+  // Tile boundaries split polygons and regions, so paths through clutter can
+  // differ, but on the whole the distances should agree
+  float totalDist = 0, totalDiff = 0;
+  for (int i = 0; i < 1000; i++) {
+    ShortestPath path;
+    path.requestedStart = singleTile.getRandomNavigablePoint();
+    path.requestedEnd = singleTile.getRandomNavigablePoint();
+    if (!tiled.isNavigable(path.requestedStart) ||
+        !tiled.isNavigable(path.requestedEnd))
+      continue;
+    ShortestPath tiledPath = path;
+    if (!singleTile.findPath(path) || !tiled.findPath(tiledPath))
+      continue;
+    totalDist += path.geodesicDistance;
+    totalDiff += std::abs(path.geodesicDistance - tiledPath.geodesicDistance);
+  }
+  CHECK_LE(totalDiff, 0.05 * totalDist);
+
+  for (int version : {1, 2}) {
+    const std::string file =
+        "tiled_test_v" + std::to_string(version) + ".navmesh";
+    CHECK(tiled.saveNavMesh(file, version));
+    PathFinder loaded;
+    CHECK(loaded.loadNavMesh(file));
+    for (int i = 0; i < 100; i++) {
+      ShortestPath path;
+      path.requestedStart = tiled.getRandomNavigablePoint();
+      path.requestedEnd = tiled.getRandomNavigablePoint();
+      ShortestPath loadedPath = path;
+      tiled.findPath(path);
+      loaded.findPath(loadedPath);
+      CHECK_EQ(path.geodesicDistance, loadedPath.geodesicDistance);
+    }
+  }
+}
+
+TEST(NavTest, BuildMultipleNavMeshesTest) {
+  using namespace esp::assets;
+  SceneLoader loader;
+  const AssetInfo info = AssetInfo::fromPath("test.glb");
+  const MeshData mesh = loader.load(info);
+  std::vector<NavMeshSettings> settings(3);
+  for (auto& bs : settings) {
+    bs.setDefaults();
+  }
+  settings[1].agentRadius = 0.2;
+  settings[1].agentHeight = 1.0;
+  settings[2].agentRadius = 0.3;
+  settings[2].agentHeight = 1.8;
+
+  // Agents with the same climb get exactly the navmesh of a separate build
+  std::vector<PathFinder::ptr> pathFinders =
+      PathFinder::buildMultiple(settings, mesh);
+  CHECK_EQ(pathFinders.size(), settings.size());
+  for (int i = 0; i < settings.size(); i++) {
+    PathFinder separate;
+    CHECK(separate.build(settings[i], mesh));
+    CHECK(pathFinders[i]->saveNavMesh("multiple_test.navmesh"));
+    CHECK(separate.saveNavMesh("separate_test.navmesh"));
+    std::ifstream multipleFile("multiple_test.navmesh", std::ios::binary);
+    std::ifstream separateFile("separate_test.navmesh", std::ios::binary);
+    const std::string multipleData(
+        (std::istreambuf_iterator<char>(multipleFile)),
+        std::istreambuf_iterator<char>());
+    const std::string separateData(
+        (std::istreambuf_iterator<char>(separateFile)),
+        std::istreambuf_iterator<char>());
+    CHECK(multipleData == separateData);
+  }
+  testPathFinder(*pathFinders[0]);
+
+  // Tiles are rasterized with the border of the widest agent and cropped for
+  // the others.  Recast piles up the geometry beyond the edge of a heightfield
+  // in its outermost cells, so the borders of the tiles differ slightly from
+  // a separate build
+  for (auto& bs : settings) {
+    bs.tileSize = 64;
+  }
+  pathFinders = PathFinder::buildMultiple(settings, mesh);
+  CHECK_EQ(pathFinders.size(), settings.size());
+  CHECK_GT(pathFinders[0]->getBuildStats().numTiles, 1);
+  for (int i = 0; i < settings.size(); i++) {
+    PathFinder separate;
+    CHECK(separate.build(settings[i], mesh));
+    float totalDist = 0, totalDiff = 0;
+    for (int j = 0; j < 200; j++) {
+      ShortestPath path;
+      path.requestedStart = separate.getRandomNavigablePoint();
+      path.requestedEnd = separate.getRandomNavigablePoint();
+      ShortestPath multiplePath = path;
+      if (!separate.findPath(path) || !pathFinders[i]->findPath(multiplePath))
+        continue;
+      totalDist += path.geodesicDistance;
+      totalDiff +=
+          std::abs(path.geodesicDistance - multiplePath.geodesicDistance);
+    }
+    CHECK_GT(totalDist, 0);
+    CHECK_LE(totalDiff, 0.01 * totalDist);
+  }
+
+  // Every agent filters the shared heightfield in place, the agents after the
+  // widest one must not get its filtering
+  std::reverse(settings.begin(), settings.end());
+  pathFinders = PathFinder::buildMultiple(settings, mesh);
+  CHECK_EQ(pathFinders.size(), settings.size());
+  for (int i = 0; i < settings.size(); i++) {
+    PathFinder separate;
+    CHECK(separate.build(settings[i], mesh));
+    int numSamples = 0, numMismatches = 0;
+    for (int j = 0; j < 1000; j++) {
+      const vec3f separatePt = separate.getRandomNavigablePoint();
+      const vec3f multiplePt = pathFinders[i]->getRandomNavigablePoint();
+      numMismatches += !pathFinders[i]->isNavigable(separatePt);
+      numMismatches += !separate.isNavigable(multiplePt);
+      numSamples += 2;
+    }
+    // Up to the tile borders, which differ as above
+    CHECK_LE(numMismatches, 0.02 * numSamples);
+  }
+
+  // The agents have to share the voxelization
+  settings[1].cellSize *= 2;
+  CHECK(PathFinder::buildMultiple(settings, mesh).empty());
+}
+
+TEST(NavTest, RebuildNavMeshTilesTest) {
+  using namespace esp::assets;
+  SceneLoader loader;
+  const AssetInfo info = AssetInfo::fromPath("test.glb");
+  const MeshData mesh = loader.load(info);
+  box3f bounds;
+  for (const vec3f& v : mesh.vbo) {
+    bounds.extend(v);
+  }
+
+  // Split the scene in two with a wall that stays within the original bounds
+  const vec3f center = bounds.center();
+  const box3f wall(vec3f(center[0] - 0.1, bounds.min()[1], bounds.min()[2]),
+                   vec3f(center[0] + 0.1, bounds.max()[1], bounds.max()[2]));
+  MeshData walledMesh = mesh;
+  const uint32_t base = walledMesh.vbo.size();
+  for (int i = 0; i < 8; i++) {
+    walledMesh.vbo.emplace_back(wall.corner(static_cast<box3f::CornerType>(i)));
+  }
+  // Corners are indexed by bits x, y, z; the two large faces suffice
+  for (const uint32_t idx : {0, 2, 6, 0, 6, 4, 1, 5, 7, 1, 7, 3}) {
+    walledMesh.ibo.push_back(base + idx);
+  }
+
+  NavMeshSettings bs;
+  bs.setDefaults();
+  bs.tileSize = 64;
+  PathFinder rebuilt;
+  CHECK(rebuilt.build(bs, mesh));
+  PathFinder walled;
+  CHECK(walled.build(bs, walledMesh));
+
+  // Rebuilding the tiles the wall touches must match building from scratch.
+  // Island radii are summed up in a different order, so they may differ in
+  // the last bits.
+  CHECK(rebuilt.rebuildTiles(walledMesh, {wall}));
+  for (int i = 0; i < 1000; i++) {
+    ShortestPath path;
+    path.requestedStart = walled.getRandomNavigablePoint();
+    path.requestedEnd = walled.getRandomNavigablePoint();
+    ShortestPath rebuiltPath = path;
+    CHECK_EQ(walled.findPath(path), rebuilt.findPath(rebuiltPath));
+    CHECK_EQ(path.geodesicDistance, rebuiltPath.geodesicDistance);
+    CHECK_LE(std::abs(walled.islandRadius(path.requestedStart) -
+                      rebuilt.islandRadius(path.requestedStart)),
+             1e-3);
+  }
+
+  // And removing the wall again restores the original navmesh
+  PathFinder original;
+  CHECK(original.build(bs, mesh));
+  CHECK(rebuilt.rebuildTiles(mesh, {wall}));
+  for (int i = 0; i < 1000; i++) {
+    ShortestPath path;
+    path.requestedStart = original.getRandomNavigablePoint();
+    path.requestedEnd = original.getRandomNavigablePoint();
+    ShortestPath rebuiltPath = path;
+    CHECK_EQ(original.findPath(path), rebuilt.findPath(rebuiltPath));
+    CHECK_EQ(path.geodesicDistance, rebuiltPath.geodesicDistance);
+    CHECK_LE(std::abs(original.islandRadius(path.requestedStart) -
+                      rebuilt.islandRadius(path.requestedStart)),
+             1e-3);
+  }
+}
+
+TEST(NavTest, PathFinderBatchTest) {
+  PathFinder pf;
+  pf.loadNavMesh("test.navmesh");
+
+  std::vector<ShortestPath> paths(1000);
+  for (auto& path : paths) {
+    path.requestedStart = pf.getRandomNavigablePoint();
+    path.requestedEnd = pf.getRandomNavigablePoint();
+  }
+  std::vector<ShortestPath> expected = paths;
+  for (auto& path : expected) {
+    pf.findPath(path);
+  }
+
+  pf.findPaths(paths);
+  for (int i = 0; i < paths.size(); i++) {
+    CHECK_EQ(paths[i].geodesicDistance, expected[i].geodesicDistance);
+    CHECK_EQ(paths[i].points.size(), expected[i].points.size());
+    for (int j = 0; j < paths[i].points.size(); j++) {
+      CHECK(paths[i].points[j] == expected[i].points[j]);
+    }
+  }
+
+  // Steps of all lengths, some of them into walls
+  core::Random random(0);
+  std::vector<vec3f> starts, ends;
+  for (const auto& path : paths) {
+    starts.push_back(path.requestedStart);
+    ends.push_back(path.requestedStart +
+                   vec3f(random.uniform_float(-1, 1), 0,
+                         random.uniform_float(-1, 1)));
+  }
+  std::vector<vec3f> stepEnds;
+  pf.trySteps(starts, ends, stepEnds);
+  CHECK_EQ(stepEnds.size(), starts.size());
+  for (int i = 0; i < starts.size(); i++) {
+    CHECK(stepEnds[i] == pf.tryStep(starts[i], ends[i]));
+  }
+}
+
+TEST(NavTest, GeodesicDistanceFieldTest) {
+  PathFinder pf;
+  pf.loadNavMesh("test.navmesh");
+
+  std::vector<vec3f> goals;
+  for (int i = 0; i < 3; i++) {
+    goals.emplace_back(pf.getRandomNavigablePoint());
+  }
+
+  float totalExact = 0, totalField = 0;
+  for (int i = 0; i < 500; i++) {
+    const vec3f start = pf.getRandomNavigablePoint();
+    float exact = std::numeric_limits<float>::infinity();
+    for (const vec3f& goal : goals) {
+      ShortestPath path;
+      path.requestedStart = start;
+      path.requestedEnd = goal;
+      pf.findPath(path);
+      exact = std::min(exact, path.geodesicDistance);
+    }
+
+    const float dist = pf.geodesicDistanceToGoals(start, goals);
+    if (std::isinf(exact)) {
+      CHECK(std::isinf(dist));
+      continue;
+    }
+    CHECK_GE(dist, 0.95 * exact - 1e-3);
+    CHECK_LE(dist, 1.5 * exact + 0.5);
+    totalExact += exact;
+    totalField += dist;
+  }
+  LOG(INFO) << "Distance field is off by "
+            << 100 * (totalField / totalExact - 1) << "% on average";
+  CHECK_LE(totalField, 1.1 * totalExact);
+}
+
+TEST(NavTest, PathFinderMultithreadedTest) {
+  PathFinder pf;
+  pf.loadNavMesh("test.navmesh");
+  pf.seed(0);
+
+  struct Query {
+    ShortestPath path;
+    vec3f stepDir;
+    vec3f stepEnd;
+    bool navigable;
+    HitRecord closestObstacle;
+  };
+
+  // Compute the expected results single-threaded
+  core::Random random(0);
+  std::vector<Query> expected(500);
+  for (auto& query : expected) {
+    query.path.requestedStart = pf.getRandomNavigablePoint();
+    query.path.requestedEnd = pf.getRandomNavigablePoint();
+    pf.findPath(query.path);
+
+    query.stepDir = vec3f(random.uniform_float(-1, 1), 0,
+                          random.uniform_float(-1, 1));
+    const vec3f& start = query.path.requestedStart;
+    query.stepEnd = pf.tryStep(start, start + 0.25 * query.stepDir);
+    query.navigable = pf.isNavigable(start + query.stepDir);
+    query.closestObstacle =
+        pf.closestObstacleSurfacePoint(query.path.requestedEnd);
+  }
+
+  // Then hammer the same pathfinder from many threads at once, each thread
+  // walking through the queries in a different order
+  constexpr int numThreads = 16;
+  std::vector<std::thread> threads;
+  for (int iThread = 0; iThread < numThreads; ++iThread) {
+    threads.emplace_back([&pf, &expected, iThread]() {
+      for (int i = 0; i < 5 * expected.size(); ++i) {
+        const Query& query = expected[(i + 31 * iThread) % expected.size()];
+
+        ShortestPath path;
+        path.requestedStart = query.path.requestedStart;
+        path.requestedEnd = query.path.requestedEnd;
+        pf.findPath(path);
+        CHECK_EQ(path.geodesicDistance, query.path.geodesicDistance);
+        CHECK_EQ(path.points.size(), query.path.points.size());
+        for (int j = 0; j < path.points.size(); j++) {
+          CHECK(path.points[j] == query.path.points[j]);
+        }
+
+        CHECK(pf.tryStep(path.requestedStart,
+                         path.requestedStart + 0.25 * query.stepDir) ==
+              query.stepEnd);
+        CHECK_EQ(pf.isNavigable(path.requestedStart + query.stepDir),
+                 query.navigable);
+
+        const HitRecord hit = pf.closestObstacleSurfacePoint(path.requestedEnd);
+        CHECK_EQ(hit.hitDist, query.closestObstacle.hitDist);
+        CHECK(hit.hitPos == query.closestObstacle.hitPos);
+
+        CHECK(pf.isNavigable(pf.getRandomNavigablePoint()));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+TEST(NavTest, ActionSpacePathFinderTest) {
+  PathFinder::ptr pf = PathFinder::create();
+  pf->loadNavMesh("test.navmesh");
+  pf->seed(0);
+
+  const float forwardAmount = 0.25, goalDist = 0.2;
+  const float turnAmount = M_PI / 18;
+  ActionSpacePathFinder planner(pf, forwardAmount, turnAmount, goalDist);
+
+  int numPlanned = 0;
+  for (int i = 0; i < 20; i++) {
+    ShortestPath path;
+    path.requestedStart = pf->getRandomNavigablePoint();
+    path.requestedEnd = pf->getRandomNavigablePoint();
+    if (!pf->findPath(path) || path.geodesicDistance < goalDist)
+      continue;
+
+    const quatf startRot(Eigen::AngleAxisf(0.1 * i, geo::ESP_UP));
+    const std::vector<ActionSpacePathFinder::CODES> actions = planner.findPath(
+        std::make_tuple(path.requestedStart, startRot), path.requestedEnd);
+    CHECK(!actions.empty());
+    CHECK(actions.back() == ActionSpacePathFinder::CODES::STOP);
+
+    // Replay the plan the way the agent's controls and step filter would.
+    // The follower stops at the first state that findPath puts within
+    // goalDist, so an optimal plan doesn't go through one before the end
+    auto geodesicDistance = [&pf, &path](const vec3f& pos) {
+      ShortestPath toGoal;
+      toGoal.requestedStart = pos;
+      toGoal.requestedEnd = path.requestedEnd;
+      pf->findPath(toGoal);
+      return toGoal.geodesicDistance;
+    };
+    vec3f pos = path.requestedStart;
+    quatf rot = startRot;
+    int numForward = 0;
+    for (auto action : actions) {
+      if (action == ActionSpacePathFinder::CODES::STOP)
+        break;
+      CHECK_GE(geodesicDistance(pos), goalDist);
+      if (action == ActionSpacePathFinder::CODES::FORWARD) {
+        pos = pf->tryStep(pos, pos + forwardAmount * (rot * geo::ESP_FRONT));
+        ++numForward;
+      } else if (action == ActionSpacePathFinder::CODES::LEFT) {
+        rot = rot * quatf(Eigen::AngleAxisf(turnAmount, geo::ESP_UP));
+      } else if (action == ActionSpacePathFinder::CODES::RIGHT) {
+        rot = rot * quatf(Eigen::AngleAxisf(-turnAmount, geo::ESP_UP));
+      }
+    }
+    CHECK_LT(geodesicDistance(pos), goalDist);
+    // findPath isn't exact, allow some slack
+    CHECK_GE(numForward * forwardAmount + goalDist,
+             0.9 * path.geodesicDistance);
+    ++numPlanned;
+  }
+  CHECK_GT(numPlanned, 0);
+}
+
+TEST(NavTest, PathCorridorTest) {
+  PathFinder::ptr pf = PathFinder::create();
+  pf->loadNavMesh("test.navmesh");
+  pf->seed(0);
+
+  PathCorridor corridor(pf);
+  int numSteps = 0;
+  float totalExact = 0, totalCorridor = 0;
+  for (int i = 0; i < 100; i++) {
+    ShortestPath path;
+    path.requestedStart = pf->getRandomNavigablePoint();
+    path.requestedEnd = pf->getRandomNavigablePoint();
+
+    // Walk along the path like an agent would and compare against a new
+    // search at every step
+    for (int step = 0; step < 200; step++) {
+      ShortestPath exact;
+      exact.requestedStart = path.requestedStart;
+      exact.requestedEnd = path.requestedEnd;
+      const bool found = pf->findPath(exact);
+      CHECK_EQ(corridor.findPath(path), found);
+      if (!found || exact.geodesicDistance < 0.25)
+        break;
+
+      // The corridor can come out shorter, as the search of findPath isn't
+      // optimal either
+      CHECK_GE(path.points.size(), 2);
+      CHECK_LE(path.geodesicDistance, 1.1 * exact.geodesicDistance + 0.1);
+      totalExact += exact.geodesicDistance;
+      totalCorridor += path.geodesicDistance;
+      ++numSteps;
+
+      const vec3f dir = (path.points[1] - path.points[0]).normalized();
+      path.requestedStart =
+          pf->tryStep(path.requestedStart, path.requestedStart + 0.25 * dir);
+    }
+  }
+  LOG(INFO) << numSteps << " steps with " << corridor.getNumReplans()
+            << " full searches, corridor paths are off by "
+            << 100 * (totalCorridor / totalExact - 1) << "% on average";
+  CHECK_GT(numSteps, 0);
+  CHECK_LT(corridor.getNumReplans(), numSteps / 2);
+  CHECK_LE(totalCorridor, 1.01 * totalExact);
+
+  // Loading a navmesh invalidates the corridor, even when the navmesh cache
+  // hands back the same navmesh
+  ShortestPath path;
+  do {
+    path.requestedStart = pf->getRandomNavigablePoint();
+    path.requestedEnd = pf->getRandomNavigablePoint();
+  } while (!corridor.findPath(path));
+  const int numReplans = corridor.getNumReplans();
+  CHECK(corridor.findPath(path));
+  CHECK_EQ(corridor.getNumReplans(), numReplans);
+  CHECK(pf->loadNavMesh("test.navmesh"));
+  CHECK(corridor.findPath(path));
+  CHECK_EQ(corridor.getNumReplans(), numReplans + 1);
+}
+
+TEST(NavTest, ObstacleDistanceGridTest) {
+  PathFinder pf;
+  pf.loadNavMesh("test.navmesh");
+  pf.seed(0);
+
+  std::vector<vec3f> points;
+  std::vector<HitRecord> expected;
+  for (int i = 0; i < 2000; i++) {
+    points.push_back(pf.getRandomNavigablePoint());
+    expected.push_back(pf.closestObstacleSurfacePoint(points.back()));
+  }
+
+  const float cellSize = 0.05;
+  pf.setObstacleDistanceGridCellSize(cellSize);
+  CHECK_EQ(pf.getObstacleDistanceGridCellSize(), cellSize);
+  std::vector<float> distErrors, posErrors;
+  for (int i = 0; i < points.size(); i++) {
+    const HitRecord hit = pf.closestObstacleSurfacePoint(points[i]);
+    CHECK_EQ(pf.distanceToClosestObstacle(points[i]), hit.hitDist);
+    CHECK_LE(hit.hitDist, 2.0);
+    distErrors.push_back(std::abs(hit.hitDist - expected[i].hitDist));
+    if (expected[i].hitDist < 2.0) {
+      posErrors.push_back(
+          (Eigen::Vector2f(hit.hitPos[0], hit.hitPos[2]) -
+           Eigen::Vector2f(expected[i].hitPos[0], expected[i].hitPos[2]))
+              .norm());
+    }
+  }
+
+  // The distance to a straight wall is linear, so the interpolation is exact
+  // almost everywhere.  Corners and points halfway between two walls, where
+  // the closest wall switches, are off by up to a few cells
+  std::sort(distErrors.begin(), distErrors.end());
+  std::sort(posErrors.begin(), posErrors.end());
+  CHECK_LT(distErrors[distErrors.size() / 2], 1e-3);
+  CHECK_LT(distErrors[distErrors.size() * 95 / 100], cellSize / 2);
+  CHECK_LT(distErrors.back(), 5 * cellSize);
+  CHECK_LT(posErrors[posErrors.size() * 95 / 100], cellSize);
+
+  // Back to the exact search
+  pf.setObstacleDistanceGridCellSize(0);
+  for (int i = 0; i < points.size(); i++) {
+    CHECK_EQ(pf.distanceToClosestObstacle(points[i]), expected[i].hitDist);
+  }
+}
+
+void testPolyGridIndex(PathFinder& pf) {
+  pf.seed(0);
+
+  // Points on the navmesh, slightly above or below it, and anywhere around it
+  core::Random random(0);
+  std::vector<vec3f> points;
+  for (int i = 0; i < 3000; i++) {
+    const vec3f pt = pf.getRandomNavigablePoint();
+    const vec3f offset(random.uniform_float(-1, 1),
+                       random.uniform_float(-1, 1),
+                       random.uniform_float(-1, 1));
+    switch (i % 3) {
+      case 0:
+        points.push_back(pt);
+        break;
+      case 1:
+        points.push_back(pt + vec3f(0, 0.5 * offset[1], 0));
+        break;
+      default:
+        points.push_back(pt + 3 * offset);
+    }
+  }
+
+  std::vector<vec3f> expected;
+  std::vector<bool> expectedNavigable;
+  std::vector<float> expectedRadius;
+  for (const auto& pt : points) {
+    expected.push_back(pf.snapPoint(pt));
+    expectedNavigable.push_back(pf.isNavigable(pt));
+    expectedRadius.push_back(pf.islandRadius(pt));
+  }
+
+  for (float cellSize : {0.25f, 1.0f, 4.0f}) {
+    pf.setPolyGridIndexCellSize(cellSize);
+    CHECK_EQ(pf.getPolyGridIndexCellSize(), cellSize);
+    std::vector<vec3f> snapped;
+    pf.snapPoints(points, snapped);
+    for (int i = 0; i < points.size(); i++) {
+      // NaN if there is no navmesh close by
+      CHECK(snapped[i] == expected[i] ||
+            (snapped[i].hasNaN() && expected[i].hasNaN()));
+      CHECK(pf.snapPoint(points[i]) == snapped[i] || snapped[i].hasNaN());
+      CHECK_EQ(pf.isNavigable(points[i]), expectedNavigable[i]);
+      CHECK_EQ(pf.islandRadius(points[i]), expectedRadius[i]);
+    }
+  }
+}
+
+TEST(NavTest, PolyGridIndexTest) {
+  PathFinder pf;
+  pf.loadNavMesh("test.navmesh");
+  testPolyGridIndex(pf);
+
+  // Polygons of different tiles overlap the same cells, the index needs to
+  // visit them in the same order as Detour
+  using namespace esp::assets;
+  SceneLoader loader;
+  const MeshData mesh = loader.load(AssetInfo::fromPath("test.glb"));
+  NavMeshSettings bs;
+  bs.setDefaults();
+  bs.tileSize = 64;
+  PathFinder tiled;
+  CHECK(tiled.build(bs, mesh));
+  testPolyGridIndex(tiled);
+}
+
+// Floor of numRows strips along x, each joined to the next one at
+// alternating ends, so the only way from the first strip to the last one runs
+// along all of them
+void makeSerpentine(int numRows,
+                    float rowLength,
+                    float rowWidth,
+                    std::vector<float>& verts,
+                    std::vector<int>& tris) {
+  auto addQuad = [&](float x0, float z0, float x1, float z1) {
+    const int base = verts.size() / 3;
+    for (const auto& corner : {std::make_pair(x0, z0), std::make_pair(x1, z0),
+                               std::make_pair(x1, z1), std::make_pair(x0, z1)})
+      verts.insert(verts.end(), {corner.first, 0, corner.second});
+    // Wound so that the normals point up
+    tris.insert(tris.end(),
+                {base, base + 2, base + 1, base, base + 3, base + 2});
+  };
+  for (int i = 0; i < numRows; ++i) {
+    const float z = 2 * i * rowWidth;
+    addQuad(0, z, rowLength, z + rowWidth);
+    if (i + 1 < numRows) {
+      const float x = i % 2 == 0 ? rowLength - rowWidth : 0;
+      addQuad(x, z, x + rowWidth, z + 3 * rowWidth);
+    }
+  }
+}
+
+TEST(NavTest, ClusterGraphTest) {
+  PathFinder pf, clustered;
+  CHECK(pf.loadNavMesh("test.navmesh"));
+  CHECK(clustered.loadNavMesh("test.navmesh"));
+  clustered.setClusterGraphCellSize(2.0);
+  CHECK_EQ(clustered.getClusterGraphCellSize(), 2.0);
+
+  // The abstract path only narrows down where the refinement searches, so
+  // the same pairs are connected and the distances are about the same
+  float totalDist = 0, totalDiff = 0;
+  for (int i = 0; i < 1000; i++) {
+    ShortestPath path;
+    path.requestedStart = pf.getRandomNavigablePoint();
+    path.requestedEnd = pf.getRandomNavigablePoint();
+    ShortestPath clusteredPath = path;
+    CHECK_EQ(pf.findPath(path), clustered.findPath(clusteredPath));
+    if (path.points.empty())
+      continue;
+    CHECK_LE(clusteredPath.geodesicDistance, 1.1 * path.geodesicDistance);
+    CHECK(clusteredPath.points.front().isApprox(path.points.front()));
+    CHECK(clusteredPath.points.back().isApprox(path.points.back()));
+    totalDist += path.geodesicDistance;
+    totalDiff += clusteredPath.geodesicDistance - path.geodesicDistance;
+  }
+  CHECK_LE(totalDiff, 0.01 * totalDist);
+
+  // Closest of several goals
+  MultiGoalShortestPath multiPath;
+  multiPath.requestedStart = pf.getRandomNavigablePoint();
+  for (int i = 0; i < 5; i++)
+    multiPath.requestedEnds.push_back(pf.getRandomNavigablePoint());
+  MultiGoalShortestPath clusteredMultiPath = multiPath;
+  CHECK_EQ(pf.findPath(multiPath), clustered.findPath(clusteredMultiPath));
+  CHECK_LE(clusteredMultiPath.geodesicDistance,
+           1.1 * multiPath.geodesicDistance);
+
+  // A path through hundreds of polygons, with and without the graph
+  const int numRows = 30;
+  const float rowLength = 10, rowWidth = 0.6;
+  std::vector<float> verts;
+  std::vector<int> tris;
+  makeSerpentine(numRows, rowLength, rowWidth, verts, tris);
+  const float bmin[3] = {-1, -1, -1};
+  const float bmax[3] = {rowLength + 1, 1, 2 * numRows * rowWidth + 1};
+  NavMeshSettings bs;
+  bs.setDefaults();
+  bs.tileSize = 16;
+  PathFinder serpentine;
+  CHECK(serpentine.build(bs, verts.data(), verts.size() / 3, tris.data(),
+                         tris.size() / 3, bmin, bmax));
+  ShortestPath longPath;
+  longPath.requestedStart = serpentine.snapPoint({1, 0, rowWidth / 2});
+  longPath.requestedEnd = serpentine.snapPoint(
+      {rowLength - 1, 0, 2 * (numRows - 1) * rowWidth + rowWidth / 2});
+  CHECK(serpentine.findPath(longPath));
+  CHECK_GT(longPath.geodesicDistance, numRows * (rowLength - 2 * rowWidth));
+
+  serpentine.setClusterGraphCellSize(2.0);
+  ShortestPath clusteredLongPath = longPath;
+  CHECK(serpentine.findPath(clusteredLongPath));
+  CHECK_LE(std::abs(clusteredLongPath.geodesicDistance -
+                    longPath.geodesicDistance),
+           0.01 * longPath.geodesicDistance);
+}
+
+TEST(NavTest, LongPathCorridorTest) {
+  // Small tiles cut the strips into far more polygons than a fixed size
+  // corridor holds
+  const int numRows = 40;
+  const float rowLength = 10, rowWidth = 0.6;
+  std::vector<float> verts;
+  std::vector<int> tris;
+  makeSerpentine(numRows, rowLength, rowWidth, verts, tris);
+  const float bmin[3] = {-1, -1, -1};
+  const float bmax[3] = {rowLength + 1, 1, 2 * numRows * rowWidth + 1};
+  NavMeshSettings bs;
+  bs.setDefaults();
+  bs.tileSize = 16;
+  PathFinder::ptr pf = PathFinder::create();
+  CHECK(pf->build(bs, verts.data(), verts.size() / 3, tris.data(),
+                  tris.size() / 3, bmin, bmax));
+
+  ShortestPath exact;
+  exact.requestedStart = pf->snapPoint({1, 0, rowWidth / 2});
+  exact.requestedEnd = pf->snapPoint(
+      {rowLength - 1, 0, 2 * (numRows - 1) * rowWidth + rowWidth / 2});
+  CHECK(pf->findPath(exact));
+  CHECK_GT(exact.geodesicDistance, numRows * (rowLength - 2 * rowWidth));
+
+  PathCorridor corridor(pf);
+  ShortestPath path;
+  path.requestedStart = exact.requestedStart;
+  path.requestedEnd = exact.requestedEnd;
+  for (int step = 0; step < 20; step++) {
+    CHECK(corridor.findPath(path));
+    exact.requestedStart = path.requestedStart;
+    CHECK(pf->findPath(exact));
+    CHECK_LE(std::abs(path.geodesicDistance - exact.geodesicDistance),
+             0.01 * exact.geodesicDistance);
+    CHECK(path.points.back().isApprox(exact.points.back()));
+
+    const vec3f dir = (path.points[1] - path.points[0]).normalized();
+    path.requestedStart =
+        pf->tryStep(path.requestedStart, path.requestedStart + 0.25 * dir);
+  }
+  CHECK_EQ(corridor.getNumReplans(), 1);
+}
+
+TEST(NavTest, RandomNavigablePointsTest) {
+  PathFinder pf;
+  CHECK(pf.loadNavMesh("test.navmesh"));
+
+  const int numPoints = 10000;
+  core::Random random(7), sameSeed(7);
+  std::vector<vec3f> points, samePoints;
+  CHECK(pf.getRandomNavigablePoints(numPoints, random, points));
+  CHECK(pf.getRandomNavigablePoints(numPoints, sameSeed, samePoints));
+  CHECK(points == samePoints);
+
+  // The points are spread over the islands like the ones of
+  // getRandomNavigablePoint, islands are told apart by their area
+  pf.seed(7);
+  std::map<float, int> islandPoints, expectedIslandPoints;
+  for (const vec3f& pt : points) {
+    CHECK(pf.isNavigable(pt));
+    ++islandPoints[pf.islandArea(pt)];
+    ++expectedIslandPoints[pf.islandArea(pf.getRandomNavigablePoint())];
+  }
+  CHECK_EQ(islandPoints.size(), expectedIslandPoints.size());
+  for (const auto& island : islandPoints)
+    CHECK_LE(std::abs(island.second - expectedIslandPoints[island.first]),
+             0.02 * numPoints);
+
+  const float largestArea = islandPoints.rbegin()->first;
+  points.clear();
+  CHECK(pf.getRandomNavigablePoints(1000, random, points, 0.0, true));
+  CHECK_EQ(points.size(), 1000);
+  for (const vec3f& pt : points)
+    CHECK_EQ(pf.islandArea(pt), largestArea);
+
+  points.clear();
+  const float minIslandRadius = 1.0;
+  CHECK(pf.getRandomNavigablePoints(1000, random, points, minIslandRadius));
+  for (const vec3f& pt : points)
+    CHECK_GE(pf.islandRadius(pt), minIslandRadius);
+
+  points.clear();
+  CHECK(!pf.getRandomNavigablePoints(1000, random, points, 1e6));
+  CHECK(points.empty());
+}
+
+TEST(NavTest, PointNavEpisodeGeneratorTest) {
+  PathFinder pf;
+  CHECK(pf.loadNavMesh("test.navmesh"));
+
+  PointNavEpisodeSettings settings;
+  settings.numEpisodes = 200;
+  settings.minGeodesicDistance = 2.0;
+  settings.maxGeodesicDistance = 10.0;
+  settings.minGeodesicToEuclideanRatio = 1.05;
+  const std::vector<PointNavEpisode> episodes =
+      generatePointNavEpisodes(pf, settings, 1);
+  CHECK_EQ(episodes.size(), settings.numEpisodes);
+  for (const PointNavEpisode& episode : episodes) {
+    CHECK(pf.isNavigable(episode.start));
+    CHECK(pf.isNavigable(episode.goal));
+    CHECK_GE(episode.geodesicDistance, settings.minGeodesicDistance);
+    CHECK_LE(episode.geodesicDistance, settings.maxGeodesicDistance);
+    CHECK_GE(episode.geodesicDistance,
+             settings.minGeodesicToEuclideanRatio * episode.euclideanDistance);
+
+    ShortestPath path;
+    path.requestedStart = episode.start;
+    path.requestedEnd = episode.goal;
+    CHECK(pf.findPath(path));
+    CHECK_EQ(path.geodesicDistance, episode.geodesicDistance);
+  }
+
+  // The same seed gives the same episodes
+  const std::vector<PointNavEpisode> again =
+      generatePointNavEpisodes(pf, settings, 1);
+  CHECK_EQ(again.size(), episodes.size());
+  for (int i = 0; i < episodes.size(); ++i) {
+    CHECK(again[i].start == episodes[i].start);
+    CHECK(again[i].goal == episodes[i].goal);
+    CHECK(again[i].startRotation.coeffs() ==
+          episodes[i].startRotation.coeffs());
+  }
+  CHECK(generatePointNavEpisodes(pf, settings, 2)[0].start !=
+        episodes[0].start);
+
+  // Impossible constraints run out of candidates
+  settings.numEpisodes = 10;
+  settings.minGeodesicDistance = 1e6;
+  settings.maxGeodesicDistance = 2e6;
+  settings.maxCandidatesPerEpisode = 10;
+  CHECK(generatePointNavEpisodes(pf, settings, 1).empty());
+}
+
+TEST(NavTest, GeodesicDistanceMatrixTest) {
+  PathFinder pf;
+  CHECK(pf.loadNavMesh("test.navmesh"));
+
+  const int numPoints = 40;
+  std::vector<vec3f> points;
+  for (int i = 0; i < numPoints; ++i)
+    points.push_back(pf.getRandomNavigablePoint());
+  // Off the navmesh
+  points.push_back(vec3f::Constant(1e6));
+
+  const Eigen::MatrixXf distances = pf.geodesicDistanceMatrix(points);
+  CHECK_EQ(distances.rows(), numPoints + 1);
+  CHECK_EQ(distances.cols(), numPoints + 1);
+  const Eigen::MatrixXf bounds = pf.geodesicDistanceMatrix(points, false);
+  float total = 0, expectedTotal = 0;
+  for (int i = 0; i < numPoints; ++i) {
+    CHECK_EQ(distances(i, i), 0);
+    CHECK(std::isinf(distances(i, numPoints)));
+    CHECK(std::isinf(distances(numPoints, i)));
+    for (int j = 0; j < numPoints; ++j) {
+      CHECK_EQ(distances(i, j), distances(j, i));
+      CHECK_LE(distances(i, j), bounds(i, j));
+
+      ShortestPath path;
+      path.requestedStart = points[i];
+      path.requestedEnd = points[j];
+      if (!pf.findPath(path)) {
+        CHECK(std::isinf(distances(i, j)));
+        continue;
+      }
+      // Refined with the path from the point with the lower index
+      if (i < j)
+        CHECK_LE(distances(i, j), path.geodesicDistance * (1 + 1e-4));
+      CHECK_GE(distances(i, j), (points[i] - points[j]).norm() - 1e-4);
+      total += distances(i, j);
+      expectedTotal += path.geodesicDistance;
+    }
+  }
+  CHECK_GE(total, 0.99 * expectedTotal);
+}
+
+TEST(NavTest, RaycastTest) {
+  PathFinder pf;
+  CHECK(pf.loadNavMesh("test.navmesh"));
+
+  const int numRays = 1000;
+  std::vector<vec3f> starts, ends;
+  for (int i = 0; i < numRays; ++i) {
+    starts.push_back(pf.getRandomNavigablePoint());
+    ends.push_back(pf.getRandomNavigablePoint());
+  }
+  std::vector<RaycastHit> hits;
+  pf.raycasts(starts, ends, hits);
+  CHECK_EQ(hits.size(), numRays);
+
+  int numReached = 0;
+  for (int i = 0; i < numRays; ++i) {
+    const RaycastHit hit = pf.raycast(starts[i], ends[i]);
+    CHECK(hit.hitPos == hits[i].hitPos);
+    CHECK_EQ(hit.reached, hits[i].reached);
+
+    ShortestPath path;
+    path.requestedStart = starts[i];
+    path.requestedEnd = ends[i];
+    const bool found = pf.findPath(path);
+    CHECK(pf.isNavigable(hit.hitPos));
+    if (hit.reached) {
+      // Nothing in the way, the path is the straight line
+      ++numReached;
+      CHECK(found);
+      CHECK_LE((hit.hitPos - ends[i]).norm(), 1e-4);
+      CHECK_LE(std::abs(path.geodesicDistance - hit.hitDist), 1e-3);
+      CHECK(hit.hitNormal == vec3f::Zero());
+    } else {
+      CHECK_LE(hit.hitDist, (ends[i] - starts[i]).norm() + 1e-3);
+      if (found)
+        CHECK_GT(path.geodesicDistance, hit.hitDist);
+    }
+  }
+  CHECK_GT(numReached, 0);
+  CHECK_LT(numReached, numRays);
+
+  // The ray from one strip of a serpentine to the next hits the border
+  std::vector<float> verts;
+  std::vector<int> tris;
+  makeSerpentine(2, 10, 1, verts, tris);
+  NavMeshSettings bs;
+  bs.setDefaults();
+  const vec3f bmin(-1, -1, -1), bmax(11, 1, 4);
+  PathFinder serpentine;
+  CHECK(serpentine.build(bs, verts.data(), verts.size() / 3, tris.data(),
+                         tris.size() / 3, bmin.data(), bmax.data()));
+  const vec3f start(5, 0, 0.5), end(5, 0, 2.5);
+  const RaycastHit hit = serpentine.raycast(start, end);
+  CHECK(!hit.reached);
+  CHECK_LT(hit.hitPos[2], 1);
+  CHECK_LT(hit.hitNormal.dot(end - start), 0);
+  CHECK(serpentine.raycast(start, vec3f(2, 0, 0.5)).reached);
+}
+
+TEST(NavTest, TopDownViewTest) {
+  PathFinder pf;
+  CHECK(pf.loadNavMesh("test.navmesh"));
+  const box3f bounds = pf.getNavMeshBounds();
+  CHECK(!bounds.isEmpty());
+
+  const float metersPerPixel = 0.1;
+  std::vector<float> heights;
+  for (int i = 0; i < 3; ++i)
+    heights.push_back(pf.getRandomNavigablePoint()[1]);
+  const std::vector<TopDownView> views =
+      pf.getTopDownViews(metersPerPixel, heights);
+  CHECK_EQ(views.size(), heights.size());
+
+  for (int i = 0; i < heights.size(); ++i) {
+    const TopDownView& view = views[i];
+    CHECK(view == pf.getTopDownView(metersPerPixel, heights[i]));
+    CHECK_EQ(view.rows(),
+             std::ceil(bounds.sizes()[2] / metersPerPixel - 1e-4));
+    CHECK_EQ(view.cols(),
+             std::ceil(bounds.sizes()[0] / metersPerPixel - 1e-4));
+
+    // Matches isNavigable but for pixels on polygon borders
+    int numNavigable = 0, numMismatches = 0;
+    for (int row = 0; row < view.rows(); ++row) {
+      for (int col = 0; col < view.cols(); ++col) {
+        const vec3f pt(bounds.min()[0] + (col + 0.5) * metersPerPixel,
+                       heights[i],
+                       bounds.min()[2] + (row + 0.5) * metersPerPixel);
+        const bool navigable = pf.isNavigable(pt);
+        numNavigable += navigable;
+        numMismatches += navigable != (view(row, col) == 1);
+      }
+    }
+    CHECK_GT(numNavigable, 0);
+    CHECK_LE(numMismatches, 0.01 * numNavigable);
+  }
+}
+
+TEST(NavTest, ObjectGoalsTest) {
+  PathFinder pf;
+  CHECK(pf.loadNavMesh("test.navmesh"));
+
+  // An object standing on the navmesh, and one far away from it
+  const vec3f base = pf.getRandomNavigablePoint();
+  const geo::OBB object(base + vec3f(0, 0.5, 0), vec3f(0.6, 1, 0.4),
+                        quatf(Eigen::AngleAxisf(0.3, vec3f::UnitY())));
+  const float radius = 0.5;
+  CHECK(pf.setObjectGoals("object", {object}, radius));
+  const geo::OBB faraway(vec3f(1000, 0, 1000), vec3f(1, 1, 1),
+                         quatf::Identity());
+  CHECK(!pf.setObjectGoals("faraway", {faraway}));
+  CHECK(std::isinf(pf.geodesicDistanceToObjects(base, "faraway")));
+
+  CHECK_EQ(pf.geodesicDistanceToObjects(base, "object"), 0);
+  int numReachable = 0;
+  vec3f reachable;
+  for (int i = 0; i < 200; ++i) {
+    const vec3f pt = pf.getRandomNavigablePoint();
+    const float distance = pf.geodesicDistanceToObjects(pt, "object");
+    if (object.distance(vec3f(pt[0], base[1] + 0.5, pt[2])) <= radius) {
+      CHECK_EQ(distance, 0);
+      continue;
+    }
+    // Reaching the object never takes longer than getting to its base
+    const float baseDistance = pf.geodesicDistanceToGoals(pt, {base});
+    if (std::isinf(baseDistance))
+      continue;
+    ++numReachable;
+    reachable = pt;
+    CHECK_GT(distance, 0);
+    CHECK_LE(distance, baseDistance + 1e-3);
+    // Goals are within radius of the footprint, itself within 0.4 of base
+    const vec2f offset(pt[0] - base[0], pt[2] - base[2]);
+    CHECK_GE(distance, offset.norm() - radius - 0.4);
+  }
+  CHECK_GT(numReachable, 0);
+
+  // The goals survive changes of the navmesh
+  const float distance = pf.geodesicDistanceToObjects(reachable, "object");
+  CHECK(pf.loadNavMesh("test.navmesh"));
+  CHECK_EQ(pf.geodesicDistanceToObjects(reachable, "object"), distance);
+}
+
+TEST(NavTest, ObjectViewpointsTest) {
+  // A floor split in two by a wall, and a closed box on it
+  esp::assets::MeshData mesh;
+  auto addBox = [&mesh](const vec3f& bmin, const vec3f& bmax) {
+    const int base = mesh.vbo.size();
+    for (int i = 0; i < 8; ++i) {
+      mesh.vbo.emplace_back(i & 1 ? bmax[0] : bmin[0],
+                            i & 2 ? bmax[1] : bmin[1],
+                            i & 4 ? bmax[2] : bmin[2]);
+    }
+    const int faces[6][4] = {{0, 2, 3, 1}, {4, 5, 7, 6}, {0, 1, 5, 4},
+                             {2, 6, 7, 3}, {0, 4, 6, 2}, {1, 3, 7, 5}};
+    for (const auto& face : faces) {
+      for (int k : {0, 1, 2, 0, 2, 3})
+        mesh.ibo.push_back(base + face[k]);
+    }
+  };
+  addBox(vec3f(-5, -0.1, -5), vec3f(5, 0, 5));
+  addBox(vec3f(-5, 0, 0), vec3f(5, 3, 0.2));
+  addBox(vec3f(-3.5, 0, -3.5), vec3f(-2.5, 1, -2.5));
+  NavMeshSettings bs;
+  bs.setDefaults();
+  PathFinder pf;
+  CHECK(pf.build(bs, mesh));
+
+  const geo::OBB open(vec3f(0, 0.5, 1.5), vec3f(0.6, 1, 0.6),
+                      quatf::Identity());
+  const geo::OBB enclosed(vec3f(-3, 0.3, -3), vec3f(0.4, 0.6, 0.4),
+                          quatf::Identity());
+  ObjectViewpointSettings settings;
+  settings.radius = 2.0;
+  const auto viewpoints =
+      sampleObjectViewpoints(pf, mesh, {open, enclosed}, settings);
+  CHECK_EQ(viewpoints.size(), 2);
+
+  // The wall hides the object from the other side
+  CHECK_GT(viewpoints[0].size(), 0);
+  for (const vec3f& pt : viewpoints[0]) {
+    CHECK(pf.isNavigable(pt));
+    CHECK_GT(pt[2], 0.2);
+    CHECK_LE(open.distance(vec3f(pt[0], 0.5, pt[2])), settings.radius + 1e-3);
+  }
+  CHECK(viewpoints[1].empty());
+
+  settings.minIslandRadius = 100;
+  CHECK(sampleObjectViewpoints(pf, mesh, {open}, settings)[0].empty());
+}
+
+TEST(NavTest, PathCacheTest) {
+  PathFinder pf, cached;
+  CHECK(pf.loadNavMesh("test.navmesh"));
+  CHECK(cached.loadNavMesh("test.navmesh"));
+  cached.setPathCacheBudget(1 << 20, 0.1);
+  CHECK_EQ(cached.getPathCacheBudget(), 1 << 20);
+
+  std::vector<ShortestPath> paths(100);
+  for (ShortestPath& path : paths) {
+    path.requestedStart = pf.getRandomNavigablePoint();
+    path.requestedEnd = pf.getRandomNavigablePoint();
+  }
+  // Hits give the same paths as searching again.  Only connected pairs get
+  // as far as the cache
+  int numFound = 0;
+  for (int pass = 0; pass < 3; ++pass) {
+    for (const ShortestPath& query : paths) {
+      ShortestPath path = query, cachedPath = query;
+      const bool found = pf.findPath(path);
+      CHECK_EQ(found, cached.findPath(cachedPath));
+      CHECK_EQ(path.geodesicDistance, cachedPath.geodesicDistance);
+      CHECK_EQ(path.points.size(), cachedPath.points.size());
+      numFound += found;
+    }
+  }
+  CHECK_GT(numFound, 0);
+  PathCacheStats stats = cached.getPathCacheStats();
+  CHECK_EQ(stats.hits + stats.misses, numFound);
+  CHECK_EQ(stats.hits, 2 * stats.misses);
+  CHECK_EQ(stats.numEntries, stats.misses);
+  CHECK_LE(stats.numBytes, 1 << 20);
+
+  // Endpoints that share an entry but differ inside the polygons still get
+  // paths from and to exactly those points
+  for (const ShortestPath& query : paths) {
+    ShortestPath path = query, nearby = query;
+    if (!cached.findPath(path))
+      continue;
+    nearby.requestedStart =
+        cached.snapPoint(query.requestedStart + vec3f(0.01, 0, 0.01));
+    nearby.requestedEnd =
+        cached.snapPoint(query.requestedEnd - vec3f(0.01, 0, 0.01));
+    ShortestPath uncached = nearby;
+    CHECK(cached.findPath(nearby));
+    CHECK(pf.findPath(uncached));
+    CHECK(nearby.points.front().isApprox(uncached.points.front()));
+    CHECK(nearby.points.back().isApprox(uncached.points.back()));
+    CHECK_LE(std::abs(nearby.geodesicDistance - uncached.geodesicDistance),
+             0.05);
+  }
+
+  // A small budget keeps only the most recent corridors
+  cached.setPathCacheBudget(1024);
+  CHECK_EQ(cached.getPathCacheStats().numEntries, 0);
+  for (const ShortestPath& query : paths) {
+    ShortestPath path = query;
+    cached.findPath(path);
+    CHECK_LE(cached.getPathCacheStats().numBytes, 1024);
+  }
+  stats = cached.getPathCacheStats();
+  CHECK_GT(stats.numEntries, 0);
+  CHECK_LT(stats.numEntries, paths.size());
+
+  // Emptied with the navmesh, disabled with a budget of 0
+  CHECK(cached.loadNavMesh("test.navmesh"));
+  CHECK_EQ(cached.getPathCacheStats().numEntries, 0);
+  CHECK_EQ(cached.getPathCacheStats().hits, 0);
+  cached.setPathCacheBudget(0);
+  ShortestPath path = paths[0];
+  cached.findPath(path);
+  cached.findPath(path);
+  CHECK_EQ(cached.getPathCacheStats().misses, 0);
 }
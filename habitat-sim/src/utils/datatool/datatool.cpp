@@ -2,9 +2,15 @@
 // This source code is licensed under the MIT license found in the
 // LICENSE file in the root directory of this source tree.
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
+#include <limits>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "esp/assets/Mp3dInstanceMeshData.h"
 #include "esp/assets/SceneLoader.h"
@@ -16,17 +22,50 @@ using namespace esp::assets;
 using namespace esp::scene;
 using namespace esp::nav;
 
-int createNavMesh(const std::string& meshFile, const std::string& navmeshFile) {
+namespace {
+double secondsSince(const std::chrono::steady_clock::time_point& start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+}  // namespace
+
+int createNavMesh(const std::string& meshFile,
+                  const std::string& navmeshFile,
+                  int tileSize,
+                  bool printStats,
+                  bool compareSingleTile) {
   SceneLoader loader;
   const AssetInfo info = AssetInfo::fromPath(meshFile);
   const MeshData mesh = loader.load(info);
   NavMeshSettings bs;
   bs.setDefaults();
+  bs.tileSize = tileSize;
   PathFinder pf;
+  auto start = std::chrono::steady_clock::now();
   if (!pf.build(bs, mesh)) {
     LOG(ERROR) << "Failed to build navmesh";
     return 2;
   }
+  const double buildTime = secondsSince(start);
+  LOG(INFO) << "Built navmesh in " << buildTime << "s";
+  if (printStats)
+    std::cout << pf.getBuildStats().report();
+
+  if (tileSize > 0 && compareSingleTile) {
+    // Build the mesh as a single tile as well to report the speedup, which
+    // takes the time and memory the tiled build saves
+    bs.tileSize = 0;
+    PathFinder singleTilePf;
+    start = std::chrono::steady_clock::now();
+    if (singleTilePf.build(bs, mesh)) {
+      const double singleTileTime = secondsSince(start);
+      LOG(INFO) << "Single tile build took " << singleTileTime
+                << "s, tiled build is " << singleTileTime / buildTime
+                << "x faster";
+    }
+  }
+
   if (!pf.saveNavMesh(navmeshFile)) {
     LOG(ERROR) << "Failed to save navmesh";
     return 3;
@@ -34,6 +73,54 @@ int createNavMesh(const std::string& meshFile, const std::string& navmeshFile) {
   return 0;
 }
 
+// Builds a navmesh for every agent in agentSpecs, "radius,height,maxClimb" in
+// meters, from a single rasterization of the mesh and saves them as
+// navmeshPrefix_r<radius>_h<height>_c<maxClimb>.navmesh
+int createNavMeshes(const std::string& meshFile,
+                    const std::string& navmeshPrefix,
+                    const std::vector<std::string>& agentSpecs,
+                    bool printStats) {
+  std::vector<NavMeshSettings> settings;
+  std::vector<std::string> navmeshFiles;
+  for (const std::string& spec : agentSpecs) {
+    NavMeshSettings bs;
+    bs.setDefaults();
+    if (std::sscanf(spec.c_str(), "%f,%f,%f", &bs.agentRadius,
+                    &bs.agentHeight, &bs.agentMaxClimb) != 3) {
+      LOG(ERROR) << "Agent " << spec << " isn't radius,height,maxClimb";
+      return 1;
+    }
+    const size_t comma1 = spec.find(','), comma2 = spec.find(',', comma1 + 1);
+    navmeshFiles.push_back(navmeshPrefix + "_r" + spec.substr(0, comma1) +
+                           "_h" + spec.substr(comma1 + 1, comma2 - comma1 - 1) +
+                           "_c" + spec.substr(comma2 + 1) + ".navmesh");
+    settings.push_back(bs);
+  }
+
+  SceneLoader loader;
+  const AssetInfo info = AssetInfo::fromPath(meshFile);
+  const MeshData mesh = loader.load(info);
+  const auto start = std::chrono::steady_clock::now();
+  const std::vector<PathFinder::ptr> pathFinders =
+      PathFinder::buildMultiple(settings, mesh);
+  if (pathFinders.empty()) {
+    LOG(ERROR) << "Failed to build navmeshes";
+    return 2;
+  }
+  LOG(INFO) << "Built " << pathFinders.size() << " navmeshes in "
+            << secondsSince(start) << "s";
+  if (printStats)
+    std::cout << pathFinders[0]->getBuildStats().report();
+
+  for (int i = 0; i < pathFinders.size(); ++i) {
+    if (!pathFinders[i]->saveNavMesh(navmeshFiles[i])) {
+      LOG(ERROR) << "Failed to save navmesh " << navmeshFiles[i];
+      return 3;
+    }
+  }
+  return 0;
+}
+
 int createMp3dSemanticMesh(const std::string& plyFile,
                            const std::string& houseFile,
                            const std::string& semMeshFile) {
@@ -64,21 +151,59 @@ int createMp3dSemanticMesh(const std::string& plyFile,
 }
 
 int main(int argc, char** argv) {
-  if (argc < 4) {
+  // Flags can go anywhere, the remaining arguments are positional
+  std::vector<std::string> args(argv, argv + argc);
+  auto takeFlag = [&args](const std::string& flag) {
+    auto it = std::find(args.begin(), args.end(), flag);
+    if (it == args.end())
+      return false;
+    args.erase(it);
+    return true;
+  };
+  const bool printStats = takeFlag("--stats");
+  const bool compareSingleTile = takeFlag("--compare");
+
+  if (args.size() < 4) {
     std::cout << "Usage: datatool task input_file output_file" << std::endl;
+    std::cout << "       datatool create_navmesh input_mesh output_navmesh "
+                 "[tile_size] [--stats] [--compare]"
+              << std::endl;
+    std::cout << "       datatool create_navmeshes input_mesh output_prefix "
+                 "radius,height,max_climb... [--stats]"
+              << std::endl;
     return 64;
   }
-  const std::string task = argv[1];
+  const std::string task = args[1];
   if (task == "create_navmesh") {
-    createNavMesh(argv[2], argv[3]);
+    // Optional tile size in voxels, builds the navmesh tiles in parallel.
+    // --stats prints the time and memory every stage of the build took,
+    // --compare also builds a single tile navmesh to report the speedup
+    int tileSize = 0;
+    if (args.size() > 4) {
+      char* end = nullptr;
+      const long value = std::strtol(args[4].c_str(), &end, 10);
+      if (end == args[4].c_str() || *end != '\0' || value < 0 ||
+          value > std::numeric_limits<int>::max()) {
+        std::cout << "tile_size must be a number of voxels >= 0, not "
+                  << args[4] << std::endl;
+        return 64;
+      }
+      tileSize = value;
+    }
+    createNavMesh(args[2], args[3], tileSize, printStats, compareSingleTile);
+  } else if (task == "create_navmeshes") {
+    // One navmesh per agent, all from a single rasterization of the mesh
+    createNavMeshes(args[2], args[3],
+                    std::vector<std::string>(args.begin() + 4, args.end()),
+                    printStats);
   } else if (task == "create_mp3d_semantic_mesh") {
-    if (argc < 5) {
+    if (args.size() < 5) {
       std::cout << "Usage: datatool create_mp3d_semantic_mesh input_ply "
                    "input_house output_mesh"
                 << std::endl;
       return 64;
     }
-    createMp3dSemanticMesh(argv[2], argv[3], argv[4]);
+    createMp3dSemanticMesh(args[2], args[3], args[4]);
   } else {
     LOG(ERROR) << "Unrecognized task " << task;
     return 1;
@@ -8,6 +8,7 @@ import tqdm
 
 import habitat_sim
 import habitat_sim.bindings as hsim
+from habitat_sim.errors import GreedyFollowerError
 
 base_dir = osp.abspath(osp.join(osp.dirname(__file__), ".."))
 
@@ -46,8 +47,12 @@ def pbar():
 num_fails = 0
 
 
+@pytest.mark.parametrize("use_distance_field", [False, True])
+@pytest.mark.parametrize("native_controls", [True, False])
 @pytest.mark.parametrize("test_navmesh", test_navmeshes)
-def test_greedy_follower(test_navmesh, scene_graph, pbar):
+def test_greedy_follower(
+    test_navmesh, native_controls, use_distance_field, scene_graph, pbar
+):
     global num_fails
     if not osp.exists(test_navmesh):
         pytest.skip(f"{test_navmesh} not found")
@@ -59,7 +64,12 @@ def test_greedy_follower(test_navmesh, scene_graph, pbar):
     agent = habitat_sim.Agent()
     agent.attach(scene_graph.get_root_node().create_child())
     agent.controls.move_filter_fn = pathfinder.try_step
-    follower = habitat_sim.GreedyGeodesicFollower(pathfinder, agent)
+    follower = habitat_sim.GreedyGeodesicFollower(
+        pathfinder,
+        agent,
+        native_controls=native_controls,
+        use_distance_field=use_distance_field,
+    )
 
     num_tests = 50
 
@@ -118,3 +128,109 @@ def test_greedy_follower(test_navmesh, scene_graph, pbar):
 
     if test_all:
         pbar.update()
+
+
+@pytest.mark.parametrize("test_navmesh", test_navmeshes)
+def test_native_controls_match(test_navmesh, scene_graph):
+    if not osp.exists(test_navmesh):
+        pytest.skip(f"{test_navmesh} not found")
+
+    pathfinder = hsim.PathFinder()
+    pathfinder.load_nav_mesh(test_navmesh)
+    assert pathfinder.is_loaded
+
+    agent = habitat_sim.Agent()
+    agent.attach(scene_graph.get_root_node().create_child())
+    agent.controls.move_filter_fn = pathfinder.try_step
+    native_follower = habitat_sim.GreedyGeodesicFollower(
+        pathfinder, agent, native_controls=True
+    )
+    python_follower = habitat_sim.GreedyGeodesicFollower(
+        pathfinder, agent, native_controls=False
+    )
+
+    for _ in range(20):
+        state = agent.state
+        state.position = pathfinder.get_random_navigable_point()
+        goal_pos = pathfinder.get_random_navigable_point()
+        agent.state = state
+
+        try:
+            native_path = native_follower.find_path(goal_pos)
+        except GreedyFollowerError:
+            native_path = None
+        try:
+            python_path = python_follower.find_path(goal_pos)
+        except GreedyFollowerError:
+            python_path = None
+
+        assert native_path == python_path
+
+
+def test_native_controls_unknown_action():
+    test_navmesh = test_navmeshes[-1]
+    if not osp.exists(test_navmesh):
+        pytest.skip(f"{test_navmesh} not found")
+
+    pathfinder = hsim.PathFinder()
+    pathfinder.load_nav_mesh(test_navmesh)
+    with pytest.raises(ValueError, match="moveFrwd"):
+        hsim.GreedyGeodesicFollowerImpl(
+            pathfinder,
+            "moveFrwd",
+            {"amount": 0.25},
+            "turnLeft",
+            {"amount": 10.0},
+            "turnRight",
+            {"amount": 10.0},
+            0.2,
+        )
+
+
+@pytest.mark.parametrize("test_navmesh", test_navmeshes)
+def test_optimal_path(test_navmesh, scene_graph):
+    if not osp.exists(test_navmesh):
+        pytest.skip(f"{test_navmesh} not found")
+
+    pathfinder = hsim.PathFinder()
+    pathfinder.load_nav_mesh(test_navmesh)
+    assert pathfinder.is_loaded
+
+    agent = habitat_sim.Agent()
+    agent.attach(scene_graph.get_root_node().create_child())
+    agent.controls.move_filter_fn = pathfinder.try_step
+    follower = habitat_sim.GreedyGeodesicFollower(pathfinder, agent)
+
+    num_tests = 20
+    num_optimal_actions = 0
+    num_greedy_actions = 0
+    for _ in range(num_tests):
+        state = agent.state
+        while True:
+            state.position = pathfinder.get_random_navigable_point()
+            goal_pos = pathfinder.get_random_navigable_point()
+            path = hsim.ShortestPath()
+            path.requested_start = state.position
+            path.requested_end = goal_pos
+
+            if pathfinder.find_path(path) and path.geodesic_distance > 2.0:
+                break
+
+        agent.state = state
+        path = follower.find_optimal_path(goal_pos)
+        for i, action in enumerate(path):
+            if action is not None:
+                agent.act(action)
+            else:
+                assert i == len(path) - 1
+
+        assert (
+            np.linalg.norm(agent.state.position - goal_pos)
+            <= follower.forward_spec.amount
+        ), "Didn't make it"
+        num_optimal_actions += len(path)
+
+        agent.state = state
+        num_greedy_actions += len(follower.find_path(goal_pos))
+
+    assert num_optimal_actions <= num_greedy_actions
@@ -0,0 +1,382 @@
+import gzip
+import json
+import os.path as osp
+
+import numpy as np
+import pytest
+
+import habitat_sim
+import habitat_sim.bindings as hsim
+
+base_dir = osp.abspath(osp.join(osp.dirname(__file__), ".."))
+
+test_navmeshes = [
+    osp.join(base_dir, "data/scene_datasets/mp3d/17DRP5sb8fy/17DRP5sb8fy.navmesh"),
+    osp.join(
+        base_dir, "data/scene_datasets/habitat-test-scenes/skokloster-castle.navmesh"
+    ),
+    osp.join(base_dir, "data/scene_datasets/habitat-test-scenes/van-gogh-room.navmesh"),
+]
+
+
+def _load_pathfinder(test_navmesh):
+    if not osp.exists(test_navmesh):
+        pytest.skip(f"{test_navmesh} not found")
+
+    pathfinder = hsim.PathFinder()
+    pathfinder.load_nav_mesh(test_navmesh)
+    assert pathfinder.is_loaded
+    return pathfinder
+
+
+@pytest.mark.parametrize("test_navmesh", test_navmeshes)
+def test_batched_find_path(test_navmesh):
+    pathfinder = _load_pathfinder(test_navmesh)
+
+    num_paths = 200
+    starts = np.array(
+        [pathfinder.get_random_navigable_point() for _ in range(num_paths)]
+    )
+    ends = np.array([pathfinder.get_random_navigable_point() for _ in range(num_paths)])
+
+    expected = []
+    paths = []
+    for start, end in zip(starts, ends):
+        path = hsim.ShortestPath()
+        path.requested_start = start
+        path.requested_end = end
+        pathfinder.find_path(path)
+        expected.append(path.geodesic_distance)
+
+        path = hsim.ShortestPath()
+        path.requested_start = start
+        path.requested_end = end
+        paths.append(path)
+
+    distances = pathfinder.geodesic_distances(starts, ends)
+    assert distances.shape == (num_paths,)
+    assert np.array_equal(distances, np.array(expected))
+
+    pathfinder.find_paths(paths)
+    assert np.array_equal(
+        np.array([path.geodesic_distance for path in paths]), np.array(expected)
+    )
+
+
+@pytest.mark.parametrize("test_navmesh", test_navmeshes)
+def test_batched_try_step(test_navmesh):
+    pathfinder = _load_pathfinder(test_navmesh)
+
+    num_steps = 200
+    starts = np.array(
+        [pathfinder.get_random_navigable_point() for _ in range(num_steps)]
+    )
+    ends = starts + np.random.uniform(-1, 1, size=(num_steps, 3)) * [1, 0, 1]
+
+    expected = np.array(
+        [pathfinder.try_step(start, end) for start, end in zip(starts, ends)]
+    )
+    results = pathfinder.try_steps(starts, ends)
+    assert results.shape == (num_steps, 3)
+    assert np.array_equal(results, expected)
+
+    with pytest.raises(ValueError):
+        pathfinder.try_steps(starts, ends[:-1])
+
+
+@pytest.mark.parametrize("test_navmesh", test_navmeshes)
+def test_obstacle_distance_grid(test_navmesh):
+    pathfinder = _load_pathfinder(test_navmesh)
+
+    points = [pathfinder.get_random_navigable_point() for _ in range(200)]
+    expected = np.array([pathfinder.distance_to_closest_obstacle(p) for p in points])
+
+    pathfinder.set_obstacle_distance_grid_cell_size(0.05)
+    assert pathfinder.obstacle_distance_grid_cell_size == pytest.approx(0.05)
+    distances = np.array([pathfinder.distance_to_closest_obstacle(p) for p in points])
+    errors = np.abs(distances - expected)
+    assert np.median(errors) < 1e-3
+    assert np.max(errors) < 0.25
+
+
+@pytest.mark.parametrize("test_navmesh", test_navmeshes)
+def test_poly_grid_index(test_navmesh):
+    pathfinder = _load_pathfinder(test_navmesh)
+
+    num_points = 300
+    points = np.array(
+        [pathfinder.get_random_navigable_point() for _ in range(num_points)]
+    )
+    points[num_points // 2 :] += np.random.uniform(-3, 3, size=(num_points // 2, 3))
+
+    expected = np.array([pathfinder.snap_point(p) for p in points])
+    expected_navigable = [pathfinder.is_navigable(p) for p in points]
+
+    pathfinder.set_poly_grid_index_cell_size(1.0)
+    assert pathfinder.poly_grid_index_cell_size == 1.0
+    snapped = pathfinder.snap_points(points)
+    assert snapped.shape == (num_points, 3)
+    assert np.array_equal(snapped, expected, equal_nan=True)
+    assert [pathfinder.is_navigable(p) for p in points] == expected_navigable
+
+
+@pytest.mark.parametrize("test_navmesh", test_navmeshes)
+def test_random_navigable_points(test_navmesh):
+    pathfinder = _load_pathfinder(test_navmesh)
+
+    points = pathfinder.get_random_navigable_points(1000, seed=3)
+    assert points.shape == (1000, 3)
+    assert np.array_equal(points, pathfinder.get_random_navigable_points(1000, seed=3))
+    assert all(pathfinder.is_navigable(p) for p in points)
+
+    largest_area = max(pathfinder.island_area(p) for p in points)
+    points = pathfinder.get_random_navigable_points(
+        100, seed=4, largest_island_only=True
+    )
+    assert all(pathfinder.island_area(p) == largest_area for p in points)
+
+    points = pathfinder.get_random_navigable_points(100, seed=5, min_island_radius=1.0)
+    assert all(pathfinder.island_radius(p) >= 1.0 for p in points)
+
+    points = pathfinder.get_random_navigable_points(100, seed=6, min_island_radius=1e6)
+    assert points.shape == (0, 3)
+
+
+@pytest.mark.parametrize("test_navmesh", test_navmeshes)
+def test_generate_point_nav_episodes(test_navmesh, tmpdir):
+    pathfinder = _load_pathfinder(test_navmesh)
+
+    settings = hsim.PointNavEpisodeSettings()
+    settings.num_episodes = 50
+    settings.min_geodesic_distance = 1.0
+    settings.max_geodesic_distance = 10.0
+    settings.min_geodesic_to_euclidean_ratio = 1.05
+    episodes = pathfinder.generate_point_nav_episodes(settings, seed=1)
+    num_episodes = len(episodes["geodesic_distances"])
+    assert episodes["start_positions"].shape == (num_episodes, 3)
+    assert episodes["start_rotations"].shape == (num_episodes, 4)
+    assert np.all(episodes["geodesic_distances"] >= 1.0)
+    assert np.all(episodes["geodesic_distances"] <= 10.0)
+    assert np.all(
+        episodes["geodesic_distances"] >= 1.05 * episodes["euclidean_distances"]
+    )
+    assert np.array_equal(
+        pathfinder.generate_point_nav_episodes(settings, seed=1)["goal_positions"],
+        episodes["goal_positions"],
+    )
+
+    path = str(tmpdir.join("episodes.json.gz"))
+    habitat_sim.nav.save_point_nav_episodes(path, episodes, scene_id=test_navmesh)
+    with gzip.open(path, "rt") as f:
+        dataset = json.load(f)
+    assert len(dataset["episodes"]) == num_episodes
+    assert np.allclose(
+        dataset["episodes"][0]["goals"][0]["position"], episodes["goal_positions"][0]
+    )
+
+
+@pytest.mark.parametrize("test_navmesh", test_navmeshes)
+def test_geodesic_distance_matrix(test_navmesh):
+    pathfinder = _load_pathfinder(test_navmesh)
+
+    num_points = 30
+    points = np.array(
+        [pathfinder.get_random_navigable_point() for _ in range(num_points)]
+    )
+    distances = pathfinder.geodesic_distance_matrix(points)
+    assert distances.shape == (num_points, num_points)
+    assert np.array_equal(distances, distances.T)
+    assert np.all(np.diag(distances) == 0)
+
+    starts, ends = np.triu_indices(num_points, 1)
+    expected = pathfinder.geodesic_distances(points[starts], points[ends])
+    assert np.array_equal(np.isfinite(distances[starts, ends]), np.isfinite(expected))
+    reachable = np.isfinite(expected)
+    assert np.all(
+        distances[starts, ends][reachable] <= expected[reachable] * (1 + 1e-4)
+    )
+
+    bounds = pathfinder.geodesic_distance_matrix(points, refine=False)
+    assert np.all(distances <= bounds)
+
+
+@pytest.mark.parametrize("test_navmesh", test_navmeshes)
+def test_raycast(test_navmesh):
+    pathfinder = _load_pathfinder(test_navmesh)
+
+    num_rays = 200
+    starts = np.array(
+        [pathfinder.get_random_navigable_point() for _ in range(num_rays)]
+    )
+    ends = np.array([pathfinder.get_random_navigable_point() for _ in range(num_rays)])
+    hits = pathfinder.raycasts(starts, ends)
+    assert hits["hit_positions"].shape == (num_rays, 3)
+    assert hits["reached"].dtype == np.bool_
+
+    distances = pathfinder.geodesic_distances(starts, ends)
+    for i in range(num_rays):
+        hit = pathfinder.raycast(starts[i], ends[i])
+        assert hit.reached == hits["reached"][i]
+        assert np.array_equal(hit.hit_pos, hits["hit_positions"][i])
+        if hit.reached:
+            assert abs(distances[i] - hit.hit_dist) < 1e-3
+        else:
+            assert hit.hit_dist <= np.linalg.norm(ends[i] - starts[i]) + 1e-3
+
+
+@pytest.mark.parametrize("test_navmesh", test_navmeshes)
+def test_topdown_view(test_navmesh):
+    pathfinder = _load_pathfinder(test_navmesh)
+    lower, upper = pathfinder.get_bounds()
+    meters_per_pixel = 0.1
+    heights = [pathfinder.get_random_navigable_point()[1] for _ in range(2)]
+    views = pathfinder.get_topdown_views(meters_per_pixel, heights)
+    assert len(views) == len(heights)
+
+    for height, view in zip(heights, views):
+        assert view.dtype == np.uint8
+        assert np.array_equal(
+            view, pathfinder.get_topdown_view(meters_per_pixel, height)
+        )
+
+        # Matches is_navigable at the pixel centers but for polygon borders
+        rows, cols = np.meshgrid(
+            np.arange(view.shape[0]), np.arange(view.shape[1]), indexing="ij"
+        )
+        xs = lower[0] + (cols.ravel() + 0.5) * meters_per_pixel
+        zs = lower[2] + (rows.ravel() + 0.5) * meters_per_pixel
+        navigable = np.array(
+            [pathfinder.is_navigable([x, height, z]) for x, z in zip(xs, zs)]
+        )
+        assert navigable.any()
+        mismatches = np.sum(navigable != (view.ravel() == 1))
+        assert mismatches <= 0.01 * np.sum(navigable)
+
+
+@pytest.mark.parametrize("test_navmesh", test_navmeshes)
+def test_object_goals(test_navmesh):
+    pathfinder = _load_pathfinder(test_navmesh)
+    base = pathfinder.get_random_navigable_point()
+    obb = hsim.OBB(base + np.array([0, 0.5, 0]), np.array([0.6, 1.0, 0.4]))
+    assert pathfinder.set_object_goals("object", [obb], radius=0.5)
+    assert pathfinder.geodesic_distance_to_objects(base, "object") == 0
+    assert np.isinf(pathfinder.geodesic_distance_to_objects(base, "unknown"))
+
+    for _ in range(100):
+        pt = pathfinder.get_random_navigable_point()
+        distance = pathfinder.geodesic_distance_to_objects(pt, "object")
+        base_distance = pathfinder.geodesic_distance_to_goals(pt, [base])
+        if np.isfinite(base_distance):
+            assert distance <= base_distance + 1e-3
+
+
+@pytest.mark.parametrize("test_navmesh", test_navmeshes)
+def test_object_viewpoints(test_navmesh):
+    pathfinder = _load_pathfinder(test_navmesh)
+    scene_file = osp.splitext(test_navmesh)[0] + ".glb"
+    if not osp.exists(scene_file):
+        pytest.skip(f"{scene_file} not found")
+
+    objects = [
+        hsim.OBB(
+            pathfinder.get_random_navigable_point() + np.array([0, 0.5, 0]),
+            np.array([0.5, 1.0, 0.5]),
+        )
+        for _ in range(10)
+    ]
+    settings = hsim.ObjectViewpointSettings()
+    settings.radius = 1.0
+    viewpoints = pathfinder.sample_object_viewpoints(scene_file, objects, settings)
+    assert len(viewpoints) == len(objects)
+    assert any(len(points) > 0 for points in viewpoints)
+    for obb, points in zip(objects, viewpoints):
+        assert points.shape[1] == 3
+        for pt in points:
+            assert pathfinder.is_navigable(pt)
+            offset = np.abs(pt - obb.center)[[0, 2]]
+            assert np.all(offset <= obb.half_extents[[0, 2]] + settings.radius + 1e-3)
+
+
+@pytest.mark.parametrize("test_navmesh", test_navmeshes)
+def test_cluster_graph(test_navmesh):
+    pathfinder = _load_pathfinder(test_navmesh)
+
+    num_paths = 200
+    starts = np.array(
+        [pathfinder.get_random_navigable_point() for _ in range(num_paths)]
+    )
+    ends = np.array([pathfinder.get_random_navigable_point() for _ in range(num_paths)])
+    expected = pathfinder.geodesic_distances(starts, ends)
+
+    pathfinder.set_cluster_graph_cell_size(2.0)
+    assert pathfinder.cluster_graph_cell_size == 2.0
+    distances = pathfinder.geodesic_distances(starts, ends)
+    assert np.array_equal(np.isfinite(distances), np.isfinite(expected))
+    reachable = np.isfinite(expected)
+    assert np.all(distances[reachable] <= 1.1 * expected[reachable] + 1e-3)
+    assert np.sum(distances[reachable]) <= 1.01 * np.sum(expected[reachable])
+
+
+@pytest.mark.parametrize("test_navmesh", test_navmeshes)
+def test_path_cache(test_navmesh):
+    pathfinder = _load_pathfinder(test_navmesh)
+
+    num_paths = 100
+    starts = np.array(
+        [pathfinder.get_random_navigable_point() for _ in range(num_paths)]
+    )
+    ends = np.array([pathfinder.get_random_navigable_point() for _ in range(num_paths)])
+    expected = pathfinder.geodesic_distances(starts, ends)
+    num_found = np.sum(np.isfinite(expected))
+
+    pathfinder.set_path_cache_budget(1 << 20, quantization=0.1)
+    assert pathfinder.path_cache_budget == 1 << 20
+    for _ in range(3):
+        distances = pathfinder.geodesic_distances(starts, ends)
+        assert np.array_equal(distances, expected)
+    stats = pathfinder.path_cache_stats
+    assert stats.misses == num_found
+    assert stats.hits == 2 * num_found
+    assert stats.num_entries == num_found
+    assert stats.num_bytes <= 1 << 20
+    if num_found:
+        assert stats.hit_rate == pytest.approx(2 / 3)
+
+    # Endpoints that share an entry still get paths from and to exactly them
+    path = hsim.ShortestPath()
+    path.requested_start = pathfinder.snap_point(starts[0] + 0.01)
+    path.requested_end = pathfinder.snap_point(ends[0] - 0.01)
+    if pathfinder.find_path(path):
+        assert np.allclose(path.points[0], path.requested_start)
+        assert np.allclose(path.points[-1], path.requested_end)
+
+    pathfinder.set_path_cache_budget(0)
+    assert pathfinder.path_cache_stats.num_entries == 0
+
+
+@pytest.mark.parametrize("test_navmesh", test_navmeshes)
+def test_nav_mesh_cache(test_navmesh):
+    capacity = hsim.PathFinder.get_nav_mesh_cache_capacity()
+    try:
+        first = _load_pathfinder(test_navmesh)
+        second = _load_pathfinder(test_navmesh)
+        assert hsim.PathFinder.get_nav_mesh_cache_size() > 0
+
+        start = first.get_random_navigable_point()
+        end = first.get_random_navigable_point()
+        paths = []
+        for pathfinder in [first, second]:
+            path = hsim.ShortestPath()
+            path.requested_start = start
+            path.requested_end = end
+            pathfinder.find_path(path)
+            paths.append(path)
+        assert paths[0].geodesic_distance == paths[1].geodesic_distance
+
+        # Navmeshes in use are still shared and stay valid
+        hsim.PathFinder.set_nav_mesh_cache_capacity(0)
+        assert hsim.PathFinder.get_nav_mesh_cache_size() == 0
+        third = _load_pathfinder(test_navmesh)
+        assert first.is_navigable(start) and third.is_navigable(start)
+    finally:
+        hsim.PathFinder.set_nav_mesh_cache_capacity(capacity)